@@ -0,0 +1,59 @@
+#ifdef ALLOC_CHECK
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "alloc_check.h"
+
+// Provided by the linker for -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static int armed;
+static unsigned long count;
+
+static void alloc_check_hit(const char *name, size_t size)
+{
+    count++;
+    if(armed) {
+        fprintf(stderr, "alloc_check: %s(%zu) in the steady state loop\n", name, size);
+        abort();
+    }
+}
+
+void *__wrap_malloc(size_t size)
+{
+    alloc_check_hit("malloc", size);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    alloc_check_hit("calloc", count*size);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    alloc_check_hit("realloc", size);
+    return __real_realloc(ptr, size);
+}
+
+void alloc_check_begin()
+{
+    printf("alloc_check: %lu allocations during setup\n", count);
+    armed = 1;
+}
+
+void alloc_check_end()
+{
+    armed = 0;
+}
+
+unsigned long alloc_check_count()
+{
+    return count;
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef ALLOC_CHECK_H
+#define ALLOC_CHECK_H
+
+// Build with ALLOC_CHECK=1 to link malloc/calloc/realloc through counting
+// wrappers. Between alloc_check_begin() and alloc_check_end() any heap
+// allocation made by our own code aborts with the call site in the core.
+// Allocations inside libc and the GL driver are not wrapped.
+#ifdef ALLOC_CHECK
+void alloc_check_begin();
+void alloc_check_end();
+unsigned long alloc_check_count();
+#else
+#define alloc_check_begin()
+#define alloc_check_end()
+#define alloc_check_count() 0UL
+#endif
+
+#endif
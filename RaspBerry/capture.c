@@ -0,0 +1,417 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "capture.h"
+#include "gles3_compat.h"
+
+#include "GLES2/gl2.h"
+
+// Largest stored deflate block
+#define PNG_STORED_BLOCK 65535
+
+static const char *const format_extensions[] = { "raw", "ppm", "png" };
+
+static double capture_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static uint32_t crc_table[256];
+
+static void init_crc_table()
+{
+    uint32_t n, k;
+
+    for(n=0; n<256; n++) {
+        uint32_t c = n;
+        for(k=0; k<8; k++)
+            c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crc_table[n] = c;
+    }
+}
+
+static uint32_t crc_update(uint32_t crc, const uint8_t *data, size_t length)
+{
+    size_t i;
+
+    for(i=0; i<length; i++)
+        crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+// Streams an uncompressed zlib payload inside a single IDAT chunk
+typedef struct
+{
+    FILE *file;
+    uint32_t crc;
+    uint32_t adler_a;
+    uint32_t adler_b;
+    size_t remaining;
+    size_t block_left;
+} PNG_WRITER_T;
+
+static void png_put(PNG_WRITER_T *png, const uint8_t *data, size_t length)
+{
+    fwrite(data, 1, length, png->file);
+    png->crc = crc_update(png->crc, data, length);
+}
+
+static void put_be32(uint8_t *out, uint32_t value)
+{
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+static void png_chunk(FILE *file, const char *type, const uint8_t *data, uint32_t length)
+{
+    uint8_t word[4];
+    uint32_t crc = crc_update(0xffffffffu, (const uint8_t*)type, 4);
+
+    put_be32(word, length);
+    fwrite(word, 1, 4, file);
+    fwrite(type, 1, 4, file);
+    fwrite(data, 1, length, file);
+    crc = crc_update(crc, data, length);
+    put_be32(word, crc ^ 0xffffffffu);
+    fwrite(word, 1, 4, file);
+}
+
+// Image bytes in stored blocks, each starting with its header
+static void png_data(PNG_WRITER_T *png, const uint8_t *data, size_t length)
+{
+    size_t i;
+
+    for(i=0; i<length; i++) {
+        png->adler_a = (png->adler_a + data[i]) % 65521;
+        png->adler_b = (png->adler_b + png->adler_a) % 65521;
+    }
+
+    while(length) {
+        if(!png->block_left) {
+            uint16_t size = png->remaining > PNG_STORED_BLOCK ? PNG_STORED_BLOCK : png->remaining;
+            uint16_t inverse = ~size;
+            uint8_t header[5];
+            header[0] = png->remaining == size;
+            header[1] = size & 0xff;
+            header[2] = size >> 8;
+            header[3] = inverse & 0xff;
+            header[4] = inverse >> 8;
+            png_put(png, header, 5);
+            png->block_left = size;
+        }
+
+        size_t count = length < png->block_left ? length : png->block_left;
+        png_put(png, data, count);
+        data += count;
+        length -= count;
+        png->block_left -= count;
+        png->remaining -= count;
+    }
+}
+
+// RGB PNG with a stored (uncompressed) deflate stream, cheap to produce on the Pi
+static void write_png(FILE *file, const GLubyte *pixels, GLsizei width, GLsizei height, uint8_t *row)
+{
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    uint8_t ihdr[13];
+    uint8_t word[4];
+    size_t raw_size = (size_t)height*(1 + width*3);
+    size_t blocks = (raw_size + PNG_STORED_BLOCK - 1)/PNG_STORED_BLOCK;
+    PNG_WRITER_T png;
+    GLsizei x, y;
+
+    fwrite(signature, 1, 8, file);
+
+    put_be32(&ihdr[0], width);
+    put_be32(&ihdr[4], height);
+    ihdr[8] = 8;   // Bit depth
+    ihdr[9] = 2;   // RGB
+    ihdr[10] = 0;  // Deflate
+    ihdr[11] = 0;  // Adaptive filtering
+    ihdr[12] = 0;  // No interlace
+    png_chunk(file, "IHDR", ihdr, sizeof ihdr);
+
+    memset(&png, 0, sizeof(PNG_WRITER_T));
+    png.file = file;
+    png.adler_a = 1;
+    png.remaining = raw_size;
+
+    put_be32(word, 2 + raw_size + blocks*5 + 4);
+    fwrite(word, 1, 4, file);
+    png.crc = 0xffffffffu;
+    png_put(&png, (const uint8_t*)"IDAT", 4);
+
+    // zlib header, no compression
+    static const uint8_t zlib_header[2] = { 0x78, 0x01 };
+    png_put(&png, zlib_header, 2);
+
+    // GL rows run bottom up, each PNG row starts with filter type 0
+    for(y=height-1; y>=0; y--) {
+        const GLubyte *src = &pixels[(size_t)y*width*4];
+        row[0] = 0;
+        for(x=0; x<width; x++) {
+            row[1 + x*3 + 0] = src[x*4 + 0];
+            row[1 + x*3 + 1] = src[x*4 + 1];
+            row[1 + x*3 + 2] = src[x*4 + 2];
+        }
+        png_data(&png, row, 1 + width*3);
+    }
+
+    put_be32(word, png.adler_b << 16 | png.adler_a);
+    png_put(&png, word, 4);
+    put_be32(word, png.crc ^ 0xffffffffu);
+    fwrite(word, 1, 4, file);
+
+    png_chunk(file, "IEND", NULL, 0);
+}
+
+static void write_ppm(FILE *file, const GLubyte *pixels, GLsizei width, GLsizei height, uint8_t *row)
+{
+    GLsizei x, y;
+
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for(y=height-1; y>=0; y--) {
+        const GLubyte *src = &pixels[(size_t)y*width*4];
+        for(x=0; x<width; x++) {
+            row[x*3 + 0] = src[x*4 + 0];
+            row[x*3 + 1] = src[x*4 + 1];
+            row[x*3 + 2] = src[x*4 + 2];
+        }
+        fwrite(row, 1, width*3, file);
+    }
+}
+
+static void write_slot(CAPTURE_T *capture, CAPTURE_SLOT_T *slot, uint8_t *row)
+{
+    char path[320];
+
+    snprintf(path, sizeof path, "%s/frame_%06lu.%s", capture->directory, slot->frame, format_extensions[capture->format]);
+    FILE *file = fopen(path, "wb");
+    if(!file) {
+        printf("capture: unable to write %s\n", path);
+        return;
+    }
+
+    // Raw captures are the RGBA rows exactly as read, bottom up
+    if(capture->format == CAPTURE_FORMAT_RAW)
+        fwrite(slot->pixels, 4, (size_t)capture->width*capture->height, file);
+    else if(capture->format == CAPTURE_FORMAT_PPM)
+        write_ppm(file, slot->pixels, capture->width, capture->height, row);
+    else
+        write_png(file, slot->pixels, capture->width, capture->height, row);
+
+    fclose(file);
+}
+
+// Writes ready slots oldest first
+static void *capture_writer(void *arg)
+{
+    CAPTURE_T *capture = arg;
+
+    pthread_mutex_lock(&capture->lock);
+    while(1) {
+        CAPTURE_SLOT_T *next = NULL;
+        int i;
+
+        for(i=0; i<CAPTURE_SLOTS; i++) {
+            CAPTURE_SLOT_T *slot = &capture->slots[i];
+            if(slot->state == CAPTURE_SLOT_WRITING && (!next || slot->frame < next->frame))
+                next = slot;
+        }
+
+        if(!next) {
+            if(capture->quit)
+                break;
+            pthread_cond_wait(&capture->ready, &capture->lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&capture->lock);
+        write_slot(capture, next, capture->row);
+        pthread_mutex_lock(&capture->lock);
+
+        next->state = CAPTURE_SLOT_WRITTEN;
+        capture->stats.written++;
+    }
+    pthread_mutex_unlock(&capture->lock);
+
+    return NULL;
+}
+
+// Captures the window every interval frames
+void capture_init(CAPTURE_T *capture, int gles_version, GLsizei width, GLsizei height, unsigned long interval, CAPTURE_FORMAT_T format)
+{
+    const char *dir = getenv("OGL_CAPTURE_DIR");
+    size_t size = (size_t)width*height*4;
+    int i;
+
+    memset(capture, 0, sizeof(CAPTURE_T));
+    capture->use_pbo = gles_version >= 3;
+    capture->width = width;
+    capture->height = height;
+    capture->interval = interval ? interval : 1;
+    capture->format = format;
+
+    if(!dir)
+        dir = CAPTURE_DIR;
+    strncpy(capture->directory, dir, sizeof(capture->directory) - 1);
+    mkdir(capture->directory, 0755);
+
+    init_crc_table();
+
+    // Conversion row for the writer, PNG rows carry a filter byte
+    capture->row = malloc(1 + width*3);
+    assert(capture->row);
+
+    for(i=0; i<CAPTURE_SLOTS; i++) {
+        CAPTURE_SLOT_T *slot = &capture->slots[i];
+        if(capture->use_pbo) {
+            glGenBuffers(1, &slot->pbo);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+            glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        }
+        else {
+            slot->pixels = malloc(size);
+            assert(slot->pixels);
+        }
+    }
+    if(capture->use_pbo)
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    pthread_mutex_init(&capture->lock, NULL);
+    pthread_cond_init(&capture->ready, NULL);
+    int ret = pthread_create(&capture->writer, NULL, capture_writer, capture);
+    assert(ret == 0);
+
+    printf("Capture: %s every %lu frames to %s, %s readback\n", format_extensions[format], capture->interval,
+           capture->directory, capture->use_pbo ? "asynchronous PBO" : "synchronous");
+}
+
+// Hands finished readbacks to the writer, recycles written slots and starts a
+// new readback when one is due. Call after drawing and before egl_swap().
+void capture_frame(CAPTURE_T *capture)
+{
+    double start = capture_time();
+    int i, signal = 0;
+
+    pthread_mutex_lock(&capture->lock);
+    for(i=0; i<CAPTURE_SLOTS; i++) {
+        CAPTURE_SLOT_T *slot = &capture->slots[i];
+
+        if(slot->state == CAPTURE_SLOT_WRITTEN) {
+            // Unmapping is a GL call so it happens here rather than on the writer
+            if(capture->use_pbo) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+                gles3.unmap_buffer(GL_PIXEL_PACK_BUFFER);
+                slot->pixels = NULL;
+            }
+            slot->state = CAPTURE_SLOT_FREE;
+        }
+        else if(slot->state == CAPTURE_SLOT_READING) {
+            // Never wait, a readback still in flight is picked up next frame
+            GLenum status = gles3.client_wait_sync(slot->fence, 0, 0);
+            if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                continue;
+            gles3.delete_sync(slot->fence);
+            slot->fence = NULL;
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+            slot->pixels = gles3.map_buffer_range(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)capture->width*capture->height*4, GL_MAP_READ_BIT);
+            assert(slot->pixels);
+            slot->state = CAPTURE_SLOT_WRITING;
+            signal = 1;
+        }
+    }
+
+    if(capture->frame++ % capture->interval == 0) {
+        CAPTURE_SLOT_T *slot = &capture->slots[capture->next_slot];
+        capture->stats.captures++;
+
+        if(slot->state != CAPTURE_SLOT_FREE)
+            capture->stats.dropped++;
+        else {
+            slot->frame = capture->frame - 1;
+            capture->next_slot = (capture->next_slot + 1) % CAPTURE_SLOTS;
+
+            if(capture->use_pbo) {
+                // Queued behind this frame's draws, collected once its fence has passed
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+                glReadPixels(0, 0, capture->width, capture->height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+                slot->fence = gles3.fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                slot->state = CAPTURE_SLOT_READING;
+            }
+            else {
+                // GLES2 has no asynchronous readback, this waits for the frame to finish
+                glReadPixels(0, 0, capture->width, capture->height, GL_RGBA, GL_UNSIGNED_BYTE, slot->pixels);
+                slot->state = CAPTURE_SLOT_WRITING;
+                signal = 1;
+            }
+        }
+    }
+
+    if(capture->use_pbo)
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if(signal)
+        pthread_cond_signal(&capture->ready);
+    pthread_mutex_unlock(&capture->lock);
+
+    double elapsed = capture_time() - start;
+    capture->stats.calls++;
+    capture->stats.render_seconds += elapsed;
+    if(elapsed > capture->stats.render_max)
+        capture->stats.render_max = elapsed;
+}
+
+void capture_print_stats(CAPTURE_T *capture)
+{
+    CAPTURE_STATS_T *stats = &capture->stats;
+
+    if(!stats->calls)
+        return;
+
+    printf("Capture: %lu captures, %lu written, %lu dropped, render thread %.3f ms/frame average, %.3f ms worst\n",
+           stats->captures, stats->written, stats->dropped,
+           stats->render_seconds/stats->calls*1e3, stats->render_max*1e3);
+}
+
+void capture_destroy(CAPTURE_T *capture)
+{
+    int i;
+
+    // Let the writer drain what it already has
+    pthread_mutex_lock(&capture->lock);
+    capture->quit = 1;
+    pthread_cond_signal(&capture->ready);
+    pthread_mutex_unlock(&capture->lock);
+    pthread_join(capture->writer, NULL);
+
+    for(i=0; i<CAPTURE_SLOTS; i++) {
+        CAPTURE_SLOT_T *slot = &capture->slots[i];
+        if(capture->use_pbo) {
+            if(slot->fence)
+                gles3.delete_sync(slot->fence);
+            if(slot->pixels) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+                gles3.unmap_buffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glDeleteBuffers(1, &slot->pbo);
+        }
+        else
+            free(slot->pixels);
+    }
+    if(capture->use_pbo)
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    pthread_mutex_destroy(&capture->lock);
+    pthread_cond_destroy(&capture->ready);
+    free(capture->row);
+    memset(capture, 0, sizeof(CAPTURE_T));
+}
@@ -0,0 +1,87 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <pthread.h>
+
+#include "GLES2/gl2.h"
+#include "gles3_compat.h"
+
+// Readbacks in flight, a slot is reused only once its file has been written
+#define CAPTURE_SLOTS 4
+
+// Default output directory, overridden by the OGL_CAPTURE_DIR environment variable
+#define CAPTURE_DIR "/var/tmp/ogl_tex_capture"
+
+typedef enum {
+    CAPTURE_FORMAT_RAW,
+    CAPTURE_FORMAT_PPM,
+    CAPTURE_FORMAT_PNG
+} CAPTURE_FORMAT_T;
+
+typedef enum {
+    CAPTURE_SLOT_FREE,
+    // glReadPixels issued into the slot's PBO, waiting on its fence
+    CAPTURE_SLOT_READING,
+    // Pixels available, owned by the writer thread
+    CAPTURE_SLOT_WRITING,
+    // File written, the render thread unmaps and frees the slot
+    CAPTURE_SLOT_WRITTEN
+} CAPTURE_SLOT_STATE_T;
+
+typedef struct
+{
+    CAPTURE_SLOT_STATE_T state;
+    unsigned long frame;
+    GLuint pbo;
+    GL3_SYNC_T fence;
+
+    // Staging memory on GLES2, the mapped PBO on GLES3
+    GLubyte *pixels;
+} CAPTURE_SLOT_T;
+
+typedef struct
+{
+    unsigned long captures;
+    unsigned long written;
+    // Captures skipped because every slot was still busy
+    unsigned long dropped;
+
+    // Time spent inside capture_frame() on the render thread
+    unsigned long calls;
+    double render_seconds;
+    double render_max;
+} CAPTURE_STATS_T;
+
+typedef struct
+{
+    // Non zero when readbacks go through pixel pack buffers (GLES3)
+    int use_pbo;
+
+    GLsizei width;
+    GLsizei height;
+    CAPTURE_FORMAT_T format;
+    char directory[256];
+
+    // Capture every interval frames
+    unsigned long interval;
+    unsigned long frame;
+
+    CAPTURE_SLOT_T slots[CAPTURE_SLOTS];
+    int next_slot;
+
+    // Writer thread, shares slot states with the render thread under lock
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    int quit;
+    uint8_t *row;
+
+    CAPTURE_STATS_T stats;
+} CAPTURE_T;
+
+void capture_init(CAPTURE_T *capture, int gles_version, GLsizei width, GLsizei height, unsigned long interval, CAPTURE_FORMAT_T format);
+void capture_frame(CAPTURE_T *capture);
+void capture_print_stats(CAPTURE_T *capture);
+void capture_destroy(CAPTURE_T *capture);
+
+#endif
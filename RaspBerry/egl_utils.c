@@ -1,8 +1,13 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <math.h>
+#include <time.h>
 
 #include "egl_utils.h"
+#include "gles3_compat.h"
+#include "shader_utils.h"
 
 #include "GLES2/gl2.h"
 #include "EGL/egl.h"
@@ -13,11 +18,47 @@
 
 #include "bcm_host.h"
 
+#ifndef EGL_OPENGL_ES3_BIT_KHR
+#define EGL_OPENGL_ES3_BIT_KHR 0x00000040
+#endif
+
+#ifndef EGL_BUFFER_AGE_EXT
+#define EGL_BUFFER_AGE_EXT 0x313D
+#endif
+
+// Smoothing of the vsync grid towards observed vsyncs
+#define EGL_PACING_PHASE_GAIN 0.125
+#define EGL_PACING_PERIOD_GAIN 0.015625
+
+// A swap that took longer than this was held back until a vsync
+#define EGL_PACING_BLOCKED 0.0005
+
+static double egl_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
 void check()
 {
     assert(glGetError() == 0);
 }
 
+GLES3_PROCS_T gles3;
+
+int load_gles3_procs()
+{
+    gles3.map_buffer_range = (void*)eglGetProcAddress("glMapBufferRange");
+    gles3.unmap_buffer = (void*)eglGetProcAddress("glUnmapBuffer");
+    gles3.fence_sync = (void*)eglGetProcAddress("glFenceSync");
+    gles3.client_wait_sync = (void*)eglGetProcAddress("glClientWaitSync");
+    gles3.delete_sync = (void*)eglGetProcAddress("glDeleteSync");
+
+    return gles3.map_buffer_range && gles3.unmap_buffer && gles3.fence_sync
+           && gles3.client_wait_sync && gles3.delete_sync;
+}
+
 void showlog(GLint shader)
 {
    // Prints the compile log for a shader
@@ -26,6 +67,67 @@ void showlog(GLint shader)
    printf("%d:shader:\n%s\n", shader, log);
 }
 
+// Non zero when the display's EGL lists the extension
+int egl_has_extension(EGL_STATE_T *state, const char *name)
+{
+    return extension_listed(eglQueryString(state->display, EGL_EXTENSIONS), name);
+}
+
+// Picks a config for attributes, preferring one whose window surfaces can preserve the back buffer
+static EGLBoolean choose_config(EGLDisplay display, EGLint *attributes, EGLConfig *config, EGLint *num_config)
+{
+    EGLint *surface_type = attributes;
+    EGLBoolean result;
+
+    while(*surface_type != EGL_SURFACE_TYPE)
+        surface_type += 2;
+    surface_type++;
+
+    *surface_type = EGL_WINDOW_BIT | EGL_SWAP_BEHAVIOR_PRESERVED_BIT;
+    result = eglChooseConfig(display, attributes, config, 1, num_config);
+    if(result != EGL_FALSE && *num_config > 0)
+        return result;
+
+    *surface_type = EGL_WINDOW_BIT;
+    return eglChooseConfig(display, attributes, config, 1, num_config);
+}
+
+// Turns on partial presents with whatever the surface offers. Without this
+// call egl_begin_frame() always asks for a full redraw. full_back_buffer
+// keeps the whole back buffer defined for readback, which rules out
+// EGL_KHR_partial_update as it leaves undamaged areas undefined.
+void egl_enable_damage(EGL_STATE_T *state, int full_back_buffer)
+{
+    const char *extensions = eglQueryString(state->display, EGL_EXTENSIONS);
+
+    // Preserved back buffers only need this frame's damage redrawn. Not the
+    // default as keeping the contents costs a tile buffer reload every frame.
+    if(state->preserve_capable)
+        state->preserved = eglSurfaceAttrib(state->display, state->surface, EGL_SWAP_BEHAVIOR, EGL_BUFFER_PRESERVED);
+
+    // Otherwise buffer age says how many frames of damage the back buffer is missing
+    state->buffer_age = extension_listed(extensions, "EGL_EXT_buffer_age") || extension_listed(extensions, "EGL_KHR_partial_update");
+    if(!full_back_buffer && extension_listed(extensions, "EGL_KHR_partial_update"))
+        state->set_damage_region = (EGL_SET_DAMAGE_REGION_PROC_T)eglGetProcAddress("eglSetDamageRegionKHR");
+
+    // Lets the display side only scan out what changed
+    if(extension_listed(extensions, "EGL_KHR_swap_buffers_with_damage"))
+        state->swap_with_damage = (EGL_SWAP_WITH_DAMAGE_PROC_T)eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+    else if(extension_listed(extensions, "EGL_EXT_swap_buffers_with_damage"))
+        state->swap_with_damage = (EGL_SWAP_WITH_DAMAGE_PROC_T)eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+
+    printf("Damage tracking: %s%s%s%s\n",
+           state->preserved ? "preserved " : "",
+           state->buffer_age ? "buffer_age " : "",
+           state->set_damage_region ? "partial_update " : "",
+           state->swap_with_damage ? "swap_with_damage" : "");
+    if(!state->preserved && !state->buffer_age)
+        printf("Damage tracking: full redraw every frame\n");
+
+    // Nothing on screen is ours yet
+    egl_damage_all(state);
+}
+
 // Description: Sets the display, OpenGL|ES context and screen stuff
 void init_ogl(EGL_STATE_T *state)
 {
@@ -45,7 +147,7 @@ void init_ogl(EGL_STATE_T *state)
     VC_RECT_T dst_rect;
     VC_RECT_T src_rect;
 
-    static const EGLint attribute_list[] =
+    EGLint attribute_list[] =
     {
        EGL_RED_SIZE, 8,
        EGL_GREEN_SIZE, 8,
@@ -55,9 +157,20 @@ void init_ogl(EGL_STATE_T *state)
        EGL_NONE
     };
    
-    static const EGLint context_attributes[] =
+    EGLint attribute_list_es3[] =
+    {
+       EGL_RED_SIZE, 8,
+       EGL_GREEN_SIZE, 8,
+       EGL_BLUE_SIZE, 8,
+       EGL_ALPHA_SIZE, 8,
+       EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+       EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT_KHR,
+       EGL_NONE
+    };
+
+    EGLint context_attributes[] =
     {
-       EGL_CONTEXT_CLIENT_VERSION, 2,
+       EGL_CONTEXT_CLIENT_VERSION, 3,
        EGL_NONE
     }; 
     EGLConfig config;
@@ -70,8 +183,12 @@ void init_ogl(EGL_STATE_T *state)
     result = eglInitialize(state->display, NULL, NULL);
     assert(EGL_FALSE != result);
 
-    // get an appropriate EGL frame buffer configuration
-    result = eglChooseConfig(state->display, attribute_list, &config, 1, &num_config);
+    // get an appropriate EGL frame buffer configuration, preferring one that can back a GLES3 context
+    result = choose_config(state->display, attribute_list_es3, &config, &num_config);
+    if(result == EGL_FALSE || num_config < 1) {
+        result = choose_config(state->display, attribute_list, &config, &num_config);
+        context_attributes[1] = 2;
+    }
     assert(EGL_FALSE != result);
 
     // get an appropriate EGL frame buffer configuration
@@ -80,7 +197,13 @@ void init_ogl(EGL_STATE_T *state)
 
     // create an EGL rendering context
     state->context = eglCreateContext(state->display, config, EGL_NO_CONTEXT, context_attributes);
+    if(state->context == EGL_NO_CONTEXT && context_attributes[1] == 3) {
+        // GLES3 config but no GLES3 context, fall back to GLES2
+        context_attributes[1] = 2;
+        state->context = eglCreateContext(state->display, config, EGL_NO_CONTEXT, context_attributes);
+    }
     assert(state->context!=EGL_NO_CONTEXT);
+    state->gles_version = context_attributes[1];
 
     // create an EGL window surface
     success = graphics_get_display_size(0 /* LCD */, &state->screen_width, &state->screen_height);
@@ -97,6 +220,7 @@ void init_ogl(EGL_STATE_T *state)
     src_rect.height = state->screen_height << 16;
 
     dispman_display = vc_dispmanx_display_open( 0 /* LCD */);
+    state->dispman_display = dispman_display;
     dispman_update = vc_dispmanx_update_start( 0 );
          
     dispman_element = vc_dispmanx_element_add ( dispman_update, dispman_display,
@@ -115,15 +239,394 @@ void init_ogl(EGL_STATE_T *state)
     result = eglMakeCurrent(state->display, state->surface, state->surface, state->context);
     assert(EGL_FALSE != result);
 
+    // GLES3 entry points can only be resolved once the context is current
+    if(state->gles_version >= 3 && !load_gles3_procs())
+        state->gles_version = 2;
+    printf("OpenGL|ES %d context\n", state->gles_version);
+
     // Set background color and clear buffers
     glClearColor(0.15f, 0.25f, 0.35f, 1.0f);
     glClear( GL_COLOR_BUFFER_BIT );
 
+    // Whether partial presents can rely on a preserved back buffer
+    EGLint surface_type = 0;
+    eglGetConfigAttrib(state->display, config, EGL_SURFACE_TYPE, &surface_type);
+    state->preserve_capable = (surface_type & EGL_SWAP_BEHAVIOR_PRESERVED_BIT) != 0;
+
+    // EGL default, one vsync per swap
+    state->swap_interval = 1;
+}
+
+static int rects_touch(const EGL_RECT_T *a, const EGL_RECT_T *b)
+{
+    return a->x <= b->x + b->width && b->x <= a->x + a->width
+           && a->y <= b->y + b->height && b->y <= a->y + a->height;
+}
+
+static void rect_union(EGL_RECT_T *a, const EGL_RECT_T *b)
+{
+    EGLint x1 = a->x + a->width > b->x + b->width ? a->x + a->width : b->x + b->width;
+    EGLint y1 = a->y + a->height > b->y + b->height ? a->y + a->height : b->y + b->height;
+
+    a->x = a->x < b->x ? a->x : b->x;
+    a->y = a->y < b->y ? a->y : b->y;
+    a->width = x1 - a->x;
+    a->height = y1 - a->y;
+}
+
+// Adds rect to region, merging it with any rectangle it touches
+static void region_add(EGL_REGION_T *region, EGL_RECT_T rect)
+{
+    int i;
+
+    // Merging can make the result touch rectangles it missed before, so start over each time
+    for(i=0; i<region->count; i++) {
+        if(rects_touch(&region->rects[i], &rect)) {
+            rect_union(&rect, &region->rects[i]);
+            region->rects[i] = region->rects[--region->count];
+            i = -1;
+        }
+    }
+
+    if(region->count == EGL_DAMAGE_MAX_RECTS) {
+        for(i=0; i<region->count; i++)
+            rect_union(&rect, &region->rects[i]);
+        region->count = 0;
+    }
+
+    region->rects[region->count++] = rect;
+}
+
+static void region_add_region(EGL_REGION_T *region, const EGL_REGION_T *other)
+{
+    int i;
+
+    for(i=0; i<other->count; i++)
+        region_add(region, other->rects[i]);
+}
+
+// Marks a window rectangle as changed this frame, origin bottom left
+void egl_damage_add(EGL_STATE_T *state, EGLint x, EGLint y, EGLint width, EGLint height)
+{
+    EGL_RECT_T rect;
+
+    // Clip to the window
+    if(x < 0) {
+        width += x;
+        x = 0;
+    }
+    if(y < 0) {
+        height += y;
+        y = 0;
+    }
+    if(x + width > (EGLint)state->screen_width)
+        width = state->screen_width - x;
+    if(y + height > (EGLint)state->screen_height)
+        height = state->screen_height - y;
+    if(width <= 0 || height <= 0)
+        return;
+
+    rect.x = x;
+    rect.y = y;
+    rect.width = width;
+    rect.height = height;
+    region_add(&state->damage, rect);
+}
+
+void egl_damage_all(EGL_STATE_T *state)
+{
+    egl_damage_add(state, 0, 0, state->screen_width, state->screen_height);
+}
+
+// Works out what must be drawn this frame. The caller draws once per returned
+// rectangle after egl_scissor(), an empty region means nothing changed.
+EGL_REGION_T *egl_begin_frame(EGL_STATE_T *state)
+{
+    EGLint age = 0;
+    int i;
+
+    state->repaint = state->damage;
+
+    if(state->buffer_age) {
+        eglQuerySurface(state->display, state->surface, EGL_BUFFER_AGE_EXT, &age);
+        // The back buffer is missing the damage of the age - 1 frames since it was shown
+        if(age > 0 && age - 1 <= state->history_count) {
+            for(i=0; i<age-1; i++)
+                region_add_region(&state->repaint, &state->history[i]);
+        }
+        else
+            age = 0;
+    }
+    else if(state->preserved)
+        age = 1;
+
+    // Unknown back buffer contents, redraw everything
+    if(age == 0) {
+        state->repaint.count = 1;
+        state->repaint.rects[0].x = 0;
+        state->repaint.rects[0].y = 0;
+        state->repaint.rects[0].width = state->screen_width;
+        state->repaint.rects[0].height = state->screen_height;
+        state->damage_stats.full_frames++;
+    }
+
+    // Tells the driver which parts of the back buffer it must keep
+    if(state->set_damage_region && state->repaint.count)
+        state->set_damage_region(state->display, state->surface, (EGLint*)state->repaint.rects, state->repaint.count);
+
+    state->damage_stats.frames++;
+    for(i=0; i<state->repaint.count; i++)
+        state->damage_stats.pixels += (unsigned long long)state->repaint.rects[i].width*state->repaint.rects[i].height;
+
+    return &state->repaint;
+}
+
+// Restricts drawing to rect, the scissor test is left off for full window rectangles
+void egl_scissor(EGL_STATE_T *state, const EGL_RECT_T *rect)
+{
+    if(rect->x == 0 && rect->y == 0 && rect->width == (EGLint)state->screen_width && rect->height == (EGLint)state->screen_height) {
+        glDisable(GL_SCISSOR_TEST);
+        return;
+    }
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(rect->x, rect->y, rect->width, rect->height);
+}
+
+// Vsyncs per swap, 0 presents at once and tears
+void egl_set_swap_interval(EGL_STATE_T *state, EGLint interval)
+{
+    if(!eglSwapInterval(state->display, interval)) {
+        printf("Swap interval %d not supported, keeping %d\n", interval, state->swap_interval);
+        return;
+    }
+    state->swap_interval = interval;
+}
+
+// Runs on the display's thread at every vsync
+static void pacing_vsync_callback(DISPMANX_UPDATE_HANDLE_T update, void *arg)
+{
+    EGL_PACING_T *pacing = arg;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    __atomic_store_n(&pacing->vsync_ns, (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec, __ATOMIC_RELEASE);
+}
+
+// Holds each frame back in egl_frame_wait() until just in time for the next
+// vsync, so uploads and draws use the newest rows available. margin_ms is kept
+// in hand on top of the worst recent frame time for the GPU to finish in.
+// With skip_late a frame that can no longer make its vsync is dropped rather
+// than shown a vsync late, the next one has newer rows for the same vsync.
+void egl_enable_pacing(EGL_STATE_T *state, double margin_ms, int skip_late)
+{
+    EGL_PACING_T *pacing = &state->pacing;
+    TV_DISPLAY_STATE_T tv;
+    double rate = 60.0;
+
+    if(!state->swap_interval) {
+        printf("Frame pacing needs a swap interval of at least 1\n");
+        return;
+    }
+
+    memset(pacing, 0, sizeof(EGL_PACING_T));
+    pacing->enabled = 1;
+    pacing->margin = margin_ms*1e-3;
+
+    // Partial update fixes the damage region for the frame, a skipped frame can not set it again
+    pacing->skip_late = skip_late && !state->set_damage_region;
+
+    // Seed the period from the HDMI mode, observed vsyncs refine it
+    if(vc_tv_get_display_state(&tv) == 0 && (tv.state & (VC_HDMI_HDMI | VC_HDMI_DVI)) && tv.display.hdmi.frame_rate)
+        rate = tv.display.hdmi.frame_rate;
+    pacing->period = 1.0/rate;
+
+    // Paced swaps return early, only the display knows when its vsyncs really are
+    pacing->vsync_source = vc_dispmanx_vsync_callback(state->dispman_display, pacing_vsync_callback, pacing) == 0;
+
+    printf("Frame pacing: %.2f Hz, swap interval %d, %.1f ms margin%s, vsync from the %s\n", rate, state->swap_interval,
+           margin_ms, pacing->skip_late ? ", late frames skipped" : "", pacing->vsync_source ? "display" : "blocked swaps");
+}
+
+// Moves the predicted vsync grid towards a vsync seen at time
+static void pacing_fit(EGL_PACING_T *pacing, double time)
+{
+    if(pacing->last_vsync == 0.0) {
+        pacing->last_vsync = time;
+        return;
+    }
+
+    double vsyncs = floor((time - pacing->last_vsync)/pacing->period + 0.5);
+    double grid = pacing->last_vsync + vsyncs*pacing->period;
+    double error = time - grid;
+    if(fabs(error) < pacing->period*0.25) {
+        if(vsyncs > 0)
+            pacing->period += error*EGL_PACING_PERIOD_GAIN/vsyncs;
+        grid += error*EGL_PACING_PHASE_GAIN;
+    }
+    else
+        grid = time;
+    pacing->last_vsync = grid;
+}
+
+// Sleeps until the latest time the next frame can start and still make a
+// vsync, call before taking in rows for the frame. Returns the vsync targeted,
+// 0 without pacing.
+double egl_frame_wait(EGL_STATE_T *state)
+{
+    EGL_PACING_T *pacing = &state->pacing;
+    double now = egl_time();
+
+    if(!pacing->enabled)
+        return 0.0;
+
+    // The display's latest vsync, exact where the grid is only a prediction
+    if(pacing->vsync_source) {
+        uint64_t vsync_ns = __atomic_load_n(&pacing->vsync_ns, __ATOMIC_ACQUIRE);
+        double vsync = vsync_ns*1e-9;
+        if(vsync_ns && vsync != pacing->last_vsync) {
+            pacing_fit(pacing, vsync);
+            pacing->last_vsync = vsync;
+        }
+    }
+
+    // Nothing to predict from before the first vsync, allow it a whole frame
+    double frame = pacing->period*state->swap_interval;
+    if(pacing->last_vsync == 0.0) {
+        pacing->frame_start = now;
+        pacing->deadline = now + frame;
+        return pacing->deadline;
+    }
+
+    // First vsync still reachable from now, a frame too late for one aims for the next
+    double lead = pacing->work_estimate + pacing->margin;
+    double deadline = pacing->last_vsync + frame;
+    if(deadline - lead < now)
+        deadline += ceil((now + lead - deadline)/frame)*frame;
+
+    double start = deadline - lead;
+    if(start > now) {
+        struct timespec ts;
+        ts.tv_sec = (time_t)start;
+        ts.tv_nsec = (long)((start - ts.tv_sec)*1e9);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        pacing->stats.waited += start - now;
+    }
+
+    pacing->frame_start = egl_time();
+    pacing->deadline = deadline;
+    return deadline;
+}
+
+// Decides whether the frame drawn since egl_frame_wait() is presented, 0 when
+// pacing skips it as too late. Call before work only a shown frame needs,
+// such as reading it back, egl_swap() keeps to the same answer.
+int egl_frame_presents(EGL_STATE_T *state)
+{
+    EGL_PACING_T *pacing = &state->pacing;
+
+    if(!pacing->enabled)
+        return 1;
+    if(pacing->decided)
+        return pacing->presents;
+
+    double now = egl_time();
+    double work = now - pacing->frame_start;
+    pacing->work_estimate = work > pacing->work_estimate ? work : pacing->work_estimate + (work - pacing->work_estimate)/32.0;
+    pacing->stats.frames++;
+    pacing->stats.work += work;
+    pacing->stats.slack += pacing->deadline - now;
+
+    pacing->decided = 1;
+    pacing->presents = 1;
+    if(now + pacing->margin > pacing->deadline) {
+        if(pacing->skip_late) {
+            pacing->stats.skipped++;
+            pacing->presents = 0;
+        }
+        else
+            pacing->stats.late++;
+    }
+    return pacing->presents;
 }
 
-void egl_swap(EGL_STATE_T *state)
+// Counts the vsyncs missed between presents. Without the display's vsyncs the
+// grid follows swaps that blocked, those return on a vsync. A swap that came
+// straight back returned whenever the frame was done, fitting to it would pull
+// the grid early by the margin every frame.
+static void pacing_swapped(EGL_STATE_T *state, double start, double now)
 {
-    eglSwapBuffers(state->display, state->surface);
+    EGL_PACING_T *pacing = &state->pacing;
+
+    if(pacing->last_swap != 0.0) {
+        long vsyncs = lround((now - pacing->last_swap)/pacing->period);
+        if(vsyncs > state->swap_interval)
+            pacing->stats.missed_vsyncs += vsyncs - state->swap_interval;
+    }
+    pacing->last_swap = now;
+
+    if(!pacing->vsync_source && (pacing->last_vsync == 0.0 || now - start > EGL_PACING_BLOCKED))
+        pacing_fit(pacing, now);
+}
+
+// Presents the frame, returns 0 when pacing skipped it as too late. The
+// damage of a skipped frame carries over to the next, whose drawing covers it.
+int egl_swap(EGL_STATE_T *state)
+{
+    EGL_PACING_T *pacing = &state->pacing;
+
+    glDisable(GL_SCISSOR_TEST);
+
+    // The answer holds for this frame only
+    int presents = egl_frame_presents(state);
+    pacing->decided = 0;
+    if(!presents)
+        return 0;
+
+    double start = egl_time();
+    if(state->swap_with_damage && state->damage.count)
+        state->swap_with_damage(state->display, state->surface, (EGLint*)state->damage.rects, state->damage.count);
+    else
+        eglSwapBuffers(state->display, state->surface);
+
+    if(pacing->enabled) {
+        pacing->stats.presented++;
+        pacing_swapped(state, start, egl_time());
+    }
+
+    // Remember this frame's damage for buffers that come back older
+    memmove(&state->history[1], &state->history[0], (EGL_DAMAGE_HISTORY - 1)*sizeof(EGL_REGION_T));
+    state->history[0] = state->damage;
+    if(state->history_count < EGL_DAMAGE_HISTORY)
+        state->history_count++;
+    state->damage.count = 0;
+
+    return 1;
+}
+
+void egl_print_pacing_stats(EGL_STATE_T *state)
+{
+    EGL_PACING_STATS_T *stats = &state->pacing.stats;
+
+    if(!stats->frames)
+        return;
+
+    printf("Pacing: %lu frames, %lu presented, %lu skipped, %lu late, %lu vsyncs missed, period %.3f ms\n",
+           stats->frames, stats->presented, stats->skipped, stats->late, stats->missed_vsyncs, state->pacing.period*1e3);
+    printf("Pacing: %.2f ms waited, %.2f ms of work, %.2f ms slack to the vsync per frame\n",
+           stats->waited*1e3/stats->frames, stats->work*1e3/stats->frames, stats->slack*1e3/stats->frames);
+}
+
+void egl_print_damage_stats(EGL_STATE_T *state)
+{
+    EGL_DAMAGE_STATS_T *stats = &state->damage_stats;
+
+    if(!stats->frames)
+        return;
+
+    printf("Damage: %lu frames, %lu full redraws, %.1f%% of the window repainted on average\n",
+           stats->frames, stats->full_frames,
+           100.0*stats->pixels/((double)stats->frames*state->screen_width*state->screen_height));
 }
 
 void exit_func(EGL_STATE_T *state)
@@ -133,6 +636,10 @@ void exit_func(EGL_STATE_T *state)
    glClear( GL_COLOR_BUFFER_BIT );
    eglSwapBuffers(state->display, state->surface);
 
+   // The callback writes into state, stop it first
+   if(state->pacing.vsync_source)
+       vc_dispmanx_vsync_callback(state->dispman_display, NULL, NULL);
+
    // Release OpenGL resources
    eglMakeCurrent( state->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
    eglDestroySurface( state->display, state->surface );
@@ -5,6 +5,75 @@
 #include "EGL/egl.h"
 #include "EGL/eglext.h"
 
+#include "bcm_host.h"
+
+// Rectangles in window coordinates, origin bottom left as for glScissor
+typedef struct {
+    EGLint x;
+    EGLint y;
+    EGLint width;
+    EGLint height;
+} EGL_RECT_T;
+
+// Damage kept as a few disjoint rectangles, collapsed to their bounds when full
+#define EGL_DAMAGE_MAX_RECTS 8
+
+// Frames of damage remembered for buffer age based repaints
+#define EGL_DAMAGE_HISTORY 4
+
+typedef struct {
+    EGL_RECT_T rects[EGL_DAMAGE_MAX_RECTS];
+    int count;
+} EGL_REGION_T;
+
+typedef struct {
+    unsigned long frames;
+    unsigned long full_frames;
+    unsigned long long pixels;
+} EGL_DAMAGE_STATS_T;
+
+// Frame times are summed, divide by frames for the average
+typedef struct {
+    unsigned long frames;
+    unsigned long presented;
+    unsigned long skipped;
+    unsigned long late;
+    unsigned long missed_vsyncs;
+    double waited;
+    double work;
+    double slack;
+} EGL_PACING_STATS_T;
+
+typedef struct {
+    int enabled;
+    int skip_late;
+    double margin;
+
+    // Vsync grid seeded from the display mode. Kept on the vsyncs the display
+    // reports when it can, else on swaps that blocked until one.
+    double period;
+    double last_vsync;
+    double last_swap;
+    int vsync_source;
+
+    // CLOCK_MONOTONIC nanoseconds of the latest vsync, written by the display's thread
+    uint64_t vsync_ns;
+
+    // Whether the frame being finished is presented, decided once per frame
+    int decided;
+    int presents;
+
+    // Frame start to swap, jumps up at once and decays slowly so starts stay safe
+    double work_estimate;
+    double frame_start;
+    double deadline;
+
+    EGL_PACING_STATS_T stats;
+} EGL_PACING_T;
+
+typedef EGLBoolean (*EGL_SWAP_WITH_DAMAGE_PROC_T)(EGLDisplay display, EGLSurface surface, EGLint *rects, EGLint count);
+typedef EGLBoolean (*EGL_SET_DAMAGE_REGION_PROC_T)(EGLDisplay display, EGLSurface surface, EGLint *rects, EGLint count);
+
 typedef struct {
     uint32_t screen_width;
     uint32_t screen_height;
@@ -12,6 +81,28 @@ typedef struct {
     EGLDisplay display;
     EGLSurface surface;
     EGLContext context;
+    DISPMANX_DISPLAY_HANDLE_T dispman_display;
+
+    // Client API version of the context, 3 when a GLES3 context was available
+    int gles_version;
+
+    // Partial present support, see egl_enable_damage()
+    int preserve_capable;
+    int preserved;
+    int buffer_age;
+    EGL_SWAP_WITH_DAMAGE_PROC_T swap_with_damage;
+    EGL_SET_DAMAGE_REGION_PROC_T set_damage_region;
+
+    // Damage for the frame being built, the area to repaint, and earlier frames newest first
+    EGL_REGION_T damage;
+    EGL_REGION_T repaint;
+    EGL_REGION_T history[EGL_DAMAGE_HISTORY];
+    int history_count;
+    EGL_DAMAGE_STATS_T damage_stats;
+
+    // Vsyncs per swap and frame deadlines, see egl_enable_pacing()
+    EGLint swap_interval;
+    EGL_PACING_T pacing;
 
     int keyboard_fd;
 } EGL_STATE_T;
@@ -20,7 +111,19 @@ typedef struct {
 void init_ogl(EGL_STATE_T *state);
 void exit_func(EGL_STATE_T *state);
 void showlog(GLint shader);
-void egl_swap(EGL_STATE_T *state);
+int egl_swap(EGL_STATE_T *state);
+void egl_set_swap_interval(EGL_STATE_T *state, EGLint interval);
+void egl_enable_pacing(EGL_STATE_T *state, double margin_ms, int skip_late);
+double egl_frame_wait(EGL_STATE_T *state);
+int egl_frame_presents(EGL_STATE_T *state);
+void egl_print_pacing_stats(EGL_STATE_T *state);
+int egl_has_extension(EGL_STATE_T *state, const char *name);
+void egl_enable_damage(EGL_STATE_T *state, int full_back_buffer);
+void egl_damage_add(EGL_STATE_T *state, EGLint x, EGLint y, EGLint width, EGLint height);
+void egl_damage_all(EGL_STATE_T *state);
+EGL_REGION_T *egl_begin_frame(EGL_STATE_T *state);
+void egl_scissor(EGL_STATE_T *state, const EGL_RECT_T *rect);
+void egl_print_damage_stats(EGL_STATE_T *state);
 void check();
 int get_key_press(EGL_STATE_T *state);
 
@@ -0,0 +1,71 @@
+#ifndef GLES3_COMPAT_H
+#define GLES3_COMPAT_H
+
+#include <stdint.h>
+
+#include "GLES2/gl2.h"
+
+// The Pi firmware SDK only ships GLES2 headers and libGLESv2 does not
+// export the GLES3 entry points, so the few we use are declared here and
+// looked up with eglGetProcAddress once a GLES3 context is current.
+
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_UNPACK_ROW_LENGTH
+#define GL_UNPACK_ROW_LENGTH 0x0CF2
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT 0x0001
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_INVALIDATE_BUFFER_BIT
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#endif
+#ifndef GL_MAP_UNSYNCHRONIZED_BIT
+#define GL_MAP_UNSYNCHRONIZED_BIT 0x0020
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED 0x911B
+#endif
+#ifndef GL_WAIT_FAILED
+#define GL_WAIT_FAILED 0x911D
+#endif
+
+typedef struct __GLsync *GL3_SYNC_T;
+
+typedef struct
+{
+    void *(GL_APIENTRY *map_buffer_range)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+    GLboolean (GL_APIENTRY *unmap_buffer)(GLenum target);
+    GL3_SYNC_T (GL_APIENTRY *fence_sync)(GLenum condition, GLbitfield flags);
+    GLenum (GL_APIENTRY *client_wait_sync)(GL3_SYNC_T sync, GLbitfield flags, uint64_t timeout);
+    void (GL_APIENTRY *delete_sync)(GL3_SYNC_T sync);
+} GLES3_PROCS_T;
+
+// Filled in by init_ogl() when a GLES3 context was created
+extern GLES3_PROCS_T gles3;
+
+int load_gles3_procs();
+
+#endif
@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include "mesh.h"
+#include "shader_utils.h"
+
+#include "GLES2/gl2.h"
+
+// Converts a value in -1.0..1.0 to a normalised short
+GLshort mesh_quantise(float value)
+{
+    if(value > 1.0f)
+        value = 1.0f;
+    if(value < -1.0f)
+        value = -1.0f;
+
+    float scaled = value*32767.0f;
+    return (GLshort)(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+}
+
+// 32 bit indices need OES_element_index_uint on GLES2
+static int uint_indices_supported()
+{
+    static int uint_support = -1;
+
+    if(uint_support < 0)
+        uint_support = gl_has_extension("GL_OES_element_index_uint");
+    return uint_support;
+}
+
+// Returns the smallest index type able to address vertex_count vertices, 0 if there is none
+GLenum mesh_index_type(GLsizei vertex_count)
+{
+    if(vertex_count <= 256)
+        return GL_UNSIGNED_BYTE;
+    if(vertex_count <= 65536)
+        return GL_UNSIGNED_SHORT;
+
+    return uint_indices_supported() ? GL_UNSIGNED_INT : 0;
+}
+
+// Uploads vertices and indices to static buffers, returns 0 if the indices can not be represented
+int mesh_create(MESH_T *mesh, const MESH_VERTEX_T *vertices, GLsizei vertex_count, const GLuint *indices, GLsizei index_count)
+{
+    GLsizei i;
+    void *packed;
+    GLenum index_type = mesh_index_type(vertex_count);
+
+    if(!index_type) {
+        memset(mesh, 0, sizeof(MESH_T));
+        printf("mesh: %d vertices need 32 bit indices, split the mesh\n", (int)vertex_count);
+        return 0;
+    }
+
+    // Narrow indices to the chosen type
+    switch(index_type) {
+        case GL_UNSIGNED_BYTE:
+            packed = malloc(index_count*sizeof(GLubyte));
+            assert(packed);
+            for(i=0; i<index_count; i++)
+                ((GLubyte*)packed)[i] = (GLubyte)indices[i];
+            break;
+        case GL_UNSIGNED_SHORT:
+            packed = malloc(index_count*sizeof(GLushort));
+            assert(packed);
+            for(i=0; i<index_count; i++)
+                ((GLushort*)packed)[i] = (GLushort)indices[i];
+            break;
+        default:
+            packed = NULL;
+            break;
+    }
+
+    int created = mesh_create_packed(mesh, vertices, vertex_count, packed ? packed : (const void*)indices, index_type, index_count);
+    free(packed);
+
+    return created;
+}
+
+// Uploads indices already narrowed to index_type as they are, such as from
+// a mapped file. Returns 0 if the GPU can not take index_type.
+int mesh_create_packed(MESH_T *mesh, const MESH_VERTEX_T *vertices, GLsizei vertex_count, const void *indices,
+                       GLenum index_type, GLsizei index_count)
+{
+    memset(mesh, 0, sizeof(MESH_T));
+
+    if(index_type == GL_UNSIGNED_INT && !uint_indices_supported()) {
+        printf("mesh: 32 bit indices are not supported, split the mesh\n");
+        return 0;
+    }
+
+    mesh->index_type = index_type;
+    mesh->index_size = index_type == GL_UNSIGNED_BYTE ? sizeof(GLubyte)
+                     : index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    mesh->vertex_count = vertex_count;
+    mesh->index_count = index_count;
+
+    // Generate vertex buffer
+    glGenBuffers(1, &mesh->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertex_count*sizeof(MESH_VERTEX_T), vertices, GL_STATIC_DRAW);
+
+    // Generate element buffer
+    glGenBuffers(1, &mesh->ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count*mesh->index_size, indices, GL_STATIC_DRAW);
+
+    return 1;
+}
+
+// Binds the mesh buffers and points the attributes at them, a location of -1 is skipped
+void mesh_bind(MESH_T *mesh, GLint position_location, GLint tex_coord_location)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
+
+    if(position_location >= 0) {
+        glVertexAttribPointer(position_location, 2, GL_SHORT, GL_TRUE, sizeof(MESH_VERTEX_T),
+                              (void*)offsetof(MESH_VERTEX_T, position));
+        glEnableVertexAttribArray(position_location);
+    }
+    if(tex_coord_location >= 0) {
+        glVertexAttribPointer(tex_coord_location, 2, GL_SHORT, GL_TRUE, sizeof(MESH_VERTEX_T),
+                              (void*)offsetof(MESH_VERTEX_T, tex_coord));
+        glEnableVertexAttribArray(tex_coord_location);
+    }
+}
+
+// Draws count indices starting at index first
+void mesh_draw(MESH_T *mesh, GLenum mode, GLsizei first, GLsizei count)
+{
+    assert(first + count <= mesh->index_count);
+    glDrawElements(mode, count, mesh->index_type, (void*)(size_t)(first*mesh->index_size));
+}
+
+void mesh_destroy(MESH_T *mesh)
+{
+    glDeleteBuffers(1, &mesh->vbo);
+    glDeleteBuffers(1, &mesh->ebo);
+    memset(mesh, 0, sizeof(MESH_T));
+}
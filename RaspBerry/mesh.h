@@ -0,0 +1,36 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "GLES2/gl2.h"
+
+// Interleaved vertex with positions and texture coordinates stored as
+// normalised shorts, -32767..32767 maps to -1.0..1.0, half the size of floats
+typedef struct
+{
+    GLshort position[2];
+    GLshort tex_coord[2];
+} MESH_VERTEX_T;
+
+typedef struct
+{
+    GLuint vbo;
+    GLuint ebo;
+
+    // GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLenum index_type;
+    GLsizei index_size;
+
+    GLsizei vertex_count;
+    GLsizei index_count;
+} MESH_T;
+
+GLshort mesh_quantise(float value);
+GLenum mesh_index_type(GLsizei vertex_count);
+int mesh_create(MESH_T *mesh, const MESH_VERTEX_T *vertices, GLsizei vertex_count, const GLuint *indices, GLsizei index_count);
+int mesh_create_packed(MESH_T *mesh, const MESH_VERTEX_T *vertices, GLsizei vertex_count, const void *indices,
+                       GLenum index_type, GLsizei index_count);
+void mesh_bind(MESH_T *mesh, GLint position_location, GLint tex_coord_location);
+void mesh_draw(MESH_T *mesh, GLenum mode, GLsizei first, GLsizei count);
+void mesh_destroy(MESH_T *mesh);
+
+#endif
@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+
+#include "render_target.h"
+#include "shader_utils.h"
+#include "tex_alloc.h"
+
+#include "GLES2/gl2.h"
+
+// Fractions of the largest scale for each level
+static const GLfloat scale_levels[RENDER_SCALE_LEVELS] = { 1.0f, 0.85f, 0.7f, 0.6f, 0.5f };
+
+// Scale down above budget*OVER, try scaling up below budget*UNDER
+#define RENDER_SCALE_OVER 1.10
+#define RENDER_SCALE_UNDER 1.02
+#define RENDER_SCALE_MAX_BACKOFF 16
+
+static const GLchar* composite_vertex_source =
+    "attribute vec2 position;"
+    "uniform vec2 uv_scale;"
+    "varying vec2 uv;"
+    "void main() {"
+    "   uv = (position*0.5 + 0.5)*uv_scale;"
+    "   gl_Position = vec4(position, 0.0, 1.0);"
+    "}";
+
+// Linear filtering at the edge of the rendered area would blend in texels
+// beyond it, left over from a larger scale, so uv stays half a texel inside
+static const GLchar* composite_fragment_source =
+    "precision mediump float;"
+    "uniform sampler2D source;"
+    "uniform vec2 uv_min;"
+    "uniform vec2 uv_max;"
+    "varying vec2 uv;"
+    "void main() {"
+    "   gl_FragColor = texture2D(source, clamp(uv, uv_min, uv_max));"
+    "}";
+
+static double render_target_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void set_level(RENDER_TARGET_T *target, int level)
+{
+    target->level = level;
+    target->scale = target->max_scale*scale_levels[level];
+    target->width = (GLsizei)(target->window_width*target->scale + 0.5f);
+    target->height = (GLsizei)(target->window_height*target->scale + 0.5f);
+    target->frames_since_switch = 0;
+}
+
+// Texture memory is short, halve the buffer dimensions rather than hold
+// memory the panes need. Rendering carries on at a lower resolution.
+static void evict_buffer(void *owner, GLuint texture)
+{
+    RENDER_TARGET_T *target = owner;
+    GLfloat max_scale = target->max_scale*0.5f;
+
+    if(max_scale < RENDER_SCALE_MIN_MAX_SCALE)
+        return;
+
+    GLsizei width = (GLsizei)(target->window_width*max_scale);
+    GLsizei height = (GLsizei)(target->window_height*max_scale);
+
+    glActiveTexture(GL_TEXTURE0 + RENDER_TARGET_UNIT);
+    if(!tex_alloc_resize(texture, width, height, NULL))
+        return;
+
+    target->max_scale = max_scale;
+    target->buffer_width = width;
+    target->buffer_height = height;
+    target->reallocated = 1;
+    target->stats.evictions++;
+    set_level(target, target->level);
+
+    printf("Render target: shrunk to %dx%d for texture memory\n", width, height);
+
+    if(max_scale*0.5f >= RENDER_SCALE_MIN_MAX_SCALE)
+        tex_alloc_set_evict(texture, evict_buffer, target);
+}
+
+// Renders at up to the window size, budget_ms is the frame time to hold.
+// Returns 0 when not even the smallest buffer fits in texture memory.
+int render_target_init(RENDER_TARGET_T *target, GLsizei window_width, GLsizei window_height, double budget_ms)
+{
+    GLint max_texture = 0, max_renderbuffer = 0;
+    const GLfloat quad[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+    memset(target, 0, sizeof(RENDER_TARGET_T));
+    target->window_width = window_width;
+    target->window_height = window_height;
+    target->budget = budget_ms*1e-3;
+    target->probe_backoff = 1;
+
+    // VideoCore IV tops out at 2048, so large panels never render at full size
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture);
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_renderbuffer);
+    GLint max_size = max_texture < max_renderbuffer ? max_texture : max_renderbuffer;
+    target->max_scale = 1.0f;
+    if(window_width > max_size)
+        target->max_scale = (GLfloat)max_size/window_width;
+    if(window_height*target->max_scale > max_size)
+        target->max_scale = (GLfloat)max_size/window_height;
+
+    // Colour buffer, lower scales render into its bottom left corner. Under
+    // a tight budget a smaller buffer is better than none.
+    glActiveTexture(GL_TEXTURE0 + RENDER_TARGET_UNIT);
+    while(1) {
+        target->buffer_width = (GLsizei)(window_width*target->max_scale);
+        target->buffer_height = (GLsizei)(window_height*target->max_scale);
+        target->texture = tex_alloc_create("render target", GL_RGBA, target->buffer_width, target->buffer_height, NULL);
+        if(target->texture)
+            break;
+        if(target->max_scale*0.5f < RENDER_SCALE_MIN_MAX_SCALE) {
+            memset(target, 0, sizeof(RENDER_TARGET_T));
+            return 0;
+        }
+        target->max_scale *= 0.5f;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &target->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->texture, 0);
+    assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Upscale pass, one quad over the window
+    target->program = load_program(composite_vertex_source, composite_fragment_source);
+    target->position_location = glGetAttribLocation(target->program, "position");
+    target->source_location = glGetUniformLocation(target->program, "source");
+    target->uv_scale_location = glGetUniformLocation(target->program, "uv_scale");
+    target->uv_min_location = glGetUniformLocation(target->program, "uv_min");
+    target->uv_max_location = glGetUniformLocation(target->program, "uv_max");
+
+    glGenBuffers(1, &target->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, target->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+    set_level(target, 0);
+
+    // Only worth its memory while it still holds a reasonable resolution
+    if(target->max_scale*0.5f >= RENDER_SCALE_MIN_MAX_SCALE)
+        tex_alloc_set_evict(target->texture, evict_buffer, target);
+
+    printf("Render target: up to %dx%d for a %dx%d window, %.1f ms budget\n",
+           target->buffer_width, target->buffer_height, window_width, window_height, budget_ms);
+    return 1;
+}
+
+// Measures the last frame and picks the scale for the next, call once per
+// frame before drawing. Returns non zero when the scale changed, which
+// invalidates everything in the offscreen buffer.
+int render_target_update(RENDER_TARGET_T *target)
+{
+    double now = render_target_time();
+    int level = target->level;
+
+    target->stats.frames++;
+    target->frames_since_switch++;
+
+    // Shrinking the buffer lost its contents, the frame time check can wait
+    if(target->reallocated) {
+        target->reallocated = 0;
+        target->last_time = now;
+        return 1;
+    }
+
+    if(target->last_time > 0.0) {
+        double elapsed = now - target->last_time;
+        // Exponential average over roughly the last 16 frames
+        target->frame_time = target->frame_time > 0.0 ? target->frame_time + (elapsed - target->frame_time)/16.0 : elapsed;
+    }
+    target->last_time = now;
+
+    if(target->frames_since_switch < RENDER_SCALE_SETTLE_FRAMES)
+        return 0;
+
+    // Scaling up held through the settle period, probe quickly again
+    if(target->last_switch_up && target->frame_time <= target->budget*RENDER_SCALE_OVER) {
+        target->probe_backoff = 1;
+        target->last_switch_up = 0;
+    }
+
+    if(target->frame_time > target->budget*RENDER_SCALE_OVER && level < RENDER_SCALE_LEVELS - 1) {
+        // Scaling up did not hold, wait longer before the next attempt
+        if(target->last_switch_up && target->probe_backoff < RENDER_SCALE_MAX_BACKOFF)
+            target->probe_backoff *= 2;
+        target->last_switch_up = 0;
+        target->stats.downscales++;
+        level++;
+    }
+    else if(target->frame_time < target->budget*RENDER_SCALE_UNDER && level > 0
+            && target->frames_since_switch >= (unsigned long)RENDER_SCALE_SETTLE_FRAMES*target->probe_backoff) {
+        // Frame time does not drop below a vsync interval, so headroom can
+        // only be found by trying the next scale up
+        target->last_switch_up = 1;
+        target->stats.upscales++;
+        level--;
+    }
+    else {
+        // A scale that has held for a long while earns back quick probing
+        if(target->frames_since_switch >= (unsigned long)RENDER_SCALE_SETTLE_FRAMES*RENDER_SCALE_MAX_BACKOFF)
+            target->probe_backoff = 1;
+        return 0;
+    }
+
+    target->stats.switches++;
+    printf("Render scale %.2f, frame %.1f ms against %.1f ms budget\n",
+           target->max_scale*scale_levels[level], target->frame_time*1e3, target->budget*1e3);
+    set_level(target, level);
+    return 1;
+}
+
+// Directs drawing into the offscreen buffer at the current scale
+void render_target_begin(RENDER_TARGET_T *target)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+    glViewport(0, 0, target->width, target->height);
+}
+
+// Scissors offscreen drawing to a window rectangle scaled down to the buffer
+void render_target_scissor(RENDER_TARGET_T *target, const EGL_RECT_T *rect)
+{
+    GLint x0 = (GLint)floorf(rect->x*target->scale);
+    GLint y0 = (GLint)floorf(rect->y*target->scale);
+    GLint x1 = (GLint)ceilf((rect->x + rect->width)*target->scale);
+    GLint y1 = (GLint)ceilf((rect->y + rect->height)*target->scale);
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x0, y0, x1 - x0, y1 - y0);
+}
+
+// Back to the window surface
+void render_target_end(RENDER_TARGET_T *target)
+{
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, target->window_width, target->window_height);
+}
+
+// Upscales the rendered area over the window, honours the current scissor
+void render_target_composite(RENDER_TARGET_T *target)
+{
+    tex_alloc_touch(target->texture);
+
+    glUseProgram(target->program);
+    glUniform1i(target->source_location, RENDER_TARGET_UNIT);
+    glUniform2f(target->uv_scale_location, (GLfloat)target->width/target->buffer_width,
+                (GLfloat)target->height/target->buffer_height);
+    glUniform2f(target->uv_min_location, 0.5f/target->buffer_width, 0.5f/target->buffer_height);
+    glUniform2f(target->uv_max_location, (target->width - 0.5f)/target->buffer_width,
+                (target->height - 0.5f)/target->buffer_height);
+
+    glBindBuffer(GL_ARRAY_BUFFER, target->vbo);
+    glVertexAttribPointer(target->position_location, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(target->position_location);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDisableVertexAttribArray(target->position_location);
+}
+
+void render_target_print_stats(RENDER_TARGET_T *target)
+{
+    RENDER_SCALE_STATS_T *stats = &target->stats;
+
+    printf("Render target: scale %.2f, %lu switches (%lu down, %lu up), %lu evictions over %lu frames\n",
+           target->scale, stats->switches, stats->downscales, stats->upscales, stats->evictions, stats->frames);
+}
+
+void render_target_destroy(RENDER_TARGET_T *target)
+{
+    glDeleteFramebuffers(1, &target->fbo);
+    tex_alloc_delete(target->texture);
+    glDeleteBuffers(1, &target->vbo);
+    memset(target, 0, sizeof(RENDER_TARGET_T));
+}
@@ -0,0 +1,78 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include "GLES2/gl2.h"
+#include "egl_utils.h"
+
+// Texture unit the offscreen colour buffer stays bound to for compositing
+#define RENDER_TARGET_UNIT 5
+
+// Scale steps tried, relative to the largest size the GPU can render
+#define RENDER_SCALE_LEVELS 5
+
+// Frames to wait after a switch before judging the new scale
+#define RENDER_SCALE_SETTLE_FRAMES 60
+
+// Smallest largest-scale the buffer is shrunk to under texture memory pressure
+#define RENDER_SCALE_MIN_MAX_SCALE 0.25f
+
+typedef struct
+{
+    unsigned long frames;
+    unsigned long switches;
+    unsigned long downscales;
+    unsigned long upscales;
+    unsigned long evictions;
+} RENDER_SCALE_STATS_T;
+
+typedef struct
+{
+    // Window size and the offscreen buffer, allocated once at the largest scale
+    GLsizei window_width;
+    GLsizei window_height;
+    GLsizei buffer_width;
+    GLsizei buffer_height;
+    GLuint fbo;
+    GLuint texture;
+
+    // Current scale level and the area of the buffer rendered at it
+    int level;
+    GLfloat scale;
+    GLsizei width;
+    GLsizei height;
+    GLfloat max_scale;
+
+    // Buffer shrunk to free texture memory, contents are lost
+    int reallocated;
+
+    // Smoothed frame time against the budget, both in seconds
+    double budget;
+    double frame_time;
+    double last_time;
+    unsigned long frames_since_switch;
+
+    // Failed attempts to scale up push the next attempt further out
+    int probe_backoff;
+    int last_switch_up;
+
+    GLuint program;
+    GLint position_location;
+    GLint source_location;
+    GLint uv_scale_location;
+    GLint uv_min_location;
+    GLint uv_max_location;
+    GLuint vbo;
+
+    RENDER_SCALE_STATS_T stats;
+} RENDER_TARGET_T;
+
+int render_target_init(RENDER_TARGET_T *target, GLsizei window_width, GLsizei window_height, double budget_ms);
+int render_target_update(RENDER_TARGET_T *target);
+void render_target_begin(RENDER_TARGET_T *target);
+void render_target_scissor(RENDER_TARGET_T *target, const EGL_RECT_T *rect);
+void render_target_end(RENDER_TARGET_T *target);
+void render_target_composite(RENDER_TARGET_T *target);
+void render_target_print_stats(RENDER_TARGET_T *target);
+void render_target_destroy(RENDER_TARGET_T *target);
+
+#endif
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "scene.h"
+
+#include "GLES2/gl2.h"
+
+static double scene_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Block of count items of size bytes at offset lies inside the file
+static int block_fits(uint32_t offset, uint32_t count, uint32_t size, size_t file_size)
+{
+    return offset % SCENE_ALIGN == 0 && (uint64_t)offset + (uint64_t)count*size <= file_size;
+}
+
+// Largest index, a bad one would have the GPU read outside the vertex buffer
+static uint32_t max_index(const void *indices, uint32_t count, uint32_t size)
+{
+    uint32_t i, max = 0;
+
+    for(i=0; i<count; i++) {
+        uint32_t index = size == 1 ? ((const uint8_t*)indices)[i]
+                       : size == 2 ? ((const uint16_t*)indices)[i] : ((const uint32_t*)indices)[i];
+        if(index > max)
+            max = index;
+    }
+    return max;
+}
+
+// Maps a scene file and uploads its blocks straight from the mapping.
+// Returns 0 if the file can not be read or is not a valid scene.
+int scene_load(SCENE_T *scene, const char *path)
+{
+    double start = scene_time();
+    struct stat st;
+    uint32_t i;
+
+    assert(sizeof(SCENE_VERTEX_T) == sizeof(MESH_VERTEX_T));
+    memset(scene, 0, sizeof(SCENE_T));
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        printf("Can not open scene %s\n", path);
+        return 0;
+    }
+    fstat(fd, &st);
+    size_t size = st.st_size;
+    if(size < sizeof(SCENE_HEADER_T)) {
+        printf("Scene %s is too short\n", path);
+        close(fd);
+        return 0;
+    }
+
+    // Faulted in up front, every page is about to be read anyway
+    const uint8_t *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    assert(map != MAP_FAILED);
+
+    const SCENE_HEADER_T *header = (const SCENE_HEADER_T*)map;
+    const SCENE_DRAW_T *draws = (const SCENE_DRAW_T*)(map + header->draw_offset);
+    int valid = header->magic == SCENE_MAGIC && header->version == SCENE_VERSION
+                && (header->index_size == 1 || header->index_size == 2 || header->index_size == 4)
+                && block_fits(header->vertex_offset, header->vertex_count, sizeof(SCENE_VERTEX_T), size)
+                && block_fits(header->index_offset, header->index_count, header->index_size, size)
+                && block_fits(header->draw_offset, header->draw_count, sizeof(SCENE_DRAW_T), size);
+    for(i=0; valid && i<header->draw_count; i++)
+        valid = draws[i].mode <= GL_TRIANGLE_FAN && (uint64_t)draws[i].first + draws[i].count <= header->index_count;
+    if(valid && header->index_count)
+        valid = max_index(map + header->index_offset, header->index_count, header->index_size) < header->vertex_count;
+    if(!valid) {
+        printf("Scene %s is not a valid version %d scene\n", path, SCENE_VERSION);
+        munmap((void*)map, size);
+        return 0;
+    }
+
+    GLenum index_type = header->index_size == 1 ? GL_UNSIGNED_BYTE
+                      : header->index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    int created = mesh_create_packed(&scene->mesh, (const MESH_VERTEX_T*)(map + header->vertex_offset), header->vertex_count,
+                                     map + header->index_offset, index_type, header->index_count);
+
+    // The GPU has its own copy now, only the small draw table is kept
+    if(created) {
+        scene->draw_count = header->draw_count;
+        scene->draws = malloc(header->draw_count*sizeof(SCENE_DRAW_T));
+        assert(scene->draws || !header->draw_count);
+        memcpy(scene->draws, draws, header->draw_count*sizeof(SCENE_DRAW_T));
+    }
+    munmap((void*)map, size);
+    if(!created)
+        return 0;
+
+    scene->load_ms = (scene_time() - start)*1e3;
+    printf("Scene %s: %u vertices, %u indices in %d draws, loaded in %.2f ms\n", path, header->vertex_count,
+           scene->mesh.index_count, scene->draw_count, scene->load_ms);
+
+    return 1;
+}
+
+// Draws every range with the program in use, a location of -1 is skipped
+void scene_draw(SCENE_T *scene, GLint position_location, GLint tex_coord_location, GLint color_location)
+{
+    GLsizei i;
+
+    mesh_bind(&scene->mesh, position_location, tex_coord_location);
+    for(i=0; i<scene->draw_count; i++) {
+        SCENE_DRAW_T *draw = &scene->draws[i];
+        if(color_location >= 0)
+            glUniform4f(color_location, (draw->color & 0xff)/255.0f, ((draw->color >> 8) & 0xff)/255.0f,
+                        ((draw->color >> 16) & 0xff)/255.0f, (draw->color >> 24)/255.0f);
+        mesh_draw(&scene->mesh, draw->mode, draw->first, draw->count);
+    }
+}
+
+void scene_destroy(SCENE_T *scene)
+{
+    mesh_destroy(&scene->mesh);
+    free(scene->draws);
+    memset(scene, 0, sizeof(SCENE_T));
+}
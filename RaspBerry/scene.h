@@ -0,0 +1,23 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "GLES2/gl2.h"
+#include "mesh.h"
+#include "scene_format.h"
+
+// Static geometry loaded from a scene_convert file, one mesh drawn in ranges
+typedef struct
+{
+    MESH_T mesh;
+    SCENE_DRAW_T *draws;
+    GLsizei draw_count;
+
+    // Milliseconds from open to the buffers being handed to the GPU
+    double load_ms;
+} SCENE_T;
+
+int scene_load(SCENE_T *scene, const char *path);
+void scene_draw(SCENE_T *scene, GLint position_location, GLint tex_coord_location, GLint color_location);
+void scene_destroy(SCENE_T *scene);
+
+#endif
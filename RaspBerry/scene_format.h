@@ -0,0 +1,55 @@
+#ifndef SCENE_FORMAT_H
+#define SCENE_FORMAT_H
+
+#include <stdint.h>
+
+// Binary scene file, written by scene_convert and mapped by scene_load()
+//
+// A SCENE_HEADER_T at offset 0 is followed by three blocks, each starting
+// on a SCENE_ALIGN boundary given by its offset in the header:
+//
+//   vertices  vertex_count SCENE_VERTEX_T, interleaved as MESH_VERTEX_T
+//   indices   index_count indices of index_size bytes, already narrowed
+//   draws     draw_count SCENE_DRAW_T, ranges of the indices
+//
+// Everything is little endian and laid out as the GPU takes it, so the
+// vertex and index blocks go from the mapping straight to glBufferData.
+#define SCENE_MAGIC 0x4e435353
+#define SCENE_VERSION 1
+#define SCENE_ALIGN 64
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t index_count;
+
+    // 1, 2 or 4, the smallest that addresses vertex_count vertices
+    uint32_t index_size;
+    uint32_t draw_count;
+    uint32_t vertex_offset;
+    uint32_t index_offset;
+    uint32_t draw_offset;
+    uint32_t reserved[7];
+} SCENE_HEADER_T;
+
+// Normalised shorts, -32767..32767 maps to -1.0..1.0
+typedef struct
+{
+    int16_t position[2];
+    int16_t tex_coord[2];
+} SCENE_VERTEX_T;
+
+typedef struct
+{
+    // GL_TRIANGLES or GL_LINES
+    uint32_t mode;
+    uint32_t first;
+    uint32_t count;
+
+    // RGBA, red in the lowest byte
+    uint32_t color;
+} SCENE_DRAW_T;
+
+#endif
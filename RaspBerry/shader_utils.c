@@ -0,0 +1,285 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "shader_utils.h"
+
+#include "GLES2/gl2.h"
+#include "GLES2/gl2ext.h"
+#include "EGL/egl.h"
+
+#ifndef GL_PROGRAM_BINARY_LENGTH_OES
+#define GL_PROGRAM_BINARY_LENGTH_OES 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS_OES
+#define GL_NUM_PROGRAM_BINARY_FORMATS_OES 0x87FE
+#endif
+
+// Identifies a cache file written by this version of the cache
+#define PROGRAM_CACHE_MAGIC 0x50524731
+
+// Cache file names, the temporary name appends the pid to it
+#define PROGRAM_CACHE_PATH_MAX 512
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t binary_format;
+    uint32_t length;
+} PROGRAM_CACHE_HEADER_T;
+
+typedef void (GL_APIENTRY *GET_PROGRAM_BINARY_T)(GLuint program, GLsizei buf_size, GLsizei *length, GLenum *binary_format, void *binary);
+typedef void (GL_APIENTRY *PROGRAM_BINARY_T)(GLuint program, GLenum binary_format, const void *binary, GLint length);
+
+static GET_PROGRAM_BINARY_T get_program_binary;
+static PROGRAM_BINARY_T program_binary;
+static int binary_support = -1;
+
+static void print_shader_log(GLuint shader)
+{
+    char log[1024];
+    glGetShaderInfoLog(shader, sizeof log, NULL, log);
+    if(log[0])
+        printf("%d:shader:\n%s\n", shader, log);
+}
+
+static void print_program_log(GLuint program)
+{
+    char log[1024];
+    glGetProgramInfoLog(program, sizeof log, NULL, log);
+    if(log[0])
+        printf("%d:program:\n%s\n", program, log);
+}
+
+// Non zero when name is a whole entry of a space separated extension string,
+// a plain substring search would also match longer names it prefixes
+int extension_listed(const char *extensions, const char *name)
+{
+    size_t length = strlen(name);
+    const char *found = extensions;
+
+    while(extensions && (found = strstr(found, name))) {
+        if((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0'))
+            return 1;
+        found += length;
+    }
+    return 0;
+}
+
+// Non zero when the current GL context lists the extension
+int gl_has_extension(const char *name)
+{
+    return extension_listed((const char*)glGetString(GL_EXTENSIONS), name);
+}
+
+// 64 bit FNV-1a, chained through hash so several strings make up one key
+static uint64_t hash_string(uint64_t hash, const char *str)
+{
+    if(!str)
+        return hash;
+
+    while(*str) {
+        hash ^= (unsigned char)*str++;
+        hash *= 0x100000001b3ull;
+    }
+    // Separator so "ab"+"c" and "a"+"bc" differ
+    hash ^= 0xff;
+    hash *= 0x100000001b3ull;
+
+    return hash;
+}
+
+// Returns non zero if the context can save and restore program binaries
+static int check_binary_support()
+{
+    if(binary_support >= 0)
+        return binary_support;
+
+    binary_support = 0;
+
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &num_formats);
+    glGetError();
+
+    if(gl_has_extension("GL_OES_get_program_binary") && num_formats > 0) {
+        get_program_binary = (GET_PROGRAM_BINARY_T)eglGetProcAddress("glGetProgramBinaryOES");
+        program_binary = (PROGRAM_BINARY_T)eglGetProcAddress("glProgramBinaryOES");
+    }
+    // GLES3 contexts have the core entry points even without the extension
+    if(!get_program_binary || !program_binary) {
+        get_program_binary = (GET_PROGRAM_BINARY_T)eglGetProcAddress("glGetProgramBinary");
+        program_binary = (PROGRAM_BINARY_T)eglGetProcAddress("glProgramBinary");
+    }
+
+    binary_support = get_program_binary && program_binary && num_formats > 0;
+
+    return binary_support;
+}
+
+// Returns 0 if the name does not fit in size, the program is then not cached
+static int cache_path(char *path, size_t size, const GLchar *vertex_source, const GLchar *fragment_source)
+{
+    const char *dir = getenv("OGL_PROGRAM_CACHE");
+    if(!dir)
+        dir = PROGRAM_CACHE_DIR;
+
+    // A driver update invalidates binaries, so the driver strings are part of the key
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = hash_string(hash, vertex_source);
+    hash = hash_string(hash, fragment_source);
+    hash = hash_string(hash, (const char*)glGetString(GL_VENDOR));
+    hash = hash_string(hash, (const char*)glGetString(GL_RENDERER));
+    hash = hash_string(hash, (const char*)glGetString(GL_VERSION));
+
+    mkdir(dir, 0755);
+    int length = snprintf(path, size, "%s/%016llx.bin", dir, (unsigned long long)hash);
+    return length > 0 && (size_t)length < size;
+}
+
+// Returns a linked program restored from path or 0 on any failure
+static GLuint read_cached_program(const char *path)
+{
+    PROGRAM_CACHE_HEADER_T header;
+    GLuint program = 0;
+    void *binary = NULL;
+
+    FILE *file = fopen(path, "rb");
+    if(!file)
+        return 0;
+
+    if(fread(&header, sizeof header, 1, file) != 1 || header.magic != PROGRAM_CACHE_MAGIC)
+        goto done;
+
+    // The binary fills the rest of the file, anything else is torn or corrupt
+    // and must not size the allocation
+    struct stat st;
+    if(fstat(fileno(file), &st) != 0 || header.length == 0 || header.length > INT32_MAX
+       || (uint64_t)st.st_size != sizeof header + (uint64_t)header.length)
+        goto done;
+
+    binary = malloc(header.length);
+    if(!binary || fread(binary, 1, header.length, file) != header.length)
+        goto done;
+
+    program = glCreateProgram();
+    program_binary(program, header.binary_format, binary, header.length);
+
+    // The driver may reject a binary it produced itself, e.g. after an upgrade
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(status != GL_TRUE) {
+        glDeleteProgram(program);
+        program = 0;
+    }
+
+done:
+    free(binary);
+    fclose(file);
+    glGetError();
+
+    if(!program)
+        unlink(path);
+
+    return program;
+}
+
+static void write_cached_program(const char *path, GLuint program)
+{
+    PROGRAM_CACHE_HEADER_T header;
+    GLint length = 0;
+    GLenum format = 0;
+    // Room for the pid, so the temporary name never truncates onto the real one
+    char tmp_path[PROGRAM_CACHE_PATH_MAX + 16];
+
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if(length <= 0)
+        return;
+
+    void *binary = malloc(length);
+    if(!binary)
+        return;
+
+    get_program_binary(program, length, &length, &format, binary);
+
+    header.magic = PROGRAM_CACHE_MAGIC;
+    header.binary_format = format;
+    header.length = length;
+
+    // Write to a temporary file and rename so a crash never leaves a torn binary
+    snprintf(tmp_path, sizeof tmp_path, "%s.%d", path, (int)getpid());
+    FILE *file = fopen(tmp_path, "wb");
+    if(file) {
+        int ok = fwrite(&header, sizeof header, 1, file) == 1
+              && fwrite(binary, 1, length, file) == (size_t)length;
+        ok = (fclose(file) == 0) && ok;
+        if(ok)
+            rename(tmp_path, path);
+        else
+            unlink(tmp_path);
+    }
+
+    free(binary);
+}
+
+GLuint compile_shader(GLenum type, const GLchar *source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    print_shader_log(shader);
+
+    return shader;
+}
+
+// Compiles and links a program from source
+GLuint create_program(const GLchar *vertex_source, const GLchar *fragment_source)
+{
+    GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_source);
+    GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(status != GL_TRUE)
+        print_program_log(program);
+
+    // Shaders are no longer needed once linked
+    glDetachShader(program, vertex_shader);
+    glDetachShader(program, fragment_shader);
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    return program;
+}
+
+// Returns a linked program, from the on disk binary cache when possible
+GLuint load_program(const GLchar *vertex_source, const GLchar *fragment_source)
+{
+    char path[PROGRAM_CACHE_PATH_MAX];
+    GLuint program;
+
+    if(!check_binary_support() || !cache_path(path, sizeof path, vertex_source, fragment_source))
+        return create_program(vertex_source, fragment_source);
+
+    program = read_cached_program(path);
+    if(program)
+        return program;
+
+    program = create_program(vertex_source, fragment_source);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(status == GL_TRUE)
+        write_cached_program(path, program);
+
+    return program;
+}
@@ -0,0 +1,16 @@
+#ifndef SHADER_UTILS_H
+#define SHADER_UTILS_H
+
+#include "GLES2/gl2.h"
+
+// Directory linked program binaries are cached in, overridden by the
+// OGL_PROGRAM_CACHE environment variable
+#define PROGRAM_CACHE_DIR "/var/tmp/ogl_tex_programs"
+
+int extension_listed(const char *extensions, const char *name);
+int gl_has_extension(const char *name);
+GLuint compile_shader(GLenum type, const GLchar *source);
+GLuint create_program(const GLchar *vertex_source, const GLchar *fragment_source);
+GLuint load_program(const GLchar *vertex_source, const GLchar *fragment_source);
+
+#endif
@@ -0,0 +1,164 @@
+// Build time generator for the fragment shader variant table.
+// Writes C source containing one branch free fragment shader for every
+// combination of input format, colormap and decimation mode, in the order
+// given by SHADER_VARIANT_INDEX() in shader_variants.h.
+//
+// Usage: gen_variants > shader_variants_table.c
+
+#include <stdio.h>
+
+// Only the enums are needed, the generator runs on the build host
+#define SHADER_VARIANTS_NO_GL
+#include "shader_variants.h"
+
+// How each input format turns a texture coordinate into an RGB colour,
+// entries must follow the SHADER_FORMAT_T order
+// and how many image pixels one texel holds
+static const char *format_names[SHADER_FORMAT_COUNT] = {
+    "luminance",
+    "rgb",
+    "luminance_packed",
+    "i420",
+    "nv12"
+};
+static const char *format_fetch[SHADER_FORMAT_COUNT] = {
+    // SHADER_FORMAT_LUMINANCE
+    "const float pixels_per_texel = 1.0;"
+    "vec3 fetch(vec2 uv) {"
+    "   return texture2D(tex, uv).rrr;"
+    "}",
+    // SHADER_FORMAT_RGB
+    "const float pixels_per_texel = 1.0;"
+    "vec3 fetch(vec2 uv) {"
+    "   return texture2D(tex, uv).rgb;"
+    "}",
+    // SHADER_FORMAT_LUMINANCE_PACKED, the channel is picked from the position within the texel
+    "const float pixels_per_texel = 4.0;"
+    "const vec4 channels = vec4(0.0, 1.0, 2.0, 3.0);"
+    "vec3 fetch(vec2 uv) {"
+    "   float channel = floor(fract(uv.x/texel_step.x)*4.0);"
+    "   vec4 select = vec4(equal(vec4(channel), channels));"
+    "   return vec3(dot(texture2D(tex, uv), select));"
+    "}",
+    // SHADER_FORMAT_I420, chroma planes at half resolution share the texture coordinates
+    "const float pixels_per_texel = 1.0;"
+    "uniform sampler2D tex_u;"
+    "uniform sampler2D tex_v;"
+    "const mat3 yuv_to_rgb = mat3(1.1644, 1.1644, 1.1644, 0.0, -0.3918, 2.0172, 1.5960, -0.8130, 0.0);"
+    "vec3 fetch(vec2 uv) {"
+    "   vec3 yuv = vec3(texture2D(tex, uv).r, texture2D(tex_u, uv).r, texture2D(tex_v, uv).r);"
+    "   return yuv_to_rgb*(yuv - vec3(0.0625, 0.5, 0.5));"
+    "}",
+    // SHADER_FORMAT_NV12, interleaved chroma as luminance/alpha pairs
+    "const float pixels_per_texel = 1.0;"
+    "uniform sampler2D tex_uv;"
+    "const mat3 yuv_to_rgb = mat3(1.1644, 1.1644, 1.1644, 0.0, -0.3918, 2.0172, 1.5960, -0.8130, 0.0);"
+    "vec3 fetch(vec2 uv) {"
+    "   vec3 yuv = vec3(texture2D(tex, uv).r, texture2D(tex_uv, uv).ra);"
+    "   return yuv_to_rgb*(yuv - vec3(0.0625, 0.5, 0.5));"
+    "}"
+};
+
+// Default float precision, the packed format needs more than mediump to
+// resolve the position within a texel on wide images
+static const char *format_precision[SHADER_FORMAT_COUNT] = {
+    "precision mediump float;",
+    "precision mediump float;",
+    "\n#ifdef GL_FRAGMENT_PRECISION_HIGH\nprecision highp float;\n#else\nprecision mediump float;\n#endif\n",
+    "precision mediump float;",
+    "precision mediump float;"
+};
+
+// Horizontal decimation when the texture is wider than its pane,
+// entries must follow the SHADER_DECIMATE_T order
+static const char *decimate_names[SHADER_DECIMATE_COUNT] = {
+    "none",
+    "max4",
+    "mean4"
+};
+static const char *decimate_body[SHADER_DECIMATE_COUNT] = {
+    // SHADER_DECIMATE_NONE
+    "   vec3 c = fetch(frag_tex_coord);",
+    // SHADER_DECIMATE_MAX4
+    "   vec2 s = vec2(texel_step.x/pixels_per_texel, 0.0);"
+    "   vec3 c = max(max(fetch(frag_tex_coord - 1.5*s), fetch(frag_tex_coord - 0.5*s)),"
+    "                max(fetch(frag_tex_coord + 0.5*s), fetch(frag_tex_coord + 1.5*s)));",
+    // SHADER_DECIMATE_MEAN4
+    "   vec2 s = vec2(texel_step.x/pixels_per_texel, 0.0);"
+    "   vec3 c = 0.25*(fetch(frag_tex_coord - 1.5*s) + fetch(frag_tex_coord - 0.5*s)"
+    "                + fetch(frag_tex_coord + 0.5*s) + fetch(frag_tex_coord + 1.5*s));"
+};
+
+// Final colour, entries must follow the SHADER_COLORMAP_T order
+static const char *colormap_names[SHADER_COLORMAP_COUNT] = {
+    "gray",
+    "colormap"
+};
+static const char *colormap_body[SHADER_COLORMAP_COUNT] = {
+    // SHADER_COLORMAP_OFF
+    "   gl_FragColor = vec4(c, 1.0);",
+    // SHADER_COLORMAP_ON
+    "   float l = dot(c, vec3(0.299, 0.587, 0.114));"
+    "   gl_FragColor = texture2D(colormap, vec2(l, 0.5));"
+};
+
+static const char *header =
+    "varying vec2 frag_tex_coord;"
+    "uniform sampler2D tex;"
+    "uniform sampler2D colormap;"
+    "uniform vec2 texel_step;"
+    "uniform vec2 window;";
+
+// Emits str as a C string literal
+static void print_literal(const char *str)
+{
+    putchar('"');
+    for(; *str; str++) {
+        if(*str == '"' || *str == '\\')
+            putchar('\\');
+        if(*str == '\n')
+            fputs("\\n", stdout);
+        else
+            putchar(*str);
+    }
+    putchar('"');
+}
+
+int main(int argc, char *argv[])
+{
+    int format, colormap, decimate;
+
+    printf("// Generated by gen_variants, do not edit\n\n");
+    printf("#include \"shader_variants.h\"\n\n");
+    printf("const char *const shader_variant_fragment[SHADER_VARIANT_COUNT] = {\n");
+
+    for(format=0; format<SHADER_FORMAT_COUNT; format++) {
+        for(colormap=0; colormap<SHADER_COLORMAP_COUNT; colormap++) {
+            for(decimate=0; decimate<SHADER_DECIMATE_COUNT; decimate++) {
+                printf("    // %d: %s %s %s\n", SHADER_VARIANT_INDEX(format, colormap, decimate),
+                       format_names[format], colormap_names[colormap], decimate_names[decimate]);
+                printf("    ");
+                print_literal(format_precision[format]);
+                printf("\n    ");
+                print_literal(header);
+                printf("\n    ");
+                print_literal(format_fetch[format]);
+                printf("\n    ");
+                print_literal("void main() {");
+                printf("\n    ");
+                print_literal(decimate_body[decimate]);
+                printf("\n    ");
+                print_literal("   c = clamp((c - window.x)*window.y, 0.0, 1.0);");
+                printf("\n    ");
+                print_literal(colormap_body[colormap]);
+                printf("\n    ");
+                print_literal("}");
+                printf(",\n");
+            }
+        }
+    }
+
+    printf("};\n");
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <assert.h>
+
+#include "shader_variants.h"
+#include "shader_utils.h"
+
+#include "GLES2/gl2.h"
+
+const GLchar *shader_variant_vertex =
+    "attribute vec2 position;"
+    "attribute vec2 tex_coord;"
+    "varying vec2 frag_tex_coord;"
+    "void main() {"
+    "   gl_Position = vec4(position, 0.0, 1.0);"
+    "   frag_tex_coord = tex_coord;"
+    "}";
+
+// Linked programs, 0 until first requested
+static GLuint variant_programs[SHADER_VARIANT_COUNT];
+
+// Returns the program for the requested variant, compiling it on first use
+GLuint get_shader_variant(SHADER_FORMAT_T format, SHADER_COLORMAP_T colormap, SHADER_DECIMATE_T decimate)
+{
+    assert(format < SHADER_FORMAT_COUNT);
+    assert(colormap < SHADER_COLORMAP_COUNT);
+    assert(decimate < SHADER_DECIMATE_COUNT);
+
+    int index = SHADER_VARIANT_INDEX(format, colormap, decimate);
+    if(variant_programs[index])
+        return variant_programs[index];
+
+    GLuint program = load_program(shader_variant_vertex, shader_variant_fragment[index]);
+    variant_programs[index] = program;
+
+    // Sensible defaults so a variant draws correctly before the caller sets anything
+    GLint current_program = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &current_program);
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "colormap"), SHADER_COLORMAP_UNIT);
+    glUniform1i(glGetUniformLocation(program, "tex_u"), SHADER_CHROMA_UNIT);
+    glUniform1i(glGetUniformLocation(program, "tex_v"), SHADER_CHROMA_UNIT + 1);
+    glUniform1i(glGetUniformLocation(program, "tex_uv"), SHADER_CHROMA_UNIT);
+    glUniform2f(glGetUniformLocation(program, "window"), 0.0f, 1.0f);
+    glUseProgram(current_program);
+
+    return program;
+}
+
+void delete_shader_variants()
+{
+    int i;
+
+    for(i=0; i<SHADER_VARIANT_COUNT; i++) {
+        if(variant_programs[i])
+            glDeleteProgram(variant_programs[i]);
+        variant_programs[i] = 0;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+// Fragment shader variants, one specialised branch free shader per
+// combination of the options below. The sources are generated at build
+// time by gen_variants and each program is only compiled on first use.
+//
+// All variants share the vertex shader shader_variant_vertex and these
+// inputs:
+//   attribute position, tex_coord
+//   uniform sampler2D tex       image
+//   uniform sampler2D colormap  256x1 colormap, SHADER_COLORMAP_ON only
+//   uniform vec2 texel_step     1/width, 1/height of tex in texels
+//   uniform vec2 window         offset and gain applied before output
+
+// SHADER_FORMAT_LUMINANCE_PACKED samples an RGBA8 texture a quarter the
+// image width, each texel holding four consecutive 8-bit pixels in RGBA
+// order. It needs GL_NEAREST filtering.
+//
+// SHADER_FORMAT_I420 and SHADER_FORMAT_NV12 convert BT.601 video range YUV
+// to RGB. tex holds the full size GL_LUMINANCE Y plane and the half size
+// chroma planes are read from SHADER_CHROMA_UNIT onwards: U and V as two
+// GL_LUMINANCE textures (tex_u, tex_v) for I420, or one GL_LUMINANCE_ALPHA
+// texture with U in luminance and V in alpha (tex_uv) for NV12.
+typedef enum
+{
+    SHADER_FORMAT_LUMINANCE,
+    SHADER_FORMAT_RGB,
+    SHADER_FORMAT_LUMINANCE_PACKED,
+    SHADER_FORMAT_I420,
+    SHADER_FORMAT_NV12,
+    SHADER_FORMAT_COUNT
+} SHADER_FORMAT_T;
+
+typedef enum
+{
+    SHADER_COLORMAP_OFF,
+    SHADER_COLORMAP_ON,
+    SHADER_COLORMAP_COUNT
+} SHADER_COLORMAP_T;
+
+typedef enum
+{
+    SHADER_DECIMATE_NONE,
+    SHADER_DECIMATE_MAX4,
+    SHADER_DECIMATE_MEAN4,
+    SHADER_DECIMATE_COUNT
+} SHADER_DECIMATE_T;
+
+#define SHADER_VARIANT_COUNT (SHADER_FORMAT_COUNT*SHADER_COLORMAP_COUNT*SHADER_DECIMATE_COUNT)
+#define SHADER_VARIANT_INDEX(format, colormap, decimate) \
+    (((format)*SHADER_COLORMAP_COUNT + (colormap))*SHADER_DECIMATE_COUNT + (decimate))
+
+// Texture unit get_shader_variant() points the colormap sampler at
+#define SHADER_COLORMAP_UNIT 3
+
+// First of the two texture units the chroma samplers of the YUV formats use
+#define SHADER_CHROMA_UNIT 6
+
+// Generated table, see gen_variants.c
+extern const char *const shader_variant_fragment[SHADER_VARIANT_COUNT];
+
+#ifndef SHADER_VARIANTS_NO_GL
+#include "GLES2/gl2.h"
+
+extern const GLchar *shader_variant_vertex;
+
+GLuint get_shader_variant(SHADER_FORMAT_T format, SHADER_COLORMAP_T colormap, SHADER_DECIMATE_T decimate);
+void delete_shader_variants();
+#endif
+
+#endif
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "tex_alloc.h"
+
+#include "GLES2/gl2.h"
+
+// Every live texture, budget 0 means accounting only
+static TEX_ALLOC_ENTRY_T entries[TEX_ALLOC_MAX_TEXTURES];
+static int entry_count;
+static size_t budget;
+static size_t used;
+static size_t peak;
+static unsigned long frame;
+static TEX_ALLOC_STATS_T stats;
+
+static GLsizei format_bytes(GLenum format)
+{
+    switch(format) {
+        case GL_ALPHA:
+        case GL_LUMINANCE:
+            return 1;
+        case GL_LUMINANCE_ALPHA:
+            return 2;
+        case GL_RGB:
+            return 3;
+        case GL_RGBA:
+            return 4;
+    }
+    assert(0);
+    return 0;
+}
+
+static const char *format_name(GLenum format)
+{
+    switch(format) {
+        case GL_ALPHA:
+            return "alpha";
+        case GL_LUMINANCE:
+            return "luminance";
+        case GL_LUMINANCE_ALPHA:
+            return "luminance_alpha";
+        case GL_RGB:
+            return "rgb";
+        case GL_RGBA:
+            return "rgba";
+    }
+    return "?";
+}
+
+static TEX_ALLOC_ENTRY_T *find_entry(GLuint texture)
+{
+    int i;
+
+    for(i=0; i<entry_count; i++) {
+        if(entries[i].texture == texture)
+            return &entries[i];
+    }
+    return NULL;
+}
+
+// Evicts least recently drawn textures until bytes more fit, sparing exclude.
+// Owners may delete their textures from the callback, so entries move.
+static int make_room(size_t bytes, GLuint exclude)
+{
+    int i;
+
+    while(budget && used + bytes > budget) {
+        TEX_ALLOC_ENTRY_T *victim = NULL;
+        for(i=0; i<entry_count; i++) {
+            TEX_ALLOC_ENTRY_T *entry = &entries[i];
+            if(entry->evict && entry->texture != exclude && (!victim || entry->last_used < victim->last_used))
+                victim = entry;
+        }
+        if(!victim)
+            return 0;
+
+        // Offered once, an owner that can shrink further registers again.
+        // The caller's active unit is put back whatever the owner binds.
+        TEX_EVICT_FN evict = victim->evict;
+        const char *name = victim->name;
+        size_t before = used;
+        GLint active_unit;
+        victim->evict = NULL;
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &active_unit);
+        evict(victim->owner, victim->texture);
+        glActiveTexture(active_unit);
+
+        stats.evictions++;
+        printf("Texture budget: evicted %s, %zu KB freed\n", name, (before - used)/1024);
+    }
+
+    return 1;
+}
+
+// Specifies storage for the texture bound on the active unit, 0 when the GPU is out of memory
+static int tex_image(GLenum format, GLsizei width, GLsizei height, const void *pixels)
+{
+    // Clear any earlier error so the check below is about this call
+    glGetError();
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+    return glGetError() == GL_NO_ERROR;
+}
+
+// Limits the total texture storage to budget_bytes, 0 for no limit
+void tex_alloc_init(size_t budget_bytes)
+{
+    budget = budget_bytes;
+    if(budget)
+        printf("Texture budget: %.1f MB\n", budget/(1024.0*1024.0));
+}
+
+static GLuint create(const char *name, GLenum format, GLsizei width, GLsizei height, const void *pixels, int required)
+{
+    size_t bytes = (size_t)width*height*format_bytes(format);
+    GLuint texture;
+
+    if(entry_count == TEX_ALLOC_MAX_TEXTURES) {
+        stats.failures++;
+        printf("Texture budget: more than %d textures creating %s\n", TEX_ALLOC_MAX_TEXTURES, name);
+        return 0;
+    }
+    if(!make_room(bytes, 0)) {
+        if(!required) {
+            stats.failures++;
+            printf("Texture budget: no room for %s, %dx%d %s, %zu KB with %zu KB in use\n",
+                   name, width, height, format_name(format), bytes/1024, used/1024);
+            return 0;
+        }
+        stats.overcommits++;
+        printf("Texture budget: %s needs %zu KB with %zu KB in use, going over the budget\n",
+               name, bytes/1024, used/1024);
+    }
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if(!tex_image(format, width, height, pixels)) {
+        glDeleteTextures(1, &texture);
+        stats.failures++;
+        printf("Texture budget: out of GPU memory creating %s, %zu KB with %zu KB in use\n", name, bytes/1024, used/1024);
+        return 0;
+    }
+
+    TEX_ALLOC_ENTRY_T *entry = &entries[entry_count++];
+    memset(entry, 0, sizeof(TEX_ALLOC_ENTRY_T));
+    entry->texture = texture;
+    entry->name = name;
+    entry->format = format;
+    entry->width = width;
+    entry->height = height;
+    entry->bytes = bytes;
+    entry->last_used = frame;
+
+    used += bytes;
+    if(used > peak)
+        peak = used;
+    stats.allocations++;
+
+    return texture;
+}
+
+// Creates a width x height texture of format, bound on the active unit and
+// loaded from pixels if not NULL. Returns 0 when it does not fit the budget
+// even after eviction, or the GPU has run out of memory.
+GLuint tex_alloc_create(const char *name, GLenum format, GLsizei width, GLsizei height, const void *pixels)
+{
+    return create(name, format, width, height, pixels, 0);
+}
+
+// As tex_alloc_create() for textures nothing can be drawn without. Others
+// are evicted to make room but the budget is exceeded rather than refused,
+// returns 0 only when the GPU itself is out of memory.
+GLuint tex_alloc_create_required(const char *name, GLenum format, GLsizei width, GLsizei height, const void *pixels)
+{
+    return create(name, format, width, height, pixels, 1);
+}
+
+// Respecifies a texture at a new size, bound on the active unit. Returns 0 and
+// leaves the texture as it was when a larger size does not fit.
+int tex_alloc_resize(GLuint texture, GLsizei width, GLsizei height, const void *pixels)
+{
+    TEX_ALLOC_ENTRY_T *entry = find_entry(texture);
+    assert(entry);
+
+    size_t bytes = (size_t)width*height*format_bytes(entry->format);
+    if(bytes > entry->bytes) {
+        if(!make_room(bytes - entry->bytes, texture)) {
+            stats.failures++;
+            return 0;
+        }
+        entry = find_entry(texture);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if(!tex_image(entry->format, width, height, pixels)) {
+        stats.failures++;
+        return 0;
+    }
+
+    used = used - entry->bytes + bytes;
+    if(used > peak)
+        peak = used;
+    entry->width = width;
+    entry->height = height;
+    entry->bytes = bytes;
+
+    return 1;
+}
+
+// Marks a texture as giving memory back on request, least recently drawn first
+void tex_alloc_set_evict(GLuint texture, TEX_EVICT_FN evict, void *owner)
+{
+    TEX_ALLOC_ENTRY_T *entry = find_entry(texture);
+    assert(entry);
+
+    entry->evict = evict;
+    entry->owner = owner;
+}
+
+// Records that a texture was drawn from this frame
+void tex_alloc_touch(GLuint texture)
+{
+    TEX_ALLOC_ENTRY_T *entry = find_entry(texture);
+
+    if(entry)
+        entry->last_used = frame;
+}
+
+void tex_alloc_next_frame()
+{
+    frame++;
+}
+
+void tex_alloc_delete(GLuint texture)
+{
+    TEX_ALLOC_ENTRY_T *entry = find_entry(texture);
+    assert(entry);
+
+    glDeleteTextures(1, &texture);
+    used -= entry->bytes;
+    *entry = entries[--entry_count];
+}
+
+size_t tex_alloc_used()
+{
+    return used;
+}
+
+void tex_alloc_print_stats()
+{
+    int i;
+
+    printf("Texture memory: %zu KB in %d textures, peak %zu KB", used/1024, entry_count, peak/1024);
+    if(budget)
+        printf(" of a %zu KB budget", budget/1024);
+    printf(", %lu allocations, %lu evictions, %lu failures, %lu over budget\n", stats.allocations, stats.evictions,
+           stats.failures, stats.overcommits);
+
+    for(i=0; i<entry_count; i++) {
+        TEX_ALLOC_ENTRY_T *entry = &entries[i];
+        printf("  %-20s %5dx%-5d %-16s %6zu KB\n", entry->name, entry->width, entry->height,
+               format_name(entry->format), entry->bytes/1024);
+    }
+}
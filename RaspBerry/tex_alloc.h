@@ -0,0 +1,54 @@
+#ifndef TEX_ALLOC_H
+#define TEX_ALLOC_H
+
+#include <stddef.h>
+
+#include "GLES2/gl2.h"
+
+// Central texture allocator. Every texture is created through it so its
+// storage is accounted for, and allocations are checked against a budget
+// rather than failing silently when the GPU memory split runs out.
+// Sizes are nominal, the driver adds tiling padding on top.
+
+#define TEX_ALLOC_MAX_TEXTURES 64
+
+// Asked to give back memory under pressure, the owner deletes the texture or
+// shrinks it with tex_alloc_resize()
+typedef void (*TEX_EVICT_FN)(void *owner, GLuint texture);
+
+typedef struct
+{
+    GLuint texture;
+    const char *name;
+    GLenum format;
+    GLsizei width;
+    GLsizei height;
+    size_t bytes;
+
+    // Frame the texture was last drawn from, least recent is evicted first
+    unsigned long last_used;
+    TEX_EVICT_FN evict;
+    void *owner;
+} TEX_ALLOC_ENTRY_T;
+
+typedef struct
+{
+    unsigned long allocations;
+    unsigned long failures;
+    unsigned long evictions;
+    // Required textures created over the budget
+    unsigned long overcommits;
+} TEX_ALLOC_STATS_T;
+
+void tex_alloc_init(size_t budget_bytes);
+GLuint tex_alloc_create(const char *name, GLenum format, GLsizei width, GLsizei height, const void *pixels);
+GLuint tex_alloc_create_required(const char *name, GLenum format, GLsizei width, GLsizei height, const void *pixels);
+int tex_alloc_resize(GLuint texture, GLsizei width, GLsizei height, const void *pixels);
+void tex_alloc_set_evict(GLuint texture, TEX_EVICT_FN evict, void *owner);
+void tex_alloc_touch(GLuint texture);
+void tex_alloc_next_frame();
+void tex_alloc_delete(GLuint texture);
+size_t tex_alloc_used();
+void tex_alloc_print_stats();
+
+#endif
@@ -0,0 +1,216 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "atlas.h"
+#include "tex_alloc.h"
+
+#include "GLES2/gl2.h"
+
+void atlas_init(ATLAS_T *atlas, GLsizei page_size)
+{
+    memset(atlas, 0, sizeof(ATLAS_T));
+    atlas->page_size = page_size;
+}
+
+// Returns 0 when texture memory can not spare another page
+static int add_page(ATLAS_T *atlas)
+{
+    ATLAS_PAGE_T *page = &atlas->pages[atlas->page_count];
+
+    // Page starts as a single empty skyline segment
+    page->nodes[0].x = 0;
+    page->nodes[0].y = 0;
+    page->nodes[0].width = atlas->page_size;
+    page->node_count = 1;
+
+    page->texture = tex_alloc_create("atlas page", GL_RGBA, atlas->page_size, atlas->page_size, NULL);
+    if(!page->texture)
+        return 0;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    atlas->page_count++;
+    return 1;
+}
+
+// Returns the y a width x height block would rest at when placed at node index, -1 if it does not fit
+static GLsizei skyline_fit(ATLAS_T *atlas, ATLAS_PAGE_T *page, int index, GLsizei width, GLsizei height)
+{
+    GLsizei x = page->nodes[index].x;
+    GLsizei y = 0;
+    GLsizei remaining = width;
+
+    if(x + width > atlas->page_size)
+        return -1;
+
+    for(; remaining > 0; index++) {
+        if(page->nodes[index].y > y)
+            y = page->nodes[index].y;
+        if(y + height > atlas->page_size)
+            return -1;
+        remaining -= page->nodes[index].width;
+    }
+
+    return y;
+}
+
+// Raises the skyline over [x, x+width) to y, replacing the segments it covers
+static void skyline_insert(ATLAS_PAGE_T *page, int index, GLsizei x, GLsizei y, GLsizei width)
+{
+    int i;
+
+    assert(page->node_count < ATLAS_MAX_NODES);
+
+    memmove(&page->nodes[index+1], &page->nodes[index], (page->node_count - index)*sizeof(ATLAS_NODE_T));
+    page->nodes[index].x = x;
+    page->nodes[index].y = y;
+    page->nodes[index].width = width;
+    page->node_count++;
+
+    // Trim or remove the segments now under the new one
+    for(i=index+1; i<page->node_count; i++) {
+        ATLAS_NODE_T *node = &page->nodes[i];
+        GLsizei overlap = x + width - node->x;
+        if(overlap <= 0)
+            break;
+
+        node->x += overlap;
+        node->width -= overlap;
+        if(node->width > 0)
+            break;
+
+        memmove(node, node+1, (page->node_count - i - 1)*sizeof(ATLAS_NODE_T));
+        page->node_count--;
+        i--;
+    }
+
+    // Merge neighbours at the same height
+    for(i=0; i<page->node_count-1; i++) {
+        if(page->nodes[i].y == page->nodes[i+1].y) {
+            page->nodes[i].width += page->nodes[i+1].width;
+            memmove(&page->nodes[i+1], &page->nodes[i+2], (page->node_count - i - 2)*sizeof(ATLAS_NODE_T));
+            page->node_count--;
+            i--;
+        }
+    }
+}
+
+// Bottom-left skyline placement, returns 0 if the block does not fit on the page
+static int page_place(ATLAS_T *atlas, ATLAS_PAGE_T *page, GLsizei width, GLsizei height, GLsizei *x, GLsizei *y)
+{
+    int i;
+    int best_index = -1;
+    GLsizei best_top = atlas->page_size + 1;
+    GLsizei best_width = atlas->page_size + 1;
+
+    if(page->node_count >= ATLAS_MAX_NODES)
+        return 0;
+
+    for(i=0; i<page->node_count; i++) {
+        GLsizei fit_y = skyline_fit(atlas, page, i, width, height);
+        if(fit_y < 0)
+            continue;
+
+        if(fit_y + height < best_top || (fit_y + height == best_top && page->nodes[i].width < best_width)) {
+            best_index = i;
+            best_top = fit_y + height;
+            best_width = page->nodes[i].width;
+            *x = page->nodes[i].x;
+            *y = fit_y;
+        }
+    }
+
+    if(best_index < 0)
+        return 0;
+
+    skyline_insert(page, best_index, *x, *y + height, width);
+    page->used_area += (long)width*height;
+    page->image_count++;
+
+    return 1;
+}
+
+// Packs a width x height RGBA image into the atlas, returns 0 when every page
+// is full and no new page can be made
+int atlas_add(ATLAS_T *atlas, GLsizei width, GLsizei height, const GLubyte *rgba, ATLAS_REGION_T *region)
+{
+    GLsizei padded_width = width + 2*ATLAS_PADDING;
+    GLsizei padded_height = height + 2*ATLAS_PADDING;
+    GLsizei x = 0, y = 0;
+    int page;
+
+    if(width <= 0 || height <= 0 || padded_width > atlas->page_size || padded_height > atlas->page_size)
+        return 0;
+
+    // First fit over the existing pages, then start a new one
+    for(page=0; page<atlas->page_count; page++) {
+        if(page_place(atlas, &atlas->pages[page], padded_width, padded_height, &x, &y))
+            break;
+    }
+    if(page == atlas->page_count) {
+        if(atlas->page_count == ATLAS_MAX_PAGES || !add_page(atlas))
+            return 0;
+        if(!page_place(atlas, &atlas->pages[page], padded_width, padded_height, &x, &y))
+            return 0;
+    }
+
+    // Page texels are uninitialised, so the padding is written along with the
+    // image as copies of its nearest edge texels
+    GLubyte *padded = malloc((size_t)padded_width*padded_height*4);
+    GLsizei row, column;
+    assert(padded);
+    for(row=0; row<padded_height; row++) {
+        GLsizei source_row = row - ATLAS_PADDING;
+        if(source_row < 0)
+            source_row = 0;
+        if(source_row >= height)
+            source_row = height - 1;
+        const GLubyte *source = rgba + (size_t)source_row*width*4;
+        GLubyte *dest = padded + (size_t)row*padded_width*4;
+
+        for(column=0; column<ATLAS_PADDING; column++) {
+            memcpy(dest + column*4, source, 4);
+            memcpy(dest + (ATLAS_PADDING + width + column)*4, source + (width - 1)*4, 4);
+        }
+        memcpy(dest + ATLAS_PADDING*4, source, (size_t)width*4);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, atlas->pages[page].texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, padded_width, padded_height, GL_RGBA, GL_UNSIGNED_BYTE, padded);
+    free(padded);
+
+    x += ATLAS_PADDING;
+    y += ATLAS_PADDING;
+
+    region->page = page;
+    region->width = width;
+    region->height = height;
+    region->u0 = (GLfloat)x/atlas->page_size;
+    region->v0 = (GLfloat)y/atlas->page_size;
+    region->u1 = (GLfloat)(x + width)/atlas->page_size;
+    region->v1 = (GLfloat)(y + height)/atlas->page_size;
+
+    return 1;
+}
+
+// Fraction of the page covered by packed images
+float atlas_occupancy(ATLAS_T *atlas, int page)
+{
+    assert(page < atlas->page_count);
+    return (float)atlas->pages[page].used_area/((float)atlas->page_size*atlas->page_size);
+}
+
+void atlas_destroy(ATLAS_T *atlas)
+{
+    int i;
+
+    for(i=0; i<atlas->page_count; i++)
+        tex_alloc_delete(atlas->pages[i].texture);
+
+    memset(atlas, 0, sizeof(ATLAS_T));
+}
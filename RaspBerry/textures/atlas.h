@@ -0,0 +1,56 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include "GLES2/gl2.h"
+
+#define ATLAS_MAX_PAGES 4
+#define ATLAS_MAX_NODES 256
+
+// Texels around each image repeating its edge, so linear filtering at the
+// edge of a region blends with the image itself rather than its neighbours
+#define ATLAS_PADDING 1
+
+// Skyline segment, the packed area's top edge is y over [x, x+width)
+typedef struct
+{
+    GLsizei x;
+    GLsizei y;
+    GLsizei width;
+} ATLAS_NODE_T;
+
+typedef struct
+{
+    GLuint texture;
+
+    ATLAS_NODE_T nodes[ATLAS_MAX_NODES];
+    int node_count;
+
+    // Texels covered by images, including padding
+    long used_area;
+    int image_count;
+} ATLAS_PAGE_T;
+
+typedef struct
+{
+    // Pages are square RGBA textures
+    GLsizei page_size;
+
+    ATLAS_PAGE_T pages[ATLAS_MAX_PAGES];
+    int page_count;
+} ATLAS_T;
+
+// Location of an image within the atlas
+typedef struct
+{
+    int page;
+    GLfloat u0, v0, u1, v1;
+    GLsizei width;
+    GLsizei height;
+} ATLAS_REGION_T;
+
+void atlas_init(ATLAS_T *atlas, GLsizei page_size);
+int atlas_add(ATLAS_T *atlas, GLsizei width, GLsizei height, const GLubyte *rgba, ATLAS_REGION_T *region);
+float atlas_occupancy(ATLAS_T *atlas, int page);
+void atlas_destroy(ATLAS_T *atlas);
+
+#endif
@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "auto_level.h"
+#include "gles3_compat.h"
+#include "shader_utils.h"
+#include "tex_alloc.h"
+
+#include "GLES2/gl2.h"
+
+const GLchar* reduce_vertex_source =
+    "attribute vec2 position;"
+    "void main() {"
+    "   gl_Position = vec4(position, 0.0, 1.0);"
+    "}";
+
+// Texel centres of a 1080 row texture are finer than mediump can address.
+// value() returns (min, max) for one source texel, main() folds a 4x4 block
+// whose bottom left texel sits at four times this fragment's coordinate.
+#define REDUCE_FRAGMENT_SOURCE(value) \
+    "\n#ifdef GL_FRAGMENT_PRECISION_HIGH\nprecision highp float;\n#else\nprecision mediump float;\n#endif\n" \
+    "uniform sampler2D source;" \
+    "uniform vec2 inv_size;" \
+    "vec2 value(vec2 uv) {" value "}" \
+    "void main() {" \
+    "   vec2 base = (floor(gl_FragCoord.xy)*4.0 + 0.5)*inv_size;" \
+    "   vec2 range = vec2(1.0, 0.0);" \
+    "   for(int j=0; j<4; j++) {" \
+    "       for(int i=0; i<4; i++) {" \
+    "           vec2 v = value(base + vec2(float(i), float(j))*inv_size);" \
+    "           range = vec2(min(range.x, v.x), max(range.y, v.y));" \
+    "       }" \
+    "   }" \
+    "   gl_FragColor = vec4(range, 0.0, 1.0);" \
+    "}"
+
+const GLchar* reduce_luminance_fragment_source = REDUCE_FRAGMENT_SOURCE(
+    "   return texture2D(source, uv).rr;");
+
+// Four pixels per texel
+const GLchar* reduce_packed_fragment_source = REDUCE_FRAGMENT_SOURCE(
+    "   vec4 t = texture2D(source, uv);"
+    "   return vec2(min(min(t.r, t.g), min(t.b, t.a)), max(max(t.r, t.g), max(t.b, t.a)));");
+
+const GLchar* reduce_stage_fragment_source = REDUCE_FRAGMENT_SOURCE(
+    "   return texture2D(source, uv).rg;");
+
+static void delete_stages(AUTO_LEVEL_T *level)
+{
+    int s;
+
+    for(s=0; s<level->stage_count; s++) {
+        glDeleteFramebuffers(1, &level->stages[s].fbo);
+        tex_alloc_delete(level->stages[s].texture);
+    }
+    level->stage_count = 0;
+}
+
+// Any stage going takes the rest with it, they are rebuilt together
+static void evict_stages(void *owner, GLuint texture)
+{
+    AUTO_LEVEL_T *level = owner;
+
+    delete_stages(level);
+    level->stages_lost = level->frame;
+}
+
+// Stages shrink by the reduction factor down to a single texel. Returns 0,
+// with none left, when texture memory can not spare them.
+static int create_stages(AUTO_LEVEL_T *level)
+{
+    GLsizei stage_width = level->width, stage_height = level->height;
+    int s;
+
+    glActiveTexture(GL_TEXTURE0 + AUTO_LEVEL_UNIT);
+    do {
+        AUTO_LEVEL_STAGE_T *stage = &level->stages[level->stage_count];
+        assert(level->stage_count < AUTO_LEVEL_MAX_STAGES);
+
+        stage_width = (stage_width + AUTO_LEVEL_REDUCTION - 1)/AUTO_LEVEL_REDUCTION;
+        stage_height = (stage_height + AUTO_LEVEL_REDUCTION - 1)/AUTO_LEVEL_REDUCTION;
+        stage->width = stage_width;
+        stage->height = stage_height;
+
+        stage->texture = tex_alloc_create("auto level stage", GL_RGBA, stage_width, stage_height, NULL);
+        if(!stage->texture) {
+            delete_stages(level);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glActiveTexture(GL_TEXTURE0);
+            return 0;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glGenFramebuffers(1, &stage->fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, stage->fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, stage->texture, 0);
+        assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+        level->stage_count++;
+    } while(stage_width > 1 || stage_height > 1);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    // Registered once all exist, eviction takes the whole chain
+    for(s=0; s<level->stage_count; s++)
+        tex_alloc_set_evict(level->stages[s].texture, evict_stages, level);
+
+    // Nothing has been reduced into the new stages
+    auto_level_mark(level, 0, level->height);
+    return 1;
+}
+
+// Builds a reduction pass reading source from unit
+static void create_pass(AUTO_LEVEL_PROGRAM_T *pass, const GLchar *fragment_source, GLint unit)
+{
+    pass->program = load_program(reduce_vertex_source, fragment_source);
+    pass->position_location = glGetAttribLocation(pass->program, "position");
+    pass->inv_size_location = glGetUniformLocation(pass->program, "inv_size");
+
+    // Every pass of a kind reads the same unit
+    glUseProgram(pass->program);
+    glUniform1i(glGetUniformLocation(pass->program, "source"), unit);
+}
+
+// Reduces the source texture on source_unit, width and height in texels.
+// window_width and window_height are the default framebuffer viewport.
+void auto_level_init(AUTO_LEVEL_T *level, int gles_version, GLenum source_unit, GLsizei width, GLsizei height, int packed,
+                     GLsizei window_width, GLsizei window_height)
+{
+    const GLfloat quad[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+    memset(level, 0, sizeof(AUTO_LEVEL_T));
+    level->use_pbo = gles_version >= 3;
+    level->source_unit = source_unit;
+    level->width = width;
+    level->height = height;
+    level->window_width = window_width;
+    level->window_height = window_height;
+    level->min = 0;
+    level->max = 255;
+    level->window[0] = 0.0f;
+    level->window[1] = 1.0f;
+
+    if(!create_stages(level))
+        printf("Auto level: no texture memory for the reduction, levels fixed for now\n");
+
+    create_pass(&level->first, packed ? reduce_packed_fragment_source : reduce_luminance_fragment_source,
+                source_unit - GL_TEXTURE0);
+    create_pass(&level->reduce, reduce_stage_fragment_source, AUTO_LEVEL_UNIT);
+
+    glGenBuffers(1, &level->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, level->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+    if(level->use_pbo) {
+        glGenBuffers(1, &level->pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, level->pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, 4, NULL, GL_STREAM_READ);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+// Records rows of the source texture that changed since the last reduction
+void auto_level_mark(AUTO_LEVEL_T *level, GLsizei row, GLsizei rows)
+{
+    if(level->dirty_end <= level->dirty_begin) {
+        level->dirty_begin = row;
+        level->dirty_end = row + rows;
+        return;
+    }
+    if(row < level->dirty_begin)
+        level->dirty_begin = row;
+    if(row + rows > level->dirty_end)
+        level->dirty_end = row + rows;
+}
+
+// Redoes the part of every stage that depends on the dirty source rows
+static void reduce(AUTO_LEVEL_T *level)
+{
+    GLsizei begin = level->dirty_begin, end = level->dirty_end;
+    GLsizei source_width = level->width, source_height = level->height;
+    int s;
+
+    glEnable(GL_SCISSOR_TEST);
+    glBindBuffer(GL_ARRAY_BUFFER, level->vbo);
+    glActiveTexture(GL_TEXTURE0 + AUTO_LEVEL_UNIT);
+
+    for(s=0; s<level->stage_count; s++) {
+        AUTO_LEVEL_STAGE_T *stage = &level->stages[s];
+        AUTO_LEVEL_PROGRAM_T *pass = s == 0 ? &level->first : &level->reduce;
+
+        // Stage rows covering the dirty rows of the one before
+        begin = begin/AUTO_LEVEL_REDUCTION;
+        end = (end + AUTO_LEVEL_REDUCTION - 1)/AUTO_LEVEL_REDUCTION;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, stage->fbo);
+        glViewport(0, 0, stage->width, stage->height);
+        glScissor(0, begin, stage->width, end - begin);
+
+        glUseProgram(pass->program);
+        glUniform2f(pass->inv_size_location, 1.0f/source_width, 1.0f/source_height);
+        glVertexAttribPointer(pass->position_location, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(pass->position_location);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glDisableVertexAttribArray(pass->position_location);
+
+        // This stage is the next one's source
+        glBindTexture(GL_TEXTURE_2D, stage->texture);
+        tex_alloc_touch(stage->texture);
+        source_width = stage->width;
+        source_height = stage->height;
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+    glActiveTexture(GL_TEXTURE0);
+    glViewport(0, 0, level->window_width, level->window_height);
+
+    level->stats.reductions++;
+    level->stats.rows += level->dirty_end - level->dirty_begin;
+    level->dirty_begin = level->dirty_end = 0;
+    level->last_reduction = level->frame;
+}
+
+// Maps the range read back to 0..1, returns non zero when the window moved
+static int set_range(AUTO_LEVEL_T *level, const GLubyte *pixel)
+{
+    GLubyte min = pixel[0], max = pixel[1];
+
+    level->stats.readbacks++;
+
+    // A flat pane has no contrast to stretch, keep the last window
+    if(max <= min || (min == level->min && max == level->max))
+        return 0;
+
+    level->min = min;
+    level->max = max;
+    level->window[0] = min/255.0f;
+    level->window[1] = 255.0f/(max - min);
+    level->stats.window_changes++;
+    return 1;
+}
+
+// Call once per frame before drawing, leaves the default framebuffer bound.
+// Returns non zero when window[] changed and the pane needs redrawing.
+int auto_level_update(AUTO_LEVEL_T *level)
+{
+    GLubyte pixel[4];
+    int changed = 0;
+
+    level->frame++;
+    level->stats.frames++;
+
+    if(level->fence) {
+        // Never wait, an unfinished readback is picked up next frame
+        GLenum status = gles3.client_wait_sync(level->fence, 0, 0);
+        if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return 0;
+        gles3.delete_sync(level->fence);
+        level->fence = NULL;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, level->pbo);
+        GLubyte *mapped = gles3.map_buffer_range(GL_PIXEL_PACK_BUFFER, 0, 4, GL_MAP_READ_BIT);
+        assert(mapped);
+        changed = set_range(level, mapped);
+        gles3.unmap_buffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // Stages evicted for memory are rebuilt once there is room again
+    if(!level->stage_count) {
+        if(level->frame - level->stages_lost < AUTO_LEVEL_RETRY)
+            return changed;
+        GLint active_unit;
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &active_unit);
+        if(!create_stages(level))
+            level->stages_lost = level->frame;
+        glActiveTexture(active_unit);
+        if(!level->stage_count)
+            return changed;
+    }
+
+    if(level->dirty_end <= level->dirty_begin)
+        return changed;
+    if(!level->use_pbo && level->stats.reductions && level->frame - level->last_reduction < AUTO_LEVEL_INTERVAL)
+        return changed;
+
+    reduce(level);
+
+    // The final stage is bound, read its single texel
+    if(level->use_pbo) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, level->pbo);
+        glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        level->fence = gles3.fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    else {
+        glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+        changed |= set_range(level, pixel);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return changed;
+}
+
+void auto_level_print_stats(AUTO_LEVEL_T *level, const char *name)
+{
+    AUTO_LEVEL_STATS_T *stats = &level->stats;
+
+    printf("%s auto level: range %d-%d, %lu reductions over %lu rows, %lu readbacks, %lu window changes in %lu frames\n",
+           name, level->min, level->max, stats->reductions, stats->rows, stats->readbacks, stats->window_changes, stats->frames);
+}
+
+void auto_level_destroy(AUTO_LEVEL_T *level)
+{
+    delete_stages(level);
+    if(level->fence)
+        gles3.delete_sync(level->fence);
+    if(level->use_pbo)
+        glDeleteBuffers(1, &level->pbo);
+    glDeleteBuffers(1, &level->vbo);
+    glDeleteProgram(level->first.program);
+    glDeleteProgram(level->reduce.program);
+    memset(level, 0, sizeof(AUTO_LEVEL_T));
+}
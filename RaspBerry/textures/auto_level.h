@@ -0,0 +1,100 @@
+#ifndef AUTO_LEVEL_H
+#define AUTO_LEVEL_H
+
+#include "GLES2/gl2.h"
+#include "gles3_compat.h"
+
+// Texture unit reduction stages are bound to while being sampled, nothing
+// stays bound to it between calls so it doubles as a scratch unit for uploads
+#define AUTO_LEVEL_UNIT 2
+
+// Each pass reduces blocks of REDUCTION x REDUCTION texels to one
+#define AUTO_LEVEL_REDUCTION 4
+#define AUTO_LEVEL_MAX_STAGES 8
+
+// Without pixel pack buffers the readback stalls, so GLES2 reduces at most
+// once per this many frames
+#define AUTO_LEVEL_INTERVAL 8
+
+// Frames between attempts to rebuild stages evicted for texture memory
+#define AUTO_LEVEL_RETRY 300
+
+typedef struct
+{
+    GLuint texture;
+    GLuint fbo;
+    GLsizei width;
+    GLsizei height;
+} AUTO_LEVEL_STAGE_T;
+
+// Reduction program with its locations, looked up once
+typedef struct
+{
+    GLuint program;
+    GLint position_location;
+    GLint inv_size_location;
+} AUTO_LEVEL_PROGRAM_T;
+
+typedef struct
+{
+    unsigned long frames;
+    unsigned long reductions;
+    // Source rows covered by reduction passes
+    unsigned long rows;
+    unsigned long readbacks;
+    unsigned long window_changes;
+} AUTO_LEVEL_STATS_T;
+
+typedef struct
+{
+    // Non zero when the result is read back through a pixel pack buffer (GLES3)
+    int use_pbo;
+
+    // Pane texture, left bound to source_unit by its owner
+    GLenum source_unit;
+    GLsizei width;
+    GLsizei height;
+
+    // Viewport of the default framebuffer, restored after reducing
+    GLsizei window_width;
+    GLsizei window_height;
+
+    // Each stage holds min in red and max in green for a block of the one before,
+    // the last is 1x1. Stages persist so only rows under dirty rows are redone.
+    AUTO_LEVEL_STAGE_T stages[AUTO_LEVEL_MAX_STAGES];
+    int stage_count;
+
+    // Stages give way under memory pressure, the window holds until they are back
+    unsigned long stages_lost;
+
+    // Source rows changed since the last reduction, empty when end <= begin
+    GLsizei dirty_begin;
+    GLsizei dirty_end;
+    unsigned long frame;
+    unsigned long last_reduction;
+
+    // Readback of the 1x1 result in flight on GLES3
+    GLuint pbo;
+    GL3_SYNC_T fence;
+
+    // First pass reads the pane format, later passes read stages
+    AUTO_LEVEL_PROGRAM_T first;
+    AUTO_LEVEL_PROGRAM_T reduce;
+    GLuint vbo;
+
+    // Last range read back and the window uniform mapping it to 0..1
+    GLubyte min;
+    GLubyte max;
+    GLfloat window[2];
+
+    AUTO_LEVEL_STATS_T stats;
+} AUTO_LEVEL_T;
+
+void auto_level_init(AUTO_LEVEL_T *level, int gles_version, GLenum source_unit, GLsizei width, GLsizei height, int packed,
+                     GLsizei window_width, GLsizei window_height);
+void auto_level_mark(AUTO_LEVEL_T *level, GLsizei row, GLsizei rows);
+int auto_level_update(AUTO_LEVEL_T *level);
+void auto_level_print_stats(AUTO_LEVEL_T *level, const char *name);
+void auto_level_destroy(AUTO_LEVEL_T *level);
+
+#endif
@@ -0,0 +1,513 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/fb.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "fb_panes.h"
+
+// Gap between the panes and the background grey, as drawn by multi_tex
+#define FB_PANES_GAP 0.005f
+#define FB_PANES_BACKGROUND 128
+
+static double fb_panes_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Maps a framebuffer device, or a plain file standing in for one
+static void open_target(FB_PANES_T *panes, const char *device)
+{
+    struct stat st;
+    size_t offset = 0;
+    int c;
+
+    // Stand in files are created, device nodes never are
+    int flags = strncmp(device, "/dev/", 5) == 0 ? O_RDWR : O_RDWR | O_CREAT;
+    panes->fd = open(device, flags, 0644);
+    if(panes->fd < 0) {
+        printf("Can not open %s\n", device);
+        exit(1);
+    }
+    fstat(panes->fd, &st);
+
+    if(S_ISCHR(st.st_mode)) {
+        struct fb_var_screeninfo vinfo;
+        struct fb_fix_screeninfo finfo;
+        if(ioctl(panes->fd, FBIOGET_VSCREENINFO, &vinfo) != 0 || ioctl(panes->fd, FBIOGET_FSCREENINFO, &finfo) != 0) {
+            printf("%s is not a framebuffer\n", device);
+            exit(1);
+        }
+
+        panes->width = vinfo.xres;
+        panes->height = vinfo.yres;
+        panes->bytes_per_pixel = vinfo.bits_per_pixel/8;
+        panes->line_length = finfo.line_length;
+        // Not every driver implements it, the first failed wait turns it off
+        panes->vsync = 1;
+        panes->map_size = finfo.smem_len;
+        panes->channel_offset[0] = vinfo.red.offset;
+        panes->channel_length[0] = vinfo.red.length;
+        panes->channel_offset[1] = vinfo.green.offset;
+        panes->channel_length[1] = vinfo.green.length;
+        panes->channel_offset[2] = vinfo.blue.offset;
+        panes->channel_length[2] = vinfo.blue.length;
+
+        // Draw into the page being scanned out
+        offset = (size_t)vinfo.yoffset*panes->line_length + vinfo.xoffset*panes->bytes_per_pixel;
+    }
+    else {
+        // XRGB8888
+        panes->width = FB_PANES_FILE_WIDTH;
+        panes->height = FB_PANES_FILE_HEIGHT;
+        panes->bytes_per_pixel = 4;
+        panes->line_length = panes->width*4;
+        panes->map_size = (size_t)panes->line_length*panes->height;
+        for(c=0; c<3; c++) {
+            panes->channel_offset[c] = 16 - c*8;
+            panes->channel_length[c] = 8;
+        }
+        int ret = ftruncate(panes->fd, panes->map_size);
+        assert(ret == 0);
+    }
+
+    // RGB565 and XRGB8888 cover the Pi console modes, others such as 24 bpp
+    // packed RGB are valid but not drawn by this renderer
+    if(panes->bytes_per_pixel != 2 && panes->bytes_per_pixel != 4) {
+        printf("%s: %d bpp framebuffers are not supported, set 16 or 32 bpp with fbset -depth\n",
+               device, panes->bytes_per_pixel*8);
+        exit(1);
+    }
+
+    panes->map = mmap(NULL, panes->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, panes->fd, 0);
+    assert(panes->map != MAP_FAILED);
+    panes->base = panes->map + offset;
+}
+
+static uint32_t pack_pixel(FB_PANES_T *panes, const uint8_t *rgb)
+{
+    uint32_t pixel = 0;
+    int c;
+
+    for(c=0; c<3; c++)
+        pixel |= (uint32_t)(rgb[c] >> (8 - panes->channel_length[c])) << panes->channel_offset[c];
+    return pixel;
+}
+
+// Source index and next-index weight for each of dst pixels, sampling at pixel
+// centres like GL_NEAREST and GL_LINEAR with clamp to edge
+static void scale_table(int src, int dst, FB_FILTER_T filter, int *index, uint8_t *weight)
+{
+    int i;
+
+    for(i=0; i<dst; i++) {
+        if(filter == FB_FILTER_NEAREST) {
+            index[i] = (int)((i + 0.5)*src/dst);
+            weight[i] = 0;
+            continue;
+        }
+
+        double u = (i + 0.5)*src/dst - 0.5;
+        if(u < 0.0)
+            u = 0.0;
+        int i0 = (int)u;
+        int w = (int)((u - i0)*256.0 + 0.5);
+        if(w >= 256) {
+            i0++;
+            w = 0;
+        }
+        if(i0 >= src - 1) {
+            i0 = src - 1;
+            w = 0;
+        }
+        index[i] = i0;
+        weight[i] = w;
+    }
+}
+
+// out = a + (b - a)*weight/256, rounded
+static void blend_rows(uint8_t *out, const uint8_t *a, const uint8_t *b, int weight, int width)
+{
+    int i = 0;
+
+#ifdef __ARM_NEON
+    const uint8x8_t weight_a = vdup_n_u8(256 - weight);
+    const uint8x8_t weight_b = vdup_n_u8(weight);
+
+    for(; i + 16 <= width; i += 16) {
+        uint8x16_t va = vld1q_u8(&a[i]);
+        uint8x16_t vb = vld1q_u8(&b[i]);
+        uint16x8_t low = vmlal_u8(vmull_u8(vget_low_u8(va), weight_a), vget_low_u8(vb), weight_b);
+        uint16x8_t high = vmlal_u8(vmull_u8(vget_high_u8(va), weight_a), vget_high_u8(vb), weight_b);
+        vst1q_u8(&out[i], vcombine_u8(vrshrn_n_u16(low, 8), vrshrn_n_u16(high, 8)));
+    }
+#endif
+
+    for(; i<width; i++)
+        out[i] = (a[i]*(256 - weight) + b[i]*weight + 128) >> 8;
+}
+
+static void scale_row_32(FB_PANES_T *panes, uint32_t *out, const uint8_t *src)
+{
+    const int *index = panes->x_index;
+    const uint8_t *weight = panes->x_weight;
+    const uint32_t *lut = panes->lut;
+    int x;
+
+    if(panes->filter == FB_FILTER_NEAREST) {
+        for(x=0; x<panes->pane_width; x++)
+            out[x] = lut[src[index[x]]];
+        return;
+    }
+
+    for(x=0; x<panes->pane_width; x++) {
+        int i = index[x], w = weight[x];
+        out[x] = lut[w ? (src[i]*(256 - w) + src[i + 1]*w + 128) >> 8 : src[i]];
+    }
+}
+
+static void scale_row_16(FB_PANES_T *panes, uint16_t *out, const uint8_t *src)
+{
+    const int *index = panes->x_index;
+    const uint8_t *weight = panes->x_weight;
+    const uint32_t *lut = panes->lut;
+    int x;
+
+    if(panes->filter == FB_FILTER_NEAREST) {
+        for(x=0; x<panes->pane_width; x++)
+            out[x] = lut[src[index[x]]];
+        return;
+    }
+
+    for(x=0; x<panes->pane_width; x++) {
+        int i = index[x], w = weight[x];
+        out[x] = lut[w ? (src[i]*(256 - w) + src[i + 1]*w + 128) >> 8 : src[i]];
+    }
+}
+
+// Screen row y of a pane needs redrawing when a pane row it samples changed
+static int row_dirty(FB_PANES_T *panes, FB_PANE_T *pane, int y)
+{
+    int row = panes->y_index[y];
+
+    if(pane->dirty[row])
+        return 1;
+    return panes->y_weight[y] && pane->dirty[row + 1];
+}
+
+static void draw_row(FB_PANES_T *panes, FB_PANES_WORKER_T *worker, FB_PANE_T *pane, int y)
+{
+    const uint8_t *src = &pane->pixels[panes->y_index[y]*panes->tex_width];
+    uint8_t *out = panes->base + (size_t)y*panes->line_length + pane->x*panes->bytes_per_pixel;
+
+    // Vertical filtering is a whole row blend, horizontal goes through the tables
+    if(panes->y_weight[y]) {
+        blend_rows(worker->row, src, src + panes->tex_width, panes->y_weight[y], panes->tex_width);
+        src = worker->row;
+    }
+
+    if(panes->bytes_per_pixel == 4)
+        scale_row_32(panes, (uint32_t *)out, src);
+    else
+        scale_row_16(panes, (uint16_t *)out, src);
+    worker->rows++;
+}
+
+static void *fb_panes_worker(void *arg)
+{
+    FB_PANES_WORKER_T *worker = arg;
+    FB_PANES_T *panes = worker->panes;
+    int index = worker - panes->workers;
+    unsigned int seen = 0;
+    int p, y;
+
+    while(1) {
+        pthread_mutex_lock(&panes->lock);
+        while(panes->generation == seen && !panes->quit)
+            pthread_cond_wait(&panes->start, &panes->lock);
+        if(panes->quit) {
+            pthread_mutex_unlock(&panes->lock);
+            break;
+        }
+        seen = panes->generation;
+        pthread_mutex_unlock(&panes->lock);
+
+        // Band of screen rows for this worker, across both panes
+        int first = panes->height*index/panes->thread_count;
+        int last = panes->height*(index + 1)/panes->thread_count;
+        for(y=first; y<last; y++) {
+            for(p=0; p<FB_PANES_COUNT; p++) {
+                FB_PANE_T *pane = &panes->pane[p];
+                if(panes->full || (pane->dirty_count && row_dirty(panes, pane, y)))
+                    draw_row(panes, worker, pane, y);
+            }
+        }
+
+        pthread_mutex_lock(&panes->lock);
+        if(--panes->pending == 0)
+            pthread_cond_signal(&panes->done);
+        pthread_mutex_unlock(&panes->lock);
+    }
+
+    return NULL;
+}
+
+// Opens device, a framebuffer or a file, and lays out two tex_width x tex_height panes on it
+void fb_panes_init(FB_PANES_T *panes, const char *device, int tex_width, int tex_height, FB_FILTER_T filter, int thread_count)
+{
+    int p, y;
+
+    assert(thread_count >= 1 && thread_count <= FB_PANES_MAX_THREADS);
+
+    memset(panes, 0, sizeof(FB_PANES_T));
+    panes->tex_width = tex_width;
+    panes->tex_height = tex_height;
+    panes->filter = filter;
+    panes->thread_count = thread_count;
+
+    open_target(panes, device);
+
+    // Same placement as the multi_tex quads, a thin gap down the middle
+    panes->pane_width = (int)(panes->width*(1.0f - FB_PANES_GAP)/2.0f);
+    panes->pane[0].x = 0;
+    panes->pane[1].x = panes->width - panes->pane_width;
+
+    for(p=0; p<FB_PANES_COUNT; p++) {
+        FB_PANE_T *pane = &panes->pane[p];
+        pane->pixels = calloc((size_t)tex_width*tex_height, 1);
+        pane->dirty = malloc(tex_height);
+        assert(pane->pixels && pane->dirty);
+
+        // Nothing drawn yet
+        memset(pane->dirty, 1, tex_height);
+        pane->dirty_count = tex_height;
+    }
+
+    panes->x_index = malloc(panes->pane_width*sizeof(int));
+    panes->x_weight = malloc(panes->pane_width);
+    panes->y_index = malloc(panes->height*sizeof(int));
+    panes->y_weight = malloc(panes->height);
+    assert(panes->x_index && panes->x_weight && panes->y_index && panes->y_weight);
+    scale_table(tex_width, panes->pane_width, filter, panes->x_index, panes->x_weight);
+    scale_table(tex_height, panes->height, filter, panes->y_index, panes->y_weight);
+
+    fb_panes_set_colormap(panes, 0);
+
+    // Background once, afterwards only pane rows are written
+    uint8_t grey[3] = { FB_PANES_BACKGROUND, FB_PANES_BACKGROUND, FB_PANES_BACKGROUND };
+    uint32_t background = pack_pixel(panes, grey);
+    for(y=0; y<panes->height; y++) {
+        uint8_t *line = panes->base + (size_t)y*panes->line_length;
+        int x;
+        for(x=0; x<panes->width; x++) {
+            if(panes->bytes_per_pixel == 4)
+                ((uint32_t *)line)[x] = background;
+            else
+                ((uint16_t *)line)[x] = background;
+        }
+    }
+
+    pthread_mutex_init(&panes->lock, NULL);
+    pthread_cond_init(&panes->start, NULL);
+    pthread_cond_init(&panes->done, NULL);
+
+    for(p=0; p<thread_count; p++) {
+        FB_PANES_WORKER_T *worker = &panes->workers[p];
+        worker->panes = panes;
+        worker->row = malloc(tex_width);
+        assert(worker->row);
+        int ret = pthread_create(&worker->thread, NULL, fb_panes_worker, worker);
+        assert(ret == 0);
+    }
+
+    printf("Framebuffer %s: %dx%d at %d bpp, %dx%d panes, %s, %d threads%s\n", device,
+           panes->width, panes->height, panes->bytes_per_pixel*8, panes->pane_width, panes->height,
+           filter == FB_FILTER_NEAREST ? "nearest" : "bilinear", thread_count,
+#ifdef __ARM_NEON
+           ", NEON"
+#else
+           ""
+#endif
+          );
+}
+
+// Grey ramp, or the same black-red-yellow-white colormap as the GL variants
+void fb_panes_set_colormap(FB_PANES_T *panes, int colormap)
+{
+    int i, p;
+
+    for(i=0; i<256; i++) {
+        uint8_t rgb[3] = { i, i, i };
+        if(colormap) {
+            int level = i*3;
+            rgb[0] = level > 255 ? 255 : level;
+            rgb[1] = level > 510 ? 255 : level > 255 ? level - 255 : 0;
+            rgb[2] = level > 510 ? level - 510 : 0;
+        }
+        panes->lut[i] = pack_pixel(panes, rgb);
+    }
+    panes->colormap = colormap;
+
+    // Every pixel changes colour
+    for(p=0; p<FB_PANES_COUNT; p++) {
+        memset(panes->pane[p].dirty, 1, panes->tex_height);
+        panes->pane[p].dirty_count = panes->tex_height;
+    }
+}
+
+void fb_panes_update_row(FB_PANES_T *panes, int pane, int row, const uint8_t *row_pixels)
+{
+    fb_panes_update_rows(panes, pane, row, 1, row_pixels);
+}
+
+// Copies rows into a pane, rows identical to what it holds are not redrawn
+void fb_panes_update_rows(FB_PANES_T *panes, int pane, int row, int rows, const uint8_t *pixels)
+{
+    FB_PANE_T *target = &panes->pane[pane];
+    int i;
+
+    assert(row >= 0 && row + rows <= panes->tex_height);
+
+    for(i=0; i<rows; i++) {
+        uint8_t *dst = &target->pixels[(row + i)*panes->tex_width];
+        const uint8_t *src = &pixels[i*panes->tex_width];
+
+        if(memcmp(dst, src, panes->tex_width) == 0)
+            continue;
+        memcpy(dst, src, panes->tex_width);
+        if(!target->dirty[row + i]) {
+            target->dirty[row + i] = 1;
+            target->dirty_count++;
+        }
+    }
+}
+
+// Redraws screen rows showing changed pane rows, split into bands across the workers
+void fb_panes_draw(FB_PANES_T *panes)
+{
+    double start = fb_panes_time();
+    unsigned long rows = 0;
+    int p;
+
+    panes->stats.frames++;
+    if(!panes->full && !panes->pane[0].dirty_count && !panes->pane[1].dirty_count)
+        return;
+
+    for(p=0; p<panes->thread_count; p++)
+        panes->workers[p].rows = 0;
+
+    pthread_mutex_lock(&panes->lock);
+    panes->pending = panes->thread_count;
+    panes->generation++;
+    pthread_cond_broadcast(&panes->start);
+    while(panes->pending)
+        pthread_cond_wait(&panes->done, &panes->lock);
+    pthread_mutex_unlock(&panes->lock);
+
+    for(p=0; p<FB_PANES_COUNT; p++) {
+        if(panes->pane[p].dirty_count) {
+            memset(panes->pane[p].dirty, 0, panes->tex_height);
+            panes->pane[p].dirty_count = 0;
+        }
+    }
+
+    double elapsed = fb_panes_time() - start;
+    panes->stats.seconds += elapsed;
+    if(elapsed > panes->stats.max)
+        panes->stats.max = elapsed;
+    for(p=0; p<panes->thread_count; p++)
+        rows += panes->workers[p].rows;
+    panes->stats.rows += rows;
+}
+
+// Blocks until the next vertical blank, or the next tick of a fixed rate clock
+// when the driver has no vsync wait, so the main loop does not spin
+void fb_panes_wait_vsync(FB_PANES_T *panes)
+{
+    if(panes->vsync) {
+        uint32_t crtc = 0;
+        if(ioctl(panes->fd, FBIO_WAITFORVSYNC, &crtc) == 0) {
+            panes->stats.vsync_waits++;
+            return;
+        }
+        printf("Framebuffer: no vsync wait, pacing at %d Hz\n", FB_PANES_FALLBACK_HZ);
+        panes->vsync = 0;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Start the grid now, or restart it after falling more than a frame behind
+    long period = 1000000000L/FB_PANES_FALLBACK_HZ;
+    long long behind = (now.tv_sec - panes->next_frame.tv_sec)*1000000000LL + (now.tv_nsec - panes->next_frame.tv_nsec);
+    if(!panes->next_frame.tv_sec || behind > period)
+        panes->next_frame = now;
+
+    panes->next_frame.tv_nsec += period;
+    if(panes->next_frame.tv_nsec >= 1000000000L) {
+        panes->next_frame.tv_nsec -= 1000000000L;
+        panes->next_frame.tv_sec++;
+    }
+
+    // A signal cuts the sleep short, which only matters when stopping
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &panes->next_frame, NULL);
+    panes->stats.clock_waits++;
+}
+
+void fb_panes_print_stats(FB_PANES_T *panes)
+{
+    FB_PANES_STATS_T *stats = &panes->stats;
+
+    if(!stats->frames)
+        return;
+
+    printf("Framebuffer: %lu frames, %.3f ms average draw, %.3f ms worst, %.1f screen rows per frame\n",
+           stats->frames, stats->seconds/stats->frames*1e3, stats->max*1e3, (double)stats->rows/stats->frames);
+    if(stats->vsync_waits || stats->clock_waits)
+        printf("Framebuffer: %lu frames paced by vsync, %lu by the %d Hz clock\n",
+               stats->vsync_waits, stats->clock_waits, FB_PANES_FALLBACK_HZ);
+}
+
+void fb_panes_destroy(FB_PANES_T *panes)
+{
+    int p;
+
+    pthread_mutex_lock(&panes->lock);
+    panes->quit = 1;
+    pthread_cond_broadcast(&panes->start);
+    pthread_mutex_unlock(&panes->lock);
+
+    for(p=0; p<panes->thread_count; p++) {
+        pthread_join(panes->workers[p].thread, NULL);
+        free(panes->workers[p].row);
+    }
+
+    pthread_mutex_destroy(&panes->lock);
+    pthread_cond_destroy(&panes->start);
+    pthread_cond_destroy(&panes->done);
+
+    for(p=0; p<FB_PANES_COUNT; p++) {
+        free(panes->pane[p].pixels);
+        free(panes->pane[p].dirty);
+    }
+    free(panes->x_index);
+    free(panes->x_weight);
+    free(panes->y_index);
+    free(panes->y_weight);
+
+    munmap(panes->map, panes->map_size);
+    close(panes->fd);
+    memset(panes, 0, sizeof(FB_PANES_T));
+}
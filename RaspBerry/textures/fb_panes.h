@@ -0,0 +1,129 @@
+#ifndef FB_PANES_H
+#define FB_PANES_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+// Software renderer for the two multi_tex panes, for nodes without a GLES driver.
+// Panes are scaled into a memory mapped framebuffer with the same layout as
+// the GL path, and only screen rows showing changed pane rows are redrawn.
+
+#define FB_PANES_COUNT 2
+
+// Worker threads, each redraws a horizontal band of the screen
+#define FB_PANES_MAX_THREADS 4
+
+// Size given to plain file targets, which have no mode to query
+#define FB_PANES_FILE_WIDTH 1920
+#define FB_PANES_FILE_HEIGHT 1080
+
+// Frame period when the driver can not wait for vsync, or the target is a file
+#define FB_PANES_FALLBACK_HZ 60
+
+typedef enum {
+    FB_FILTER_NEAREST,
+    FB_FILTER_BILINEAR
+} FB_FILTER_T;
+
+typedef struct
+{
+    unsigned long frames;
+    // Screen rows redrawn, both panes counted separately
+    unsigned long rows;
+    double seconds;
+    double max;
+    // Frames paced by the driver vsync and by the fallback clock
+    unsigned long vsync_waits;
+    unsigned long clock_waits;
+} FB_PANES_STATS_T;
+
+struct FB_PANES_S;
+
+typedef struct
+{
+    struct FB_PANES_S *panes;
+    pthread_t thread;
+
+    // Vertically blended source row for bilinear filtering
+    uint8_t *row;
+    unsigned long rows;
+} FB_PANES_WORKER_T;
+
+typedef struct
+{
+    // 8-bit pixels, the counterpart of a pane texture
+    uint8_t *pixels;
+    // Non zero per pixel row changed since the last draw
+    uint8_t *dirty;
+    int dirty_count;
+
+    // Left edge on screen, all panes share width and height
+    int x;
+} FB_PANE_T;
+
+typedef struct FB_PANES_S
+{
+    // Mapped framebuffer, base points at the visible page
+    int fd;
+    uint8_t *map;
+    size_t map_size;
+    uint8_t *base;
+    int width;
+    int height;
+    int bytes_per_pixel;
+    int line_length;
+
+    // FBIO_WAITFORVSYNC works on this target, otherwise frames are paced on a
+    // fixed clock grid starting at next_frame
+    int vsync;
+    struct timespec next_frame;
+
+    // Bit position and width of red, green and blue in a pixel
+    int channel_offset[3];
+    int channel_length[3];
+
+    // Pane pixel size and its size on screen
+    int tex_width;
+    int tex_height;
+    int pane_width;
+    FB_PANE_T pane[FB_PANES_COUNT];
+
+    FB_FILTER_T filter;
+
+    // Source column and row per screen pixel, with the 1/256 weight of the
+    // next one when filtering
+    int *x_index;
+    uint8_t *x_weight;
+    int *y_index;
+    uint8_t *y_weight;
+
+    // Luminance to framebuffer pixel, grey or colormapped
+    uint32_t lut[256];
+    int colormap;
+
+    // Redraw every screen row on each draw, for benchmarking
+    int full;
+
+    int thread_count;
+    FB_PANES_WORKER_T workers[FB_PANES_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned int generation;
+    int pending;
+    int quit;
+
+    FB_PANES_STATS_T stats;
+} FB_PANES_T;
+
+void fb_panes_init(FB_PANES_T *panes, const char *device, int tex_width, int tex_height, FB_FILTER_T filter, int thread_count);
+void fb_panes_set_colormap(FB_PANES_T *panes, int colormap);
+void fb_panes_update_row(FB_PANES_T *panes, int pane, int row, const uint8_t *row_pixels);
+void fb_panes_update_rows(FB_PANES_T *panes, int pane, int row, int rows, const uint8_t *pixels);
+void fb_panes_draw(FB_PANES_T *panes);
+void fb_panes_wait_vsync(FB_PANES_T *panes);
+void fb_panes_print_stats(FB_PANES_T *panes);
+void fb_panes_destroy(FB_PANES_T *panes);
+
+#endif
@@ -0,0 +1,161 @@
+// multi_tex without a GPU: the same panes and test pattern drawn by the CPU
+// into the console framebuffer, or a file standing in for it
+//
+// Usage: fb_tex [--device PATH] [--bilinear] [--threads N] [--colormap]
+//               [--full] [--frames N] [--shm] [--no-vsync]
+//
+// --full redraws every row each frame rather than only changed rows, and
+// --frames stops after N frames, which together give a worst case frame time
+// to hold against the multi_tex fps readout. Frames are paced to the display
+// vsync, or a 60 Hz clock when the driver has none; --no-vsync draws flat out.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+#include "fb_panes.h"
+#include "shm_ring.h"
+#include "pane_layout.h"
+
+static volatile sig_atomic_t terminate = 0;
+
+static void stop(int signal)
+{
+    terminate = 1;
+}
+
+static double get_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Copies rows published by an external producer into pane 1
+static int update_shared_rows(FB_PANES_T *panes, SHM_RING_T *ring, int *head)
+{
+    int total = 0;
+    uint32_t rows;
+    uint64_t seq;
+    uint8_t *pixels;
+
+    while(total < SHM_MAX_ROWS_PER_FRAME
+          && (pixels = shm_ring_acquire(ring, SHM_MAX_ROWS_PER_FRAME - total, &rows, &seq))) {
+        if(rows > (uint32_t)(PANE_HEIGHT - *head))
+            rows = PANE_HEIGHT - *head;
+
+        fb_panes_update_rows(panes, 1, *head, rows, pixels);
+        shm_ring_release(ring, rows);
+
+        *head = (*head + rows) % PANE_HEIGHT;
+        total += rows;
+    }
+
+    return total;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *device = "/dev/fb0";
+    FB_FILTER_T filter = FB_FILTER_NEAREST;
+    int threads = FB_PANES_MAX_THREADS;
+    int colormap = 0, full = 0, shared = 0, vsync = 1;
+    unsigned long max_frames = 0;
+    int i;
+
+    for(i=1; i<argc; i++) {
+        if(strcmp(argv[i], "--device") == 0 && i+1 < argc)
+            device = argv[++i];
+        else if(strcmp(argv[i], "--bilinear") == 0)
+            filter = FB_FILTER_BILINEAR;
+        else if(strcmp(argv[i], "--threads") == 0 && i+1 < argc) {
+            threads = atoi(argv[++i]);
+            if(threads < 1 || threads > FB_PANES_MAX_THREADS) {
+                printf("Usage: %s --threads N, N from 1 to %d\n", argv[0], FB_PANES_MAX_THREADS);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "--colormap") == 0)
+            colormap = 1;
+        else if(strcmp(argv[i], "--full") == 0)
+            full = 1;
+        else if(strcmp(argv[i], "--frames") == 0 && i+1 < argc)
+            max_frames = strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--shm") == 0)
+            shared = 1;
+        else if(strcmp(argv[i], "--no-vsync") == 0)
+            vsync = 0;
+    }
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    FB_PANES_T panes;
+    fb_panes_init(&panes, device, PANE_WIDTH, PANE_HEIGHT, filter, threads);
+    fb_panes_set_colormap(&panes, colormap);
+    panes.full = full;
+
+    // Same starting images as multi_tex, black and white
+    uint8_t *pixels = malloc(PANE_WIDTH*UPLOAD_MAX_ROWS);
+    memset(pixels, 255, PANE_WIDTH*UPLOAD_MAX_ROWS);
+    for(i=0; i<PANE_HEIGHT; i++)
+        fb_panes_update_row(&panes, 1, i, pixels);
+
+    uint8_t *row = calloc(PANE_WIDTH, 1);
+
+    SHM_RING_T ring;
+    int shm_row = 0;
+    memset(&ring, 0, sizeof(SHM_RING_T));
+    if(shared)
+        shm_ring_create(&ring, SHM_RING_NAME, PANE_WIDTH, SHM_RING_ROWS);
+
+    unsigned long frames = 0;
+    int fps_frames = 0;
+    double start = get_time();
+    double fps_start = start;
+
+    i = 0;
+    while(!terminate && (!max_frames || frames < max_frames)) {
+        if(ring.header) {
+            if(!update_shared_rows(&panes, &ring, &shm_row))
+                shm_ring_wait(&ring, SHM_WAIT_MS);
+        }
+        else if(i < PANE_HEIGHT)
+            fb_panes_update_row(&panes, 1, i, row);
+
+        if(i*UPLOAD_MAX_ROWS < PANE_HEIGHT)
+            fb_panes_update_rows(&panes, 0, i*UPLOAD_MAX_ROWS, UPLOAD_MAX_ROWS, pixels);
+
+        if(i < PANE_HEIGHT)
+            i++;
+
+        fb_panes_draw(&panes);
+        frames++;
+
+        // Nothing to gain from drawing faster than the display refreshes
+        if(vsync)
+            fb_panes_wait_vsync(&panes);
+
+        // Frame rate, once a second
+        fps_frames++;
+        double now = get_time();
+        if(now - fps_start >= 1.0) {
+            printf("%.1f fps\n", fps_frames/(now - fps_start));
+            fps_frames = 0;
+            fps_start = now;
+        }
+    }
+
+    printf("%lu frames in %.2f s\n", frames, get_time() - start);
+    fb_panes_print_stats(&panes);
+
+    if(ring.header)
+        shm_ring_destroy(&ring);
+    fb_panes_destroy(&panes);
+    free(pixels);
+    free(row);
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "latency.h"
+
+// EGL_ANDROID_get_frame_timestamps, not in every eglext.h
+#ifndef EGL_TIMESTAMPS_ANDROID
+#define EGL_TIMESTAMPS_ANDROID 0x3430
+#define EGL_DISPLAY_PRESENT_TIME_ANDROID 0x343A
+#define EGL_TIMESTAMP_PENDING_ANDROID -2
+#define EGL_TIMESTAMP_INVALID_ANDROID -1
+#endif
+
+static const char *stage_names[LATENCY_STAGES] = { "upload", "swap", "present" };
+
+// CLOCK_MONOTONIC in nanoseconds, the time base of every stamp
+uint64_t latency_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+static void record(LATENCY_T *latency, LATENCY_STAGE_T stage, uint64_t ingest_ns, uint64_t at_ns, uint64_t rows)
+{
+    uint64_t us = at_ns > ingest_ns ? (at_ns - ingest_ns)/1000 : 0;
+    latency_histogram_add(&latency->block.stages[stage], us, rows);
+}
+
+// Turns on frame timestamps when the EGL offers them
+void latency_init(LATENCY_T *latency, EGL_STATE_T *egl)
+{
+    memset(latency, 0, sizeof(LATENCY_T));
+    latency->display = egl->display;
+    latency->surface = egl->surface;
+
+    if(egl_has_extension(egl, "EGL_ANDROID_get_frame_timestamps")
+       && eglSurfaceAttrib(egl->display, egl->surface, EGL_TIMESTAMPS_ANDROID, EGL_TRUE)) {
+        latency->get_next_frame_id = (EGL_GET_NEXT_FRAME_ID_PROC_T)eglGetProcAddress("eglGetNextFrameIdANDROID");
+        latency->get_frame_timestamps = (EGL_GET_FRAME_TIMESTAMPS_PROC_T)eglGetProcAddress("eglGetFrameTimestampsANDROID");
+        if(!latency->get_next_frame_id || !latency->get_frame_timestamps)
+            latency->get_next_frame_id = NULL;
+    }
+    latency->block.present_measured = latency->get_next_frame_id != NULL;
+
+    latency_shm_create(&latency->shm, LATENCY_BLOCK_NAME);
+
+    printf("Latency telemetry: presentation %s\n",
+           latency->block.present_measured ? "from frame timestamps" : "estimated from the swap interval");
+}
+
+// Records rows that arrived at ingest_ns being uploaded now, they join the next swap
+void latency_upload(LATENCY_T *latency, uint64_t ingest_ns, uint64_t rows)
+{
+    record(latency, LATENCY_UPLOAD, ingest_ns, latency_now(), rows);
+
+    if(latency->pending_count < LATENCY_MAX_PENDING) {
+        LATENCY_ROWS_T *block = &latency->pending[latency->pending_count++];
+        block->ingest_ns = ingest_ns;
+        block->rows = rows;
+        return;
+    }
+
+    // Out of room, the rows are timed from the older arrival
+    LATENCY_ROWS_T *last = &latency->pending[LATENCY_MAX_PENDING - 1];
+    if(ingest_ns < last->ingest_ns)
+        last->ingest_ns = ingest_ns;
+    last->rows += rows;
+    latency->stats.merged++;
+}
+
+// Call right before egl_swap(), the EGL numbers the frame about to be queued
+void latency_begin_swap(LATENCY_T *latency)
+{
+    if(latency->get_next_frame_id && !latency->get_next_frame_id(latency->display, latency->surface, &latency->next_frame_id))
+        latency->next_frame_id = 0;
+}
+
+// Records the presentation of queued frames as their timestamps come in,
+// oldest first. A frame still pending holds up the ones behind it.
+static void collect_presents(LATENCY_T *latency)
+{
+    const EGLint names[] = { EGL_DISPLAY_PRESENT_TIME_ANDROID };
+    int i;
+
+    while(latency->frame_count) {
+        LATENCY_FRAME_T *frame = &latency->frames[latency->first_frame];
+        LATENCY_NSECS_T present = EGL_TIMESTAMP_INVALID_ANDROID;
+
+        if(!latency->get_frame_timestamps(latency->display, latency->surface, frame->frame_id, 1, names, &present))
+            present = EGL_TIMESTAMP_INVALID_ANDROID;
+        if(present == EGL_TIMESTAMP_PENDING_ANDROID)
+            break;
+
+        if(present >= 0) {
+            for(i=0; i<frame->count; i++)
+                record(latency, LATENCY_PRESENT, frame->blocks[i].ingest_ns, present, frame->blocks[i].rows);
+        }
+        else
+            latency->stats.presents_lost++;
+
+        latency->first_frame = (latency->first_frame + 1) % LATENCY_PRESENT_FRAMES;
+        latency->frame_count--;
+    }
+}
+
+// Call right after egl_swap() returns, publishes the distributions
+void latency_end_swap(LATENCY_T *latency)
+{
+    uint64_t now = latency_now();
+    int i;
+
+    // Exponential average over roughly the last 16 swaps
+    if(latency->last_swap_ns) {
+        uint64_t interval = now - latency->last_swap_ns;
+        latency->frame_interval_ns = latency->frame_interval_ns
+            ? (uint64_t)((int64_t)latency->frame_interval_ns + ((int64_t)interval - (int64_t)latency->frame_interval_ns)/16)
+            : interval;
+    }
+    latency->last_swap_ns = now;
+
+    for(i=0; i<latency->pending_count; i++)
+        record(latency, LATENCY_SWAP, latency->pending[i].ingest_ns, now, latency->pending[i].rows);
+
+    if(latency->get_next_frame_id && latency->next_frame_id) {
+        // Queue the rows for the frame's timestamp, dropping the oldest frame if the display fell silent
+        if(latency->frame_count == LATENCY_PRESENT_FRAMES) {
+            latency->first_frame = (latency->first_frame + 1) % LATENCY_PRESENT_FRAMES;
+            latency->frame_count--;
+            latency->stats.presents_lost++;
+        }
+        LATENCY_FRAME_T *frame = &latency->frames[(latency->first_frame + latency->frame_count++) % LATENCY_PRESENT_FRAMES];
+        frame->frame_id = latency->next_frame_id;
+        frame->count = latency->pending_count;
+        memcpy(frame->blocks, latency->pending, latency->pending_count*sizeof(LATENCY_ROWS_T));
+        collect_presents(latency);
+    }
+    else {
+        // The swap returns once the frame is queued, it is scanned out about a frame later
+        for(i=0; i<latency->pending_count; i++)
+            record(latency, LATENCY_PRESENT, latency->pending[i].ingest_ns, now + latency->frame_interval_ns,
+                   latency->pending[i].rows);
+    }
+    latency->pending_count = 0;
+
+    latency->block.frames++;
+    latency->block.published_ns = now;
+    latency_shm_publish(&latency->shm, &latency->block);
+}
+
+void latency_print_stats(LATENCY_T *latency)
+{
+    int s;
+
+    for(s=0; s<LATENCY_STAGES; s++) {
+        LATENCY_HISTOGRAM_T *histogram = &latency->block.stages[s];
+        if(!histogram->rows)
+            continue;
+        printf("Latency to %-7s: mean %.2f ms, p50 %.2f ms, p99 %.2f ms, max %.2f ms over %llu rows\n", stage_names[s],
+               histogram->sum_us/(histogram->rows*1e3), latency_histogram_percentile(histogram, 0.5)/1e3,
+               latency_histogram_percentile(histogram, 0.99)/1e3, histogram->max_us/1e3,
+               (unsigned long long)histogram->rows);
+    }
+    printf("Latency telemetry: presentation %s, %lu row blocks merged, %lu presentation times lost\n",
+           latency->block.present_measured ? "measured" : "estimated", latency->stats.merged, latency->stats.presents_lost);
+}
+
+void latency_destroy(LATENCY_T *latency)
+{
+    latency_shm_destroy(&latency->shm);
+    memset(latency, 0, sizeof(LATENCY_T));
+}
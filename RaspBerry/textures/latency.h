@@ -0,0 +1,80 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+#include "egl_utils.h"
+#include "latency_block.h"
+
+// Data to display latency of pane rows. Rows carry the CLOCK_MONOTONIC time
+// they arrived, in nanoseconds, and are timed again as they are uploaded, as
+// the swap that contains them returns and as that frame reaches the display.
+// Presentation comes from EGL_ANDROID_get_frame_timestamps when the EGL has
+// it, otherwise it is estimated as one frame interval after the swap.
+
+// Uploaded row blocks waiting for the swap, later blocks merge into the last
+#define LATENCY_MAX_PENDING 64
+
+// Swapped frames waiting for their presentation time
+#define LATENCY_PRESENT_FRAMES 8
+
+typedef int64_t LATENCY_NSECS_T;
+typedef EGLBoolean (*EGL_GET_NEXT_FRAME_ID_PROC_T)(EGLDisplay display, EGLSurface surface, uint64_t *frame_id);
+typedef EGLBoolean (*EGL_GET_FRAME_TIMESTAMPS_PROC_T)(EGLDisplay display, EGLSurface surface, uint64_t frame_id,
+                                                      EGLint count, const EGLint *names, LATENCY_NSECS_T *values);
+
+typedef struct
+{
+    uint64_t ingest_ns;
+    uint64_t rows;
+} LATENCY_ROWS_T;
+
+typedef struct
+{
+    uint64_t frame_id;
+    int count;
+    LATENCY_ROWS_T blocks[LATENCY_MAX_PENDING];
+} LATENCY_FRAME_T;
+
+typedef struct
+{
+    unsigned long merged;
+    unsigned long presents_lost;
+} LATENCY_STATS_T;
+
+typedef struct
+{
+    // Rows uploaded since the last swap
+    LATENCY_ROWS_T pending[LATENCY_MAX_PENDING];
+    int pending_count;
+
+    // Smoothed swap to swap time, the presentation estimate without timestamps
+    uint64_t last_swap_ns;
+    uint64_t frame_interval_ns;
+
+    // Frame timestamps, frames queued oldest first from first_frame
+    EGLDisplay display;
+    EGLSurface surface;
+    EGL_GET_NEXT_FRAME_ID_PROC_T get_next_frame_id;
+    EGL_GET_FRAME_TIMESTAMPS_PROC_T get_frame_timestamps;
+    uint64_t next_frame_id;
+    LATENCY_FRAME_T frames[LATENCY_PRESENT_FRAMES];
+    int first_frame;
+    int frame_count;
+
+    // Distributions built here and copied out once a frame
+    LATENCY_BLOCK_T block;
+    LATENCY_SHM_T shm;
+
+    LATENCY_STATS_T stats;
+} LATENCY_T;
+
+uint64_t latency_now();
+void latency_init(LATENCY_T *latency, EGL_STATE_T *egl);
+void latency_upload(LATENCY_T *latency, uint64_t ingest_ns, uint64_t rows);
+void latency_begin_swap(LATENCY_T *latency);
+void latency_end_swap(LATENCY_T *latency);
+void latency_print_stats(LATENCY_T *latency);
+void latency_destroy(LATENCY_T *latency);
+
+#endif
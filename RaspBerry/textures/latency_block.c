@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "latency_block.h"
+
+// Copies attempted before a reader gives up on a renderer that died mid publish
+#define LATENCY_READ_RETRIES 1000
+
+static int bucket_index(uint64_t us)
+{
+    int octave;
+
+    if(us < LATENCY_SUB_BUCKETS)
+        return (int)us;
+
+    // Whole octave from the top bit, the quarter from the two bits below it
+    octave = 63 - __builtin_clzll(us);
+    int bucket = LATENCY_SUB_BUCKETS*(octave - 1) + (int)((us >> (octave - 2)) & (LATENCY_SUB_BUCKETS - 1));
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+// First value past the bucket
+static uint64_t bucket_limit(int bucket)
+{
+    if(bucket < LATENCY_SUB_BUCKETS)
+        return bucket + 1;
+
+    int octave = bucket/LATENCY_SUB_BUCKETS + 1;
+    return (uint64_t)(LATENCY_SUB_BUCKETS + 1 + bucket%LATENCY_SUB_BUCKETS) << (octave - 2);
+}
+
+void latency_histogram_add(LATENCY_HISTOGRAM_T *histogram, uint64_t us, uint64_t rows)
+{
+    histogram->buckets[bucket_index(us)] += rows;
+    histogram->rows += rows;
+    histogram->sum_us += us*rows;
+    if(us > histogram->max_us)
+        histogram->max_us = us;
+}
+
+// Microseconds fraction of rows took no longer than, to within a quarter octave
+uint64_t latency_histogram_percentile(const LATENCY_HISTOGRAM_T *histogram, double fraction)
+{
+    uint64_t target = (uint64_t)(fraction*histogram->rows + 0.5);
+    uint64_t count = 0;
+    int i;
+
+    if(!histogram->rows)
+        return 0;
+    if(target < 1)
+        target = 1;
+
+    for(i=0; i<LATENCY_BUCKETS; i++) {
+        count += histogram->buckets[i];
+        if(count >= target)
+            break;
+    }
+
+    // The bucket limit overstates the slowest rows, max is exact
+    uint64_t limit = bucket_limit(i < LATENCY_BUCKETS ? i : LATENCY_BUCKETS - 1);
+    return limit < histogram->max_us ? limit : histogram->max_us;
+}
+
+// Rows recorded between two copies of a histogram, max is the lifetime max
+void latency_histogram_diff(LATENCY_HISTOGRAM_T *result, const LATENCY_HISTOGRAM_T *now, const LATENCY_HISTOGRAM_T *before)
+{
+    int i;
+
+    result->rows = now->rows - before->rows;
+    result->sum_us = now->sum_us - before->sum_us;
+    result->max_us = now->max_us;
+    for(i=0; i<LATENCY_BUCKETS; i++)
+        result->buckets[i] = now->buckets[i] - before->buckets[i];
+}
+
+// Creates, or recreates, the named block
+void latency_shm_create(LATENCY_SHM_T *shm, const char *name)
+{
+    memset(shm, 0, sizeof(LATENCY_SHM_T));
+    strncpy(shm->name, name, sizeof(shm->name) - 1);
+    shm->owner = 1;
+
+    // Start from a fresh object, monitors attached to a stale one keep their old pages
+    shm_unlink(name);
+    shm->fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0664);
+    assert(shm->fd >= 0);
+    int ret = ftruncate(shm->fd, sizeof(LATENCY_BLOCK_T));
+    assert(ret == 0);
+
+    shm->block = mmap(NULL, sizeof(LATENCY_BLOCK_T), PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+    assert(shm->block != MAP_FAILED);
+    shm->block->version = LATENCY_BLOCK_VERSION;
+
+    // Monitors refuse to attach until the magic is visible
+    __atomic_store_n(&shm->block->magic, LATENCY_BLOCK_MAGIC, __ATOMIC_RELEASE);
+
+    printf("Latency telemetry published in %s\n", name);
+}
+
+// Copies everything after the header into the shared block
+void latency_shm_publish(LATENCY_SHM_T *shm, const LATENCY_BLOCK_T *block)
+{
+    LATENCY_BLOCK_T *shared = shm->block;
+    uint32_t sequence = shared->sequence;
+
+    __atomic_store_n(&shared->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    shared->present_measured = block->present_measured;
+    shared->frames = block->frames;
+    shared->published_ns = block->published_ns;
+    memcpy(shared->stages, block->stages, sizeof(shared->stages));
+
+    __atomic_store_n(&shared->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+// Attaches read only to a block created by the renderer, returns 0 if it does not exist or is incompatible
+int latency_shm_open(LATENCY_SHM_T *shm, const char *name)
+{
+    memset(shm, 0, sizeof(LATENCY_SHM_T));
+    strncpy(shm->name, name, sizeof(shm->name) - 1);
+
+    shm->fd = shm_open(name, O_RDONLY, 0);
+    if(shm->fd < 0)
+        return 0;
+
+    shm->block = mmap(NULL, sizeof(LATENCY_BLOCK_T), PROT_READ, MAP_SHARED, shm->fd, 0);
+    if(shm->block == MAP_FAILED
+       || __atomic_load_n(&shm->block->magic, __ATOMIC_ACQUIRE) != LATENCY_BLOCK_MAGIC
+       || shm->block->version != LATENCY_BLOCK_VERSION) {
+        if(shm->block != MAP_FAILED)
+            munmap(shm->block, sizeof(LATENCY_BLOCK_T));
+        close(shm->fd);
+        memset(shm, 0, sizeof(LATENCY_SHM_T));
+        return 0;
+    }
+
+    struct stat st;
+    fstat(shm->fd, &st);
+    shm->device = st.st_dev;
+    shm->inode = st.st_ino;
+
+    return 1;
+}
+
+// Non zero when the name no longer refers to the mapped block, because the
+// renderer exited or a new one recreated it. The old pages stay mapped but
+// nobody publishes to them any more.
+int latency_shm_replaced(LATENCY_SHM_T *shm)
+{
+    struct stat st;
+
+    int fd = shm_open(shm->name, O_RDONLY, 0);
+    if(fd < 0)
+        return 1;
+    int ret = fstat(fd, &st);
+    close(fd);
+
+    return ret != 0 || (uint64_t)st.st_dev != shm->device || (uint64_t)st.st_ino != shm->inode;
+}
+
+// Takes a consistent copy of the block, returns 0 if none could be had
+int latency_shm_read(LATENCY_SHM_T *shm, LATENCY_BLOCK_T *block)
+{
+    const LATENCY_BLOCK_T *shared = shm->block;
+    int i;
+
+    for(i=0; i<LATENCY_READ_RETRIES; i++) {
+        uint32_t before = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+        if(before & 1)
+            continue;
+        memcpy(block, shared, sizeof(LATENCY_BLOCK_T));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&shared->sequence, __ATOMIC_RELAXED) == before)
+            return 1;
+    }
+
+    return 0;
+}
+
+void latency_shm_destroy(LATENCY_SHM_T *shm)
+{
+    if(shm->block) {
+        munmap(shm->block, sizeof(LATENCY_BLOCK_T));
+        close(shm->fd);
+    }
+    if(shm->owner)
+        shm_unlink(shm->name);
+    memset(shm, 0, sizeof(LATENCY_SHM_T));
+}
@@ -0,0 +1,86 @@
+#ifndef LATENCY_BLOCK_H
+#define LATENCY_BLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Shared memory block the renderer publishes latency distributions through
+//
+// Only the renderer writes it, once per frame, so a sequence counter is all
+// the synchronisation needed. sequence is odd while a publish is under way;
+// a reader copies the block and retries unless it saw the same even value
+// before and after the copy. Neither side ever waits on the other.
+//
+// Histograms count rows, not frames, and are cumulative since the renderer
+// started. Readers wanting a recent distribution diff two copies.
+#define LATENCY_BLOCK_MAGIC 0x4c41544e
+#define LATENCY_BLOCK_VERSION 1
+
+// Default object name in /dev/shm
+#define LATENCY_BLOCK_NAME "/ogl_tex_latency"
+
+// Quarter octave buckets of microseconds, exact below 4 us, the last
+// bucket holds everything above about a minute
+#define LATENCY_SUB_BUCKETS 4
+#define LATENCY_BUCKETS 100
+
+// Ingest to the glTexSubImage2D call, to egl_swap() returning, to presentation
+typedef enum
+{
+    LATENCY_UPLOAD,
+    LATENCY_SWAP,
+    LATENCY_PRESENT,
+    LATENCY_STAGES
+} LATENCY_STAGE_T;
+
+typedef struct
+{
+    uint64_t rows;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t buckets[LATENCY_BUCKETS];
+} LATENCY_HISTOGRAM_T;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sequence;
+
+    // Non zero when presentation times come from the display, otherwise they are estimated
+    uint32_t present_measured;
+    uint64_t frames;
+    uint64_t published_ns;
+    LATENCY_HISTOGRAM_T stages[LATENCY_STAGES];
+} LATENCY_BLOCK_T;
+
+typedef struct
+{
+    LATENCY_BLOCK_T *block;
+    int fd;
+
+    // Creator unlinks the object on destroy
+    int owner;
+    char name[64];
+
+    // Identity of the mapped object, a restarted renderer recreates the name
+    uint64_t device;
+    uint64_t inode;
+} LATENCY_SHM_T;
+
+void latency_histogram_add(LATENCY_HISTOGRAM_T *histogram, uint64_t us, uint64_t rows);
+uint64_t latency_histogram_percentile(const LATENCY_HISTOGRAM_T *histogram, double fraction);
+void latency_histogram_diff(LATENCY_HISTOGRAM_T *result, const LATENCY_HISTOGRAM_T *now, const LATENCY_HISTOGRAM_T *before);
+
+// Renderer side
+void latency_shm_create(LATENCY_SHM_T *shm, const char *name);
+void latency_shm_publish(LATENCY_SHM_T *shm, const LATENCY_BLOCK_T *block);
+
+// Monitor side
+int latency_shm_open(LATENCY_SHM_T *shm, const char *name);
+int latency_shm_read(LATENCY_SHM_T *shm, LATENCY_BLOCK_T *block);
+int latency_shm_replaced(LATENCY_SHM_T *shm);
+
+void latency_shm_destroy(LATENCY_SHM_T *shm);
+
+#endif
@@ -0,0 +1,86 @@
+// Reads the latency telemetry multi_tex --latency publishes
+//
+// Usage: latency_monitor [interval seconds] [block name]
+//
+// Prints the ingest to upload, swap and presentation latency of the rows
+// shown since the last report. Only reads the shared block, the renderer
+// never waits on the monitor.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "latency_block.h"
+
+static const char *stage_names[LATENCY_STAGES] = { "upload", "swap", "present" };
+
+static void print_stage(const char *name, const LATENCY_HISTOGRAM_T *histogram)
+{
+    if(!histogram->rows) {
+        printf("  %-7s no rows\n", name);
+        return;
+    }
+
+    printf("  %-7s mean %7.2f  p50 %7.2f  p90 %7.2f  p99 %7.2f  max %7.2f ms  %8llu rows\n", name,
+           histogram->sum_us/(histogram->rows*1e3), latency_histogram_percentile(histogram, 0.5)/1e3,
+           latency_histogram_percentile(histogram, 0.9)/1e3, latency_histogram_percentile(histogram, 0.99)/1e3,
+           histogram->max_us/1e3, (unsigned long long)histogram->rows);
+}
+
+int main(int argc, char *argv[])
+{
+    double interval = argc > 1 ? atof(argv[1]) : 1.0;
+    const char *name = argc > 2 ? argv[2] : LATENCY_BLOCK_NAME;
+    LATENCY_SHM_T shm;
+    LATENCY_BLOCK_T before, now;
+    LATENCY_HISTOGRAM_T recent;
+    int s;
+
+    // The renderer owns the block, wait for it to come up
+    while(!latency_shm_open(&shm, name)) {
+        printf("Waiting for %s\n", name);
+        sleep(1);
+    }
+
+    if(!latency_shm_read(&shm, &before)) {
+        printf("No consistent copy of %s, is the renderer stuck?\n", name);
+        return 1;
+    }
+    printf("Attached to %s, presentation %s\n", name, before.present_measured ? "measured" : "estimated");
+
+    while(1) {
+        usleep((useconds_t)(interval*1e6));
+
+        // A restarted renderer publishes into a new object under the same
+        // name, the mapped one would read 0 frames for ever
+        if(latency_shm_replaced(&shm)) {
+            latency_shm_destroy(&shm);
+            printf("%s went away, waiting for the renderer\n", name);
+            while(!latency_shm_open(&shm, name))
+                sleep(1);
+            memset(&before, 0, sizeof(LATENCY_BLOCK_T));
+            printf("Reattached to %s\n", name);
+            continue;
+        }
+
+        if(!latency_shm_read(&shm, &now))
+            continue;
+
+        if(now.published_ns == before.published_ns && before.published_ns) {
+            printf("No frames published, is the renderer stuck?\n");
+            continue;
+        }
+
+        printf("%llu frames, latency of rows since the last report, max over the run:\n",
+               (unsigned long long)(now.frames - before.frames));
+        for(s=0; s<LATENCY_STAGES; s++) {
+            latency_histogram_diff(&recent, &now.stages[s], &before.stages[s]);
+            print_stage(stage_names[s], &recent);
+        }
+        before = now;
+    }
+
+    latency_shm_destroy(&shm);
+    return 0;
+}
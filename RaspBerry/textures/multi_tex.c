@@ -1,9 +1,18 @@
 
+#include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
 
 #include "multi_tex.h"
 #include "egl_utils.h"
+#include "alloc_check.h"
+#include "tex_alloc.h"
+#include "shader_utils.h"
+#include "shaders/shader_variants.h"
 
 #include "GLES2/gl2.h"
 #include "EGL/egl.h"
@@ -13,81 +22,345 @@
 
 #include "bcm_host.h"
 
+const GLchar* overlay_vertex_source =
+    "attribute vec2 position;"
+    "void main() {"
+    "   gl_Position = vec4(position, 0.0, 1.0);"
+    "}";
+
+const GLchar* overlay_fragment_source =
+    "precision mediump float;"
+    "uniform vec4 color;"
+    "void main() {"
+    "   gl_FragColor = color;"
+    "}";
+
+// Monotonic time in seconds
+double get_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
 void create_textures(STATE_T *state)
 {
-    int i,j;
+    // Spectrogram rows hold one byte per FFT bin
+    state->tex_width = state->spectrogram ? SPECTROGRAM_FFT_SIZE/2 : PANE_WIDTH;
+    state->tex_height = PANE_HEIGHT;
+
+    // Packed mode stores four 8-bit pixels in each RGBA8 texel
+    if(state->packed) {
+        assert(state->tex_width % 4 == 0);
+        state->tex_format = GL_RGBA;
+        state->texel_width = state->tex_width/4;
+    }
+    else {
+        state->tex_format = GL_LUMINANCE;
+        state->texel_width = state->tex_width;
+    }
 
-    state->tex_width = 800;
-    state->tex_height = 1080;
+    // Panes come back from the snapshot when it holds them, otherwise the
+    // snapshot or a temporary at the top of the row arena is the staging
+    double start = get_time();
+    int restored = 0;
+    size_t arena_mark = row_arena_mark(&state->arena);
+    GLubyte *pixels;
+    if(state->snapshot_path) {
+        restored = snapshot_open(&state->snapshot, state->snapshot_path, NUM_TEXTURES, state->tex_width, state->tex_height);
+        pixels = snapshot_rows(&state->snapshot, 0, 0);
+    }
+    else
+        pixels = row_arena_alloc(&state->arena, state->tex_width*state->tex_height*sizeof(GLubyte));
 
     // First image
-    GLubyte *pixels = malloc(state->tex_width*state->tex_height*sizeof(GLubyte));
-    for(i=0; i<state->tex_height; i++) {
-        for(j=0; j<state->tex_width; j++) {
-            pixels[i*state->tex_width + j] = 0;
-        }
-    }
-      
+    if(!restored)
+        memset(pixels, 0, state->tex_width*state->tex_height*sizeof(GLubyte));
+
     // Pixel packing
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    // Generate texture
-    glGenTextures(NUM_TEXTURES, state->textures);
-
-    // Set texture unit 0 and bind texture
+    // Set texture unit 0, generate and load texture
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, state->textures[0]);
-
-    // Load texture
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, state->tex_width, state->tex_height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, pixels);
-
-    // Free pixels
-    free(pixels);
+    state->textures[0] = tex_alloc_create_required("pane 0", state->tex_format, state->texel_width, state->tex_height, pixels);
+    if(!state->textures[0]) {
+        printf("Out of GPU memory for pane 0\n");
+        exit(1);
+    }
+    if(state->row_hash) {
+        row_hash_init(&state->row_hashes[0], state->tex_height, pixels, state->tex_width);
+        if(restored)
+            row_hash_invalidate(&state->row_hashes[0], 0, state->tex_height);
+    }
 
     // Set filtering modes
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-    // Second image
-    GLubyte *pixels2 = malloc(state->tex_width*state->tex_height*sizeof(GLubyte));
-    for(i=0; i<state->tex_height; i++) {
-        for(j=0; j<state->tex_width; j++) {
-            pixels2[i*state->tex_width + j] = 255;
-        }
-    }
- 
-    // Set texture unit 1 and bind texture
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, state->textures[1]);
+    // Second image, reusing the staging buffer
+    if(state->snapshot_path)
+        pixels = snapshot_rows(&state->snapshot, 1, 0);
+    if(!restored)
+        memset(pixels, 255, state->tex_width*state->tex_height*sizeof(GLubyte));
 
-    // Load texture
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, state->tex_width, state->tex_height, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, pixels2);
+    // Set texture unit 1, generate and load texture
+    glActiveTexture(GL_TEXTURE1);
+    state->textures[1] = tex_alloc_create_required("pane 1", state->tex_format, state->texel_width, state->tex_height, pixels);
+    if(!state->textures[1]) {
+        printf("Out of GPU memory for pane 1\n");
+        exit(1);
+    }
+    if(state->row_hash) {
+        row_hash_init(&state->row_hashes[1], state->tex_height, pixels, state->tex_width);
+        if(restored)
+            row_hash_invalidate(&state->row_hashes[1], 0, state->tex_height);
+    }
 
-    // Free pixels
-    free(pixels2);
+    // Release the staging buffer
+    row_arena_release(&state->arena, arena_mark);
 
     // Set filtering modes
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
+    // Setup row upload ring
+    upload_ring_init(&state->upload, state->egl_state.gles_version, state->tex_format, state->texel_width, UPLOAD_MAX_ROWS);
+
+    if(restored) {
+        // Waterfall heads carry on where they were
+        state->spectrum_row = snapshot_head(&state->snapshot, 0);
+        state->shm_row = snapshot_head(&state->snapshot, 1);
+        printf("Panes restored from snapshot in %.1f ms\n", (get_time() - start)*1e3);
+    }
+    else if(state->snapshot_path) {
+        // Initial images go out with the first commit
+        snapshot_mark(&state->snapshot, 0, 0, state->tex_height);
+        snapshot_mark(&state->snapshot, 1, 0, state->tex_height);
+    }
+}
+
+// Horizontal extent of each pane in normalised device coordinates, as laid out by create_vertices()
+static const GLfloat pane_x[NUM_TEXTURES][2] = { {-1.0f, -0.005f}, {0.005f, 1.0f} };
+
+// Marks a rectangle given in normalised device coordinates for repainting,
+// rounded out by a pixel to cover filtering at the edges
+void damage_ndc(STATE_T *state, GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1)
+{
+    GLfloat width = state->egl_state.screen_width;
+    GLfloat height = state->egl_state.screen_height;
+    EGLint left = (EGLint)floorf((x0 + 1.0f)*0.5f*width) - 1;
+    EGLint bottom = (EGLint)floorf((y0 + 1.0f)*0.5f*height) - 1;
+    EGLint right = (EGLint)ceilf((x1 + 1.0f)*0.5f*width) + 1;
+    EGLint top = (EGLint)ceilf((y1 + 1.0f)*0.5f*height) + 1;
+
+    egl_damage_add(&state->egl_state, left, bottom, right - left, top - bottom);
 }
 
-void update_texture_row(STATE_T *state, GLuint texture, GLenum tex_unit, GLsizei row, GLubyte *row_pixels)
+// Marks the screen area showing rows of the pane on tex_unit, row 0 is at the top
+void damage_texture_rows(STATE_T *state, GLenum tex_unit, GLsizei row, GLsizei rows)
 {
-    glActiveTexture(tex_unit);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, state->tex_width, 1, GL_LUMINANCE, GL_UNSIGNED_BYTE, row_pixels);
+    int pane = tex_unit - GL_TEXTURE0;
+
+    // Changed rows also need their contrast range reduced again
+    if(state->auto_level)
+        auto_level_mark(&state->levels[pane], row, rows);
+
+    GLfloat top = 1.0f - 2.0f*row/state->tex_height;
+    GLfloat bottom = 1.0f - 2.0f*(row + rows)/state->tex_height;
+
+    damage_ndc(state, pane_x[pane][0], bottom, pane_x[pane][1], top);
 }
 
-void update_texture_rows(STATE_T *state, GLuint texture, GLenum tex_unit, GLsizei row, GLubyte *row_pixels)
+// ingest_ns is when the row arrived, as from latency_now()
+void update_texture_row(STATE_T *state, GLuint texture, GLenum tex_unit, GLsizei row, GLubyte *row_pixels, uint64_t ingest_ns)
 {
+    // Skip rows identical to what the texture already holds
+    if(state->row_hash && !row_hash_update(&state->row_hashes[tex_unit - GL_TEXTURE0], row, row_pixels, state->tex_width))
+        return;
+
     glActiveTexture(tex_unit);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, state->tex_width, 10, GL_LUMINANCE, GL_UNSIGNED_BYTE, row_pixels);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, state->texel_width, 1, state->tex_format, GL_UNSIGNED_BYTE, row_pixels);
+    damage_texture_rows(state, tex_unit, row, 1);
+    if(state->telemetry)
+        latency_upload(&state->latency, ingest_ns, 1);
+    if(state->snapshot_path)
+        snapshot_store_rows(&state->snapshot, tex_unit - GL_TEXTURE0, row, 1, row_pixels);
+}
+
+// Keeps the snapshot copy of rows that sit pitch bytes apart
+static void store_snapshot_rows(STATE_T *state, GLenum tex_unit, GLsizei row, GLsizei rows, const GLubyte *pixels, GLsizei pitch)
+{
+    GLsizei i;
+
+    if(pitch == state->tex_width) {
+        snapshot_store_rows(&state->snapshot, tex_unit - GL_TEXTURE0, row, rows, pixels);
+        return;
+    }
+    for(i=0; i<rows; i++)
+        snapshot_store_rows(&state->snapshot, tex_unit - GL_TEXTURE0, row + i, 1, &pixels[i*pitch]);
+}
+
+// Uploads a block of rows pitch bytes apart, pixels is the first byte of the first row
+static void upload_texture_rows(STATE_T *state, GLenum tex_unit, GLsizei row, GLsizei rows, const GLubyte *pixels,
+                                GLsizei pitch, uint64_t ingest_ns)
+{
+    GLsizei i, first = 0;
+
+    if(!state->row_hash) {
+        upload_ring_submit_strided(&state->upload, tex_unit, row, rows, pixels, pitch);
+        damage_texture_rows(state, tex_unit, row, rows);
+        if(state->telemetry)
+            latency_upload(&state->latency, ingest_ns, rows);
+        if(state->snapshot_path)
+            store_snapshot_rows(state, tex_unit, row, rows, pixels, pitch);
+        return;
+    }
+
+    // Upload each run of changed rows as one block
+    ROW_HASH_T *hashes = &state->row_hashes[tex_unit - GL_TEXTURE0];
+    for(i=0; i<=rows; i++) {
+        if(i < rows && row_hash_update(hashes, row + i, &pixels[i*pitch], state->tex_width))
+            continue;
+        if(i > first) {
+            upload_ring_submit_strided(&state->upload, tex_unit, row + first, i - first, &pixels[first*pitch], pitch);
+            damage_texture_rows(state, tex_unit, row + first, i - first);
+            if(state->telemetry)
+                latency_upload(&state->latency, ingest_ns, i - first);
+            if(state->snapshot_path)
+                store_snapshot_rows(state, tex_unit, row + first, i - first, &pixels[first*pitch], pitch);
+        }
+        first = i + 1;
+    }
+}
+
+// Uploads a block of contiguous rows from client memory, ingest_ns is when the oldest arrived
+void update_texture_rows(STATE_T *state, GLenum tex_unit, GLsizei row, GLsizei rows, const GLubyte *pixels, uint64_t ingest_ns)
+{
+    upload_texture_rows(state, tex_unit, row, rows, pixels, state->tex_width, ingest_ns);
+}
+
+// Uploads rows out of a larger producer frame without repacking them. The
+// tex_width bytes wide sub-rectangle starts x bytes into row y of the frame
+// at base, whose rows are pitch bytes apart.
+void update_texture_rect(STATE_T *state, GLenum tex_unit, GLsizei row, GLsizei rows, const GLubyte *base,
+                         GLsizei pitch, GLsizei x, GLsizei y, uint64_t ingest_ns)
+{
+    assert(x + state->tex_width <= pitch);
+    upload_texture_rows(state, tex_unit, row, rows, base + (size_t)y*pitch + x, pitch, ingest_ns);
+}
+
+// Feeds the latest pane 1 row to the trace overlay, which is redrawn whole
+void update_trace(STATE_T *state, GLsizei row, const GLubyte *row_pixels)
+{
+    trace_overlay_update(&state->trace, row, row_pixels);
+    damage_ndc(state, state->trace.rect[0], state->trace.rect[1], state->trace.rect[2], state->trace.rect[3]);
+}
+
+// Returns memory for the caller to write rows of the pane on tex_unit into,
+// mapped PBO memory on GLES3. With a snapshot the rows are written straight
+// into it and copied out on submit, mapped PBO memory is too slow to read.
+GLubyte *map_texture_rows(STATE_T *state, GLenum tex_unit, GLsizei row, GLsizei rows)
+{
+    if(state->snapshot_path) {
+        assert(row + rows <= state->tex_height);
+        return snapshot_rows(&state->snapshot, tex_unit - GL_TEXTURE0, row);
+    }
+    return upload_ring_map(&state->upload, rows);
+}
+
+// Uploads the rows written since map_texture_rows() to the texture on tex_unit
+void submit_texture_rows(STATE_T *state, GLenum tex_unit, GLsizei row, GLsizei rows, uint64_t ingest_ns)
+{
+    // Mapped rows are not read back for hashing
+    if(state->row_hash)
+        row_hash_invalidate(&state->row_hashes[tex_unit - GL_TEXTURE0], row, rows);
+
+    if(state->snapshot_path) {
+        GLubyte *mapped = upload_ring_map(&state->upload, rows);
+        memcpy(mapped, snapshot_rows(&state->snapshot, tex_unit - GL_TEXTURE0, row), rows*state->tex_width*sizeof(GLubyte));
+        snapshot_mark(&state->snapshot, tex_unit - GL_TEXTURE0, row, rows);
+    }
+
+    upload_ring_submit(&state->upload, tex_unit, row, rows);
+    damage_texture_rows(state, tex_unit, row, rows);
+    if(state->telemetry)
+        latency_upload(&state->latency, ingest_ns, rows);
+}
+
+// Writes the spectra of every UPLOAD_MAX_ROWS block of samples the reader
+// thread has collected into the next rows of pane 0. Never waits on the
+// source, returns 0 once the input has ended and every block is drawn.
+int update_spectrogram(STATE_T *state)
+{
+    const int16_t *samples;
+    uint64_t ingest_ns;
+    int blocks = 0;
+
+    // Bounded by the ring so a fast source can not hold up the frame
+    while(blocks < SAMPLE_READER_BLOCKS && (samples = sample_reader_acquire(&state->samples, &ingest_ns))) {
+        GLubyte *rows = map_texture_rows(state, GL_TEXTURE0, state->spectrum_row, UPLOAD_MAX_ROWS);
+        spectrogram_process(&state->spec, samples, rows, UPLOAD_MAX_ROWS, state->tex_width);
+        submit_texture_rows(state, GL_TEXTURE0, state->spectrum_row, UPLOAD_MAX_ROWS, ingest_ns);
+        sample_reader_release(&state->samples);
+        blocks++;
+
+        // Waterfall head wraps around the pane
+        state->spectrum_row = (state->spectrum_row + UPLOAD_MAX_ROWS) % state->tex_height;
+        if(state->snapshot_path)
+            snapshot_set_head(&state->snapshot, 0, state->spectrum_row);
+    }
+
+    return blocks || !sample_reader_finished(&state->samples);
+}
+
+// Uploads rows published by an external producer into pane 1 straight from
+// the shared pages, returns the number of rows consumed
+GLsizei update_shared_rows(STATE_T *state)
+{
+    GLsizei total = 0;
+    uint32_t rows;
+    uint64_t seq;
+    GLubyte *pixels;
+
+    while(total < SHM_MAX_ROWS_PER_FRAME
+          && (pixels = shm_ring_acquire(&state->shm, SHM_MAX_ROWS_PER_FRAME - total, &rows, &seq))) {
+        // Keep the block inside the pane, the waterfall head wraps at the bottom
+        if(rows > (uint32_t)(state->tex_height - state->shm_row))
+            rows = state->tex_height - state->shm_row;
+
+        // Both calls have copied the rows by the time they return
+        update_texture_rect(state, GL_TEXTURE1, state->shm_row, rows, pixels, state->shm_pitch, state->shm_offset, 0,
+                            shm_ring_stamp(&state->shm, seq));
+        update_trace(state, state->shm_row + rows - 1, pixels + (rows - 1)*state->shm_pitch + state->shm_offset);
+        shm_ring_release(&state->shm, rows);
+
+        state->shm_row = (state->shm_row + rows) % state->tex_height;
+        if(state->snapshot_path)
+            snapshot_set_head(&state->snapshot, 1, state->shm_row);
+        state->shm_rows += rows;
+        total += rows;
+    }
+
+    return total;
+}
+
+// Quantises a float position/tex coord quad into mesh vertices
+static void quad_vertices(MESH_VERTEX_T *vertices, const float *quad)
+{
+    int i;
+
+    for(i=0; i<4; i++) {
+        vertices[i].position[0] = mesh_quantise(quad[i*4 + 0]);
+        vertices[i].position[1] = mesh_quantise(quad[i*4 + 1]);
+        vertices[i].tex_coord[0] = mesh_quantise(quad[i*4 + 2]);
+        vertices[i].tex_coord[1] = mesh_quantise(quad[i*4 + 3]);
+    }
 }
 
-void create_vertices()
+void create_vertices(STATE_T *state)
 {
     // Vertices: Pos(x,y) Tex(x,y)
-    float vertices[] = {
+    float quads[] = {
         // Image 0 vertices
         -1.0f,   1.0f, 0.0f, 0.0f, // Top left
         -0.005f, 1.0f, 1.0f, 0.0f, // Top right
@@ -99,70 +372,77 @@ void create_vertices()
          1.0f,  -1.0f, 1.0f, 1.0f, // Bottom right
 	 0.005f,-1.0f, 0.0f, 1.0f  // Bottom left
     };
+    MESH_VERTEX_T vertices[NUM_TEXTURES*4];
+    GLuint elements[NUM_TEXTURES*6];
+    int i;
+
+    // Elements, two triangles per image
+    for(i=0; i<NUM_TEXTURES; i++) {
+        quad_vertices(&vertices[i*4], &quads[i*16]);
+        elements[i*6 + 0] = i*4 + 2;
+        elements[i*6 + 1] = i*4 + 3;
+        elements[i*6 + 2] = i*4 + 0;
+        elements[i*6 + 3] = i*4 + 0;
+        elements[i*6 + 4] = i*4 + 1;
+        elements[i*6 + 5] = i*4 + 2;
+    }
 
-    // Generate vertex buffer
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    // Set buffer
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    // Fill buffer
-    glBufferData(GL_ARRAY_BUFFER, NUM_TEXTURES*4*4*sizeof(GLfloat), vertices, GL_STATIC_DRAW);
-
-    // Elements
-    GLubyte elements[] = {
-        2, 3, 0,
-        0, 1, 2
-    };
-    // Generate element buffer
-    GLuint ebo;
-    glGenBuffers(1, &ebo);
-    // Set buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    // Fill buffer
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 2*3*sizeof(GLubyte), elements, GL_STATIC_DRAW);
+    // Fill vertex and element buffers
+    mesh_create(&state->mesh, vertices, NUM_TEXTURES*4, elements, NUM_TEXTURES*6);
+}
 
+// Builds a 256x1 black-red-yellow-white heat colormap on SHADER_COLORMAP_UNIT
+void create_colormap(STATE_T *state)
+{
+    int i;
+    GLubyte colors[256*3];
+
+    for(i=0; i<256; i++) {
+        int level = i*3;
+        colors[i*3 + 0] = level > 255 ? 255 : level;
+        colors[i*3 + 1] = level > 510 ? 255 : level > 255 ? level - 255 : 0;
+        colors[i*3 + 2] = level > 510 ? level - 510 : 0;
+    }
+
+    glActiveTexture(GL_TEXTURE0 + SHADER_COLORMAP_UNIT);
+    state->colormap_texture = tex_alloc_create_required("colormap", GL_RGB, 256, 1, colors);
+    if(!state->colormap_texture) {
+        printf("Out of GPU memory for the colormap\n");
+        exit(1);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 }
 
+// Builds the shader variants for both colormap settings, the colormap key then only swaps handles
 void create_shaders(STATE_T *state)
 {
-    // Shader source
-    const GLchar* vertexSource =
-        "attribute vec2 position;"
-        "attribute vec2 tex_coord;"
-        "varying vec2 frag_tex_coord;"
-        "void main() {"
-        "   gl_Position = vec4(position, 0.0, 1.0);"
-        "   frag_tex_coord = tex_coord;"
-        "}";
-    const GLchar* fragmentSource =
-        "precision mediump float;"
-        "varying vec2 frag_tex_coord;"
-        "uniform sampler2D tex;"
-        "void main() {"
-        "   gl_FragColor = texture2D(tex, frag_tex_coord);"
-        "}";
-
-    // Compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, NULL);
-    glCompileShader(vertexShader);
-
-    showlog(vertexShader);   
-
-    // Compile frag shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-    glCompileShader(fragmentShader);
-
-    showlog(fragmentShader);
-
-    // Create shader program
-    state->program = glCreateProgram();
-    glAttachShader(state->program, vertexShader);
-    glAttachShader(state->program, fragmentShader);
-   
-    // Link and use program
-    glLinkProgram(state->program);
+    SHADER_FORMAT_T format = state->packed ? SHADER_FORMAT_LUMINANCE_PACKED : SHADER_FORMAT_LUMINANCE;
+    int colormap;
+    for(colormap = 0; colormap < SHADER_COLORMAP_COUNT; colormap++) {
+        state->programs[colormap] = get_shader_variant(format, colormap, state->decimate);
+        glUseProgram(state->programs[colormap]);
+        // Texel size used by the decimating and packed variants
+        glUniform2f(glGetUniformLocation(state->programs[colormap], "texel_step"), 1.0f/state->texel_width, 1.0f/state->tex_height);
+
+        // Video pane converts YUV planes, the video is scaled to the pane rather than decimated
+        if(state->video.width) {
+            state->video_programs[colormap] = get_shader_variant(video_input_shader_format(&state->video), colormap, SHADER_DECIMATE_NONE);
+            glUseProgram(state->video_programs[colormap]);
+            glUniform2f(glGetUniformLocation(state->video_programs[colormap], "texel_step"), 1.0f/state->video.width, 1.0f/state->video.height);
+        }
+    }
+    check();
+
+    select_shaders(state);
+}
+
+// Selects the prebuilt variants matching the current colormap setting
+void select_shaders(STATE_T *state)
+{
+    state->program = state->programs[state->colormap];
     glUseProgram(state->program);
     check();
 
@@ -172,6 +452,27 @@ void create_shaders(STATE_T *state)
     state->tex_coord_location = glGetAttribLocation(state->program, "tex_coord");
     // Get tex uniform location
     state->tex_location = glGetUniformLocation(state->program, "tex");
+    // Get window uniform location, set per pane when auto levelling
+    state->window_location = glGetUniformLocation(state->program, "window");
+
+    if(state->video.width) {
+        state->video_program = state->video_programs[state->colormap];
+        state->video_position_location = glGetAttribLocation(state->video_program, "position");
+        state->video_tex_coord_location = glGetAttribLocation(state->video_program, "tex_coord");
+        state->video_tex_location = glGetUniformLocation(state->video_program, "tex");
+        state->video_window_location = glGetUniformLocation(state->video_program, "window");
+    }
+}
+
+// Maps the overlay scene into GPU buffers, drawn blended over both panes
+void create_overlay(STATE_T *state)
+{
+    if(!scene_load(&state->overlay, state->overlay_path))
+        exit(1);
+
+    state->overlay_program = load_program(overlay_vertex_source, overlay_fragment_source);
+    state->overlay_position_location = glGetAttribLocation(state->overlay_program, "position");
+    state->overlay_color_location = glGetUniformLocation(state->overlay_program, "color");
 }
 
 void draw_textures(STATE_T *state)
@@ -179,24 +480,123 @@ void draw_textures(STATE_T *state)
     glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    // Size of each vertex in bytes
-    size_t vert_size = 4*sizeof(GL_FLOAT);
+    // Overlays switch programs, so select ours every frame
+    glUseProgram(state->program);
+
+    // Bind vertex and element buffers
+    mesh_bind(&state->mesh, state->position_location, state->tex_coord_location);
 
     // Draw image 0
-    glVertexAttribPointer(state->position_location, 2, GL_FLOAT, GL_FALSE, vert_size, 0);
-    glEnableVertexAttribArray(state->position_location);
-    glVertexAttribPointer(state->tex_coord_location, 2, GL_FLOAT, GL_FALSE, vert_size,(void*)(2*sizeof(GL_FLOAT)));
-    glEnableVertexAttribArray(state->tex_coord_location);
-    glUniform1i(state->tex_location, 0);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, 0);
+    if(state->video.width) {
+        // Video frame, the planes are bound by video_input_present()
+        glUseProgram(state->video_program);
+        mesh_bind(&state->mesh, state->video_position_location, state->video_tex_coord_location);
+        glUniform1i(state->video_tex_location, 0);
+        if(state->auto_level)
+            glUniform2fv(state->video_window_location, 1, state->levels[0].window);
+        mesh_draw(&state->mesh, GL_TRIANGLES, 0, 6);
+        video_input_touch(&state->video);
+
+        glUseProgram(state->program);
+        mesh_bind(&state->mesh, state->position_location, state->tex_coord_location);
+    }
+    else {
+        glUniform1i(state->tex_location, 0);
+        if(state->auto_level)
+            glUniform2fv(state->window_location, 1, state->levels[0].window);
+        mesh_draw(&state->mesh, GL_TRIANGLES, 0, 6);
+        tex_alloc_touch(state->textures[0]);
+    }
 
     // Draw image 1
-    glVertexAttribPointer(state->position_location, 2, GL_FLOAT, GL_FALSE, vert_size, (void*)(4*vert_size));
-    glEnableVertexAttribArray(state->position_location);
-    glVertexAttribPointer(state->tex_coord_location, 2, GL_FLOAT, GL_FALSE, vert_size,(void*)(4*vert_size+2*sizeof(GL_FLOAT)));
-    glEnableVertexAttribArray(state->tex_coord_location);
     glUniform1i(state->tex_location, 1);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, 0);
+    if(state->auto_level)
+        glUniform2fv(state->window_location, 1, state->levels[1].window);
+    mesh_draw(&state->mesh, GL_TRIANGLES, 6, 6);
+    tex_alloc_touch(state->textures[1]);
+    if(state->colormap)
+        tex_alloc_touch(state->colormap_texture);
+
+    // Latest row of image 1 as a trace along the bottom of its pane
+    trace_overlay_draw(&state->trace, 1);
+
+    // Static outlines, every repaint covers whatever of them it overlaps
+    if(state->overlay_path) {
+        glUseProgram(state->overlay_program);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        scene_draw(&state->overlay, state->overlay_position_location, -1, state->overlay_color_location);
+        glDisable(GL_BLEND);
+        glDisableVertexAttribArray(state->overlay_position_location);
+    }
+
+    // Labels and readouts, one draw for all strings
+    text_overlay_draw(&state->text);
+}
+
+// Reduces changed rows of both panes on the GPU, a pane whose range moved is redrawn whole
+void update_auto_level(STATE_T *state)
+{
+    int pane;
+
+    for(pane=0; pane<NUM_TEXTURES; pane++) {
+        if(auto_level_update(&state->levels[pane]))
+            damage_ndc(state, pane_x[pane][0], -1.0f, pane_x[pane][1], 1.0f);
+    }
+}
+
+// Uploads the next Y4M frame once it is due, looping at the end of the file.
+// The frame is drawn from the next video_input_present().
+void update_video(STATE_T *state)
+{
+    double now = get_time();
+    double period = (double)state->y4m.rate_den/state->y4m.rate_num;
+
+    if(now < state->video_next)
+        return;
+
+    // Fell behind by more than a frame, drop the backlog rather than race through it
+    state->video_next = now - state->video_next > period ? now + period : state->video_next + period;
+
+    uint8_t *frame = y4m_read_frame(&state->y4m);
+    if(!frame) {
+        y4m_rewind(&state->y4m);
+        frame = y4m_read_frame(&state->y4m);
+        if(!frame)
+            return;
+    }
+    uint64_t ingest_ns = latency_now();
+    video_input_upload(&state->video, frame);
+    if(state->telemetry)
+        latency_upload(&state->latency, ingest_ns, state->video.height);
+}
+
+// Sets the pane labels and readouts, strings that did not change are not rebuilt
+void update_text(STATE_T *state, int row, double fps)
+{
+    GLfloat half_width = state->egl_state.screen_width/2.0f;
+
+    text_overlay_set(&state->text, 0, 8.0f, 8.0f, 2.0f, "Pane 0");
+    text_overlay_set(&state->text, 1, half_width + 8.0f, 8.0f, 2.0f, "Pane 1");
+    text_overlay_set(&state->text, 2, 8.0f, 32.0f, 2.0f, "%.1f fps", fps);
+    text_overlay_set(&state->text, 3, half_width + 8.0f, 32.0f, 2.0f, "Row %d", row);
+
+    // FFT stage throughput while busy
+    if(state->spectrogram && state->spec.stats.seconds > 0.0)
+        text_overlay_set(&state->text, 4, 8.0f, 56.0f, 2.0f, "%.2f Msps",
+                         state->spec.stats.samples/state->spec.stats.seconds*1e-6);
+
+    // Current offscreen render scale
+    if(state->frame_budget_ms > 0.0)
+        text_overlay_set(&state->text, 5, half_width + 8.0f, 56.0f, 2.0f, "Scale %d%%", (int)(state->target.scale*100.0f + 0.5f));
+
+    // Repaint where strings changed, text rectangles are from the top left
+    GLfloat rect[4];
+    if(text_overlay_take_damage(&state->text, rect)) {
+        EGLint top = (EGLint)floorf(rect[1]), bottom = (EGLint)ceilf(rect[3]);
+        EGLint left = (EGLint)floorf(rect[0]), right = (EGLint)ceilf(rect[2]);
+        egl_damage_add(&state->egl_state, left, state->egl_state.screen_height - bottom, right - left, bottom - top);
+    }
 }
 
 int main(int argc, char *argv[])
@@ -204,29 +604,178 @@ int main(int argc, char *argv[])
     // Setup initial state
     STATE_T state;
     memset(&state, 0, sizeof(STATE_T));
+    state.capture_format = CAPTURE_FORMAT_PNG;
+    state.swap_interval = 1;
+    state.pace_margin_ms = -1.0;
+
+    // Upload 8-bit rows packed into RGBA8 texels, or compute pane 0 from raw samples
+    int i;
+    for(i=1; i<argc; i++) {
+        if(strcmp(argv[i], "--packed") == 0)
+            state.packed = 1;
+        else if(strcmp(argv[i], "--spectrogram") == 0)
+            state.spectrogram = 1;
+        else if(strcmp(argv[i], "--shm") == 0)
+            state.shared = 1;
+        else if(strcmp(argv[i], "--shm-pitch") == 0 && i+1 < argc)
+            state.shm_pitch = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--shm-offset") == 0 && i+1 < argc)
+            state.shm_offset = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--row-hash") == 0)
+            state.row_hash = 1;
+        else if(strcmp(argv[i], "--y4m") == 0 && i+1 < argc)
+            state.video_path = argv[++i];
+        else if(strcmp(argv[i], "--nv12") == 0)
+            state.video_nv12 = 1;
+        else if(strcmp(argv[i], "--snapshot") == 0 && i+1 < argc)
+            state.snapshot_path = argv[++i];
+        else if(strcmp(argv[i], "--overlay") == 0 && i+1 < argc)
+            state.overlay_path = argv[++i];
+        else if(strcmp(argv[i], "--latency") == 0)
+            state.telemetry = 1;
+        else if(strcmp(argv[i], "--auto-level") == 0)
+            state.auto_level = 1;
+        else if(strcmp(argv[i], "--swap-interval") == 0 && i+1 < argc)
+            state.swap_interval = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--pace") == 0 && i+1 < argc)
+            state.pace_margin_ms = atof(argv[++i]);
+        else if(strcmp(argv[i], "--skip-late") == 0)
+            state.skip_late = 1;
+        else if(strcmp(argv[i], "--texture-budget") == 0 && i+1 < argc)
+            state.texture_budget = (size_t)(atof(argv[++i])*1024.0*1024.0);
+        else if(strcmp(argv[i], "--adaptive") == 0 && i+1 < argc)
+            state.frame_budget_ms = atof(argv[++i]);
+        else if(strcmp(argv[i], "--capture") == 0 && i+1 < argc)
+            state.capture_interval = strtoul(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--decimate") == 0 && i+1 < argc) {
+            // Columns folded into each screen pixel when the pane is narrower than the texture
+            i++;
+            if(strcmp(argv[i], "max") == 0)
+                state.decimate = SHADER_DECIMATE_MAX4;
+            else if(strcmp(argv[i], "mean") == 0)
+                state.decimate = SHADER_DECIMATE_MEAN4;
+            else
+                state.decimate = SHADER_DECIMATE_NONE;
+        }
+        else if(strcmp(argv[i], "--capture-format") == 0 && i+1 < argc) {
+            i++;
+            if(strcmp(argv[i], "raw") == 0)
+                state.capture_format = CAPTURE_FORMAT_RAW;
+            else if(strcmp(argv[i], "ppm") == 0)
+                state.capture_format = CAPTURE_FORMAT_PPM;
+            else
+                state.capture_format = CAPTURE_FORMAT_PNG;
+        }
+    }
+
+    // Row and staging buffers for the whole run, nothing is allocated per frame
+    row_arena_init(&state.arena, ROW_ARENA_BYTES);
 
     bcm_host_init();
       
     // Start OGLES
     init_ogl(&state.egl_state);
 
+    // Only redraw the parts of the screen that changed, when the surface
+    // allows it. Captures read back the whole frame so need all of it defined.
+    egl_enable_damage(&state.egl_state, state.capture_interval != 0);
+
+    // Start frames as late as the vsync allows so they show the newest rows
+    egl_set_swap_interval(&state.egl_state, state.swap_interval);
+    if(state.pace_margin_ms >= 0.0)
+        egl_enable_pacing(&state.egl_state, state.pace_margin_ms, state.skip_late);
+
+    // Account for every texture from here on, optionally within a budget
+    tex_alloc_init(state.texture_budget);
+
     // Create and set textures
     create_textures(&state);
 
+    // Video frames replace pane 0, read as NV12 when asked to exercise that path
+    if(state.video_path) {
+        if(!y4m_open(&state.y4m, state.video_path, state.video_nv12))
+            exit(1);
+        if(!video_input_init(&state.video, state.egl_state.gles_version, state.video_nv12 ? VIDEO_FORMAT_NV12 : VIDEO_FORMAT_I420,
+                             state.y4m.width, state.y4m.height, GL_TEXTURE0)) {
+            printf("No texture memory for video, showing pane 0 instead\n");
+            y4m_close(&state.y4m);
+        }
+    }
+
     // Create and set vertices
-    create_vertices();
+    create_vertices(&state);
 
-    // Create and set shaders
+    // Create colormap and set shaders
+    create_colormap(&state);
     create_shaders(&state);
 
+    // Outlines and maps loaded straight from a mapped scene file
+    if(state.overlay_path)
+        create_overlay(&state);
+
+    // Create trace overlay, packed panes can not be sampled directly by the vertex shader
+    GLsizei pane_columns = (GLsizei)(state.egl_state.screen_width*(1.0f - 0.005f)/2.0f);
+    trace_overlay_init(&state.trace, state.tex_width, state.tex_height, pane_columns, !state.packed);
+    trace_overlay_set_rect(&state.trace, 0.005f, -1.0f, 1.0f, -0.5f);
+
+    // Create text overlay
+    text_overlay_init(&state.text, state.egl_state.screen_width, state.egl_state.screen_height);
+    double fps = 0.0;
+    int fps_frames = 0;
+    double fps_start = get_time();
+
+    // Create FFT stage and the thread reading its samples from stdin
+    if(state.spectrogram) {
+        spectrogram_init(&state.spec, SPECTROGRAM_FFT_SIZE, SPECTROGRAM_THREADS);
+        sample_reader_init(&state.samples, STDIN_FILENO, UPLOAD_MAX_ROWS*SPECTROGRAM_FFT_SIZE);
+    }
+
     //////////////////////////////
     // Testing only
     ////////////////////////////////
-    int i = 0;
-    GLubyte *row = malloc(state.tex_width*sizeof(GLubyte));
+    i = 0;
+    GLubyte *row = row_arena_alloc(&state.arena, state.tex_width*sizeof(GLubyte));
     memset(row, 0, state.tex_width*sizeof(GLubyte));
-    GLubyte *row2 = malloc(10*state.tex_width*sizeof(GLubyte));
-    memset(row2, 255, 10*state.tex_width*sizeof(GLubyte)); 
+
+    // Shared memory ring external producers write pane 1 rows into
+    if(state.shared) {
+        if(state.shm_pitch < state.shm_offset + state.tex_width)
+            state.shm_pitch = state.shm_offset + state.tex_width;
+        shm_ring_create(&state.shm, SHM_RING_NAME, state.shm_pitch, SHM_RING_ROWS);
+    }
+
+    // Offscreen rendering that drops resolution to hold the frame budget
+    if(state.frame_budget_ms > 0.0
+       && !render_target_init(&state.target, state.egl_state.screen_width, state.egl_state.screen_height, state.frame_budget_ms)) {
+        printf("No texture memory for the render target, drawing straight to the window\n");
+        state.frame_budget_ms = 0.0;
+    }
+
+    // Contrast stretch per pane, reduced on the GPU from the pane textures
+    if(state.auto_level) {
+        // Pane 0 levels follow the luma plane when it shows video
+        if(state.video.width)
+            auto_level_init(&state.levels[0], state.egl_state.gles_version, GL_TEXTURE0, state.video.width, state.video.height, 0,
+                            state.egl_state.screen_width, state.egl_state.screen_height);
+        else
+            auto_level_init(&state.levels[0], state.egl_state.gles_version, GL_TEXTURE0, state.texel_width, state.tex_height, state.packed,
+                            state.egl_state.screen_width, state.egl_state.screen_height);
+        auto_level_init(&state.levels[1], state.egl_state.gles_version, GL_TEXTURE1, state.texel_width, state.tex_height, state.packed,
+                        state.egl_state.screen_width, state.egl_state.screen_height);
+    }
+
+    // Periodic screenshots of what was on screen
+    if(state.capture_interval) {
+        capture_init(&state.capture, state.egl_state.gles_version, state.egl_state.screen_width,
+                     state.egl_state.screen_height, state.capture_interval, state.capture_format);
+    }
+
+    // Row latency published to a shared memory block for latency_monitor
+    if(state.telemetry)
+        latency_init(&state.latency, &state.egl_state);
+
+    // Steady state from here on, ALLOC_CHECK builds abort on any heap allocation
+    alloc_check_begin();
 
     // Event loop
     while(!state.terminate)
@@ -235,27 +784,171 @@ int main(int argc, char *argv[])
        // Testing only
        ///////////////////////
 	glFlush();
-       if(i < state.tex_height) {
-        // Testing row update
-        update_texture_row(&state, state.textures[1], GL_TEXTURE1, i, row);
-        update_texture_rows(&state, state.textures[0], GL_TEXTURE0, i*10, row2);
-        i++;
+
+        // Paced frames wait here for their start time, rows arriving meanwhile make it in
+        egl_frame_wait(&state.egl_state);
+
+        if(state.shm.header) {
+            // Rows from the external producer, sleep briefly while there are none
+            if(!update_shared_rows(&state))
+                shm_ring_wait(&state.shm, SHM_WAIT_MS);
+        }
+        else if(i < state.tex_height) {
+            // Testing row update
+            update_texture_row(&state, state.textures[1], GL_TEXTURE1, i, row, latency_now());
+            update_trace(&state, i, row);
         }
 
-	// Draw textures
-	draw_textures(&state);
+        if(state.video.width)
+            update_video(&state);
+        else if(state.spectrogram) {
+            // Stop feeding pane 0 once stdin runs dry
+            if(!update_spectrogram(&state))
+                state.spectrogram = 0;
+        }
+        else if(i*UPLOAD_MAX_ROWS < state.tex_height) {
+            GLubyte *rows = map_texture_rows(&state, GL_TEXTURE0, i*UPLOAD_MAX_ROWS, UPLOAD_MAX_ROWS);
+            memset(rows, 255, UPLOAD_MAX_ROWS*state.tex_width*sizeof(GLubyte));
+            submit_texture_rows(&state, GL_TEXTURE0, i*UPLOAD_MAX_ROWS, UPLOAD_MAX_ROWS, latency_now());
+        }
 
-        // Swap buffers
-        egl_swap(&state.egl_state);
+        if(i < state.tex_height)
+            i++;
+
+	// Frame rate readout, refreshed once a second
+	fps_frames++;
+	double now = get_time();
+	if(now - fps_start >= 1.0) {
+	    fps = fps_frames/(now - fps_start);
+	    fps_frames = 0;
+	    fps_start = now;
+	}
+	update_text(&state, state.shm.header ? state.shm_row : i, fps);
+
+	// Commit pane rows and heads now and then
+	if(state.snapshot_path)
+	    snapshot_update(&state.snapshot);
+
+	// Newest video frame, the whole pane changes
+	if(state.video.width && video_input_present(&state.video)) {
+	    damage_ndc(&state, pane_x[0][0], -1.0f, pane_x[0][1], 1.0f);
+	    if(state.auto_level)
+	        auto_level_mark(&state.levels[0], 0, state.video.height);
+	}
+
+	// Rows uploaded this frame feed the next contrast window
+	if(state.auto_level)
+	    update_auto_level(&state);
+
+	// A new render scale leaves nothing in the offscreen buffer worth keeping
+	if(state.frame_budget_ms > 0.0 && render_target_update(&state.target))
+	    egl_damage_all(&state.egl_state);
+
+	// Draw textures, once per damaged rectangle
+	EGL_REGION_T *repaint = egl_begin_frame(&state.egl_state);
+	int r;
+	if(state.frame_budget_ms > 0.0) {
+	    // Draw at the current scale, then upscale the same rectangles to the window
+	    render_target_begin(&state.target);
+	    for(r=0; r<repaint->count; r++) {
+	        render_target_scissor(&state.target, &repaint->rects[r]);
+	        draw_textures(&state);
+	    }
+	    render_target_end(&state.target);
+	    for(r=0; r<repaint->count; r++) {
+	        egl_scissor(&state.egl_state, &repaint->rects[r]);
+	        render_target_composite(&state.target);
+	    }
+	}
+	else {
+	    for(r=0; r<repaint->count; r++) {
+	        egl_scissor(&state.egl_state, &repaint->rects[r]);
+	        draw_textures(&state);
+	    }
+	}
+
+        // Read back the finished frame before it is presented, a skipped one is never seen
+        if(state.capture_interval && egl_frame_presents(&state.egl_state))
+            capture_frame(&state.capture);
+
+        // Swap buffers, timing the rows it puts on screen
+        if(state.telemetry)
+            latency_begin_swap(&state.latency);
+        int presented = egl_swap(&state.egl_state);
+        if(state.telemetry && presented)
+            latency_end_swap(&state.latency);
+        tex_alloc_next_frame();
 
         // Check for keyboard input
 	int key_press = get_key_press(&state.egl_state);	
 	if(key_press == KEY_Q)
 	    state.terminate=1;
+	else if(key_press == KEY_C) {
+	    // Toggle colormap
+	    state.colormap = !state.colormap;
+	    select_shaders(&state);
+	    egl_damage_all(&state.egl_state);
+	}
     }
-
+    alloc_check_end();
 
     // Tidy up
+    tex_alloc_print_stats();
+    if(state.spec.fft_size) {
+        spectrogram_print_stats(&state.spec);
+        spectrogram_destroy(&state.spec);
+        sample_reader_print_stats(&state.samples);
+        sample_reader_destroy(&state.samples);
+    }
+    upload_ring_print_stats(&state.upload);
+    if(state.shm.header) {
+        printf("Shared memory ring: %llu rows uploaded, %llu dropped by the producer\n",
+               state.shm_rows, (unsigned long long)state.shm.header->dropped);
+        shm_ring_destroy(&state.shm);
+    }
+    if(state.frame_budget_ms > 0.0) {
+        render_target_print_stats(&state.target);
+        render_target_destroy(&state.target);
+    }
+    if(state.snapshot_path) {
+        snapshot_print_stats(&state.snapshot);
+        snapshot_close(&state.snapshot);
+    }
+    if(state.video.width) {
+        video_input_print_stats(&state.video);
+        video_input_destroy(&state.video);
+        y4m_close(&state.y4m);
+    }
+    if(state.auto_level) {
+        auto_level_print_stats(&state.levels[0], "Pane 0");
+        auto_level_print_stats(&state.levels[1], "Pane 1");
+        auto_level_destroy(&state.levels[0]);
+        auto_level_destroy(&state.levels[1]);
+    }
+    if(state.overlay_path) {
+        scene_destroy(&state.overlay);
+        glDeleteProgram(state.overlay_program);
+    }
+    if(state.telemetry) {
+        latency_print_stats(&state.latency);
+        latency_destroy(&state.latency);
+    }
+    if(state.capture_interval) {
+        capture_print_stats(&state.capture);
+        capture_destroy(&state.capture);
+    }
+    if(state.row_hash) {
+        row_hash_print_stats(&state.row_hashes[0], "Pane 0");
+        row_hash_print_stats(&state.row_hashes[1], "Pane 1");
+        row_hash_destroy(&state.row_hashes[0]);
+        row_hash_destroy(&state.row_hashes[1]);
+    }
+    text_overlay_destroy(&state.text);
+    trace_overlay_destroy(&state.trace);
+    upload_ring_destroy(&state.upload);
+    row_arena_destroy(&state.arena);
+    egl_print_damage_stats(&state.egl_state);
+    egl_print_pacing_stats(&state.egl_state);
     exit_func(&state.egl_state);
 
     return 0;
@@ -3,21 +3,57 @@
 
 #include "GLES2/gl2.h"
 #include "egl_utils.h"
+#include "mesh.h"
+#include "upload_ring.h"
+#include "trace_overlay.h"
+#include "text_overlay.h"
+#include "spectrogram.h"
+#include "sample_reader.h"
+#include "row_arena.h"
+#include "shm_ring.h"
+#include "row_hash.h"
+#include "capture.h"
+#include "render_target.h"
+#include "auto_level.h"
+#include "y4m.h"
+#include "video_input.h"
+#include "snapshot.h"
+#include "latency.h"
+#include "scene.h"
+#include "shaders/shader_variants.h"
+#include "pane_layout.h"
 
 #define NUM_TEXTURES 2
 
+// Spectrogram FFT length, pane 0 is fft_size/2 bins wide in spectrogram mode
+#define SPECTROGRAM_FFT_SIZE 2048
+#define SPECTROGRAM_THREADS 4
+
+// Row arena size, the largest user is the temporary image staging in create_textures()
+#define ROW_ARENA_BYTES (2*1024*1024)
+
 typedef struct
 {
     // OpenGL|ES state
     EGL_STATE_T egl_state;
 
-    // Program handle
+    // Program handle, one per colormap setting so toggling never compiles
     GLuint program;
+    GLuint programs[SHADER_COLORMAP_COUNT];
 
     // Locations
     GLint position_location;
     GLint tex_coord_location;
     GLint tex_location;
+    GLint window_location;
+
+    // Shader variant selection, colormap toggled by the C key and decimation set by --decimate
+    SHADER_COLORMAP_T colormap;
+    SHADER_DECIMATE_T decimate;
+    GLuint colormap_texture;
+
+    // Pane quads
+    MESH_T mesh;
 
     // Texture handles
     GLuint textures[NUM_TEXTURES];
@@ -26,13 +62,118 @@ typedef struct
     GLsizei tex_width;
     GLsizei tex_height;
 
+    // GL texture layout, GL_RGBA texels a quarter as wide when packed
+    int packed;
+    GLenum tex_format;
+    GLsizei texel_width;
+
+    // Content hash per texture row, client memory uploads of unchanged rows are skipped
+    int row_hash;
+    ROW_HASH_T row_hashes[NUM_TEXTURES];
+
+    // Row uploads, PBO backed when GLES3 is available
+    UPLOAD_RING_T upload;
+
+    // Most recent row drawn as a line strip
+    TRACE_OVERLAY_T trace;
+
+    // Labels and live readouts
+    TEXT_OVERLAY_T text;
+
+    // Pane 0 fed by the FFT stage from raw samples on stdin, read on their own thread
+    int spectrogram;
+    SPECTROGRAM_T spec;
+    SAMPLE_READER_T samples;
+    GLsizei spectrum_row;
+
+    // Pane 0 showing a Y4M file through the YUV shader variants, with its own program
+    const char *video_path;
+    int video_nv12;
+    Y4M_READER_T y4m;
+    VIDEO_INPUT_T video;
+    double video_next;
+    GLuint video_program;
+    GLuint video_programs[SHADER_COLORMAP_COUNT];
+    GLint video_position_location;
+    GLint video_tex_coord_location;
+    GLint video_tex_location;
+    GLint video_window_location;
+
+    // Pane 1 fed by an external producer through shared memory
+    int shared;
+    SHM_RING_T shm;
+    GLsizei shm_row;
+    unsigned long long shm_rows;
+
+    // Slot layout of producers that write whole padded frames, the pane row
+    // is tex_width bytes at shm_offset into each shm_pitch byte slot
+    GLsizei shm_pitch;
+    GLsizei shm_offset;
+
+    // Per pane contrast stretch from a GPU min/max reduction over changed rows
+    int auto_level;
+    AUTO_LEVEL_T levels[NUM_TEXTURES];
+
+    // Vsyncs per swap, frames started late to make the vsync with margin_ms to spare,
+    // pace_margin_ms below 0 turns pacing off
+    EGLint swap_interval;
+    double pace_margin_ms;
+    int skip_late;
+
+    // Texture memory limit in bytes, 0 only accounts for it
+    size_t texture_budget;
+
+    // Offscreen rendering scaled to hold frame_budget_ms, 0 draws to the window directly
+    double frame_budget_ms;
+    RENDER_TARGET_T target;
+
+    // Static outlines from a scene file drawn over the panes, in flat colours
+    const char *overlay_path;
+    SCENE_T overlay;
+    GLuint overlay_program;
+    GLint overlay_position_location;
+    GLint overlay_color_location;
+
+    // Screenshots every capture_interval frames, 0 disables capture
+    unsigned long capture_interval;
+    CAPTURE_FORMAT_T capture_format;
+    CAPTURE_T capture;
+
+    // Pane pixels and heads mirrored to a file, restored on the next start
+    const char *snapshot_path;
+    SNAPSHOT_T snapshot;
+
+    // Ingest to display latency of pane rows, published for latency_monitor
+    int telemetry;
+    LATENCY_T latency;
+
+    // Row, sample and staging buffers, carved out before the main loop starts
+    ROW_ARENA_T arena;
+
     int terminate;
 } STATE_T;
 
 void create_textures(STATE_T *state);
-void create_vertices();
+void create_vertices(STATE_T *state);
+void create_colormap(STATE_T *state);
 void create_shaders(STATE_T *state);
+void select_shaders(STATE_T *state);
+void create_overlay(STATE_T *state);
 void draw_textures(STATE_T *state);
-void update_texture_row(STATE_T *state, GLuint texture, GLenum tex_unit, GLsizei row, GLubyte *row_pixels);
+void update_text(STATE_T *state, int row, double fps);
+double get_time();
+void update_texture_row(STATE_T *state, GLuint texture, GLenum tex_unit, GLsizei row, GLubyte *row_pixels, uint64_t ingest_ns);
+void update_texture_rows(STATE_T *state, GLenum tex_unit, GLsizei row, GLsizei rows, const GLubyte *pixels, uint64_t ingest_ns);
+void update_texture_rect(STATE_T *state, GLenum tex_unit, GLsizei row, GLsizei rows, const GLubyte *base,
+                         GLsizei pitch, GLsizei x, GLsizei y, uint64_t ingest_ns);
+GLubyte *map_texture_rows(STATE_T *state, GLenum tex_unit, GLsizei row, GLsizei rows);
+void submit_texture_rows(STATE_T *state, GLenum tex_unit, GLsizei row, GLsizei rows, uint64_t ingest_ns);
+void damage_ndc(STATE_T *state, GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1);
+void damage_texture_rows(STATE_T *state, GLenum tex_unit, GLsizei row, GLsizei rows);
+void update_trace(STATE_T *state, GLsizei row, const GLubyte *row_pixels);
+int update_spectrogram(STATE_T *state);
+GLsizei update_shared_rows(STATE_T *state);
+void update_auto_level(STATE_T *state);
+void update_video(STATE_T *state);
 
 #endif
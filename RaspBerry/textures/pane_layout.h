@@ -0,0 +1,20 @@
+#ifndef PANE_LAYOUT_H
+#define PANE_LAYOUT_H
+
+// Pane size and row ingest limits shared by multi_tex and fb_tex, so the
+// GPU and CPU renderers take the same producers and draw the same panes
+
+// Pane size in 8-bit pixels, spectrogram panes are narrower
+#define PANE_WIDTH 800
+#define PANE_HEIGHT 1080
+
+// Largest number of rows uploaded in one block
+#define UPLOAD_MAX_ROWS 10
+
+// Shared memory ring depth in rows, rows uploaded per frame at most, and how
+// long an idle frame sleeps waiting for the producer
+#define SHM_RING_ROWS 512
+#define SHM_MAX_ROWS_PER_FRAME 128
+#define SHM_WAIT_MS 5
+
+#endif
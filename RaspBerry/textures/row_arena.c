@@ -0,0 +1,52 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "row_arena.h"
+
+void row_arena_init(ROW_ARENA_T *arena, size_t size)
+{
+    memset(arena, 0, sizeof(ROW_ARENA_T));
+
+    // posix_memalign so the first allocation is aligned as well
+    int ret = posix_memalign((void**)&arena->base, ROW_ARENA_ALIGN, size);
+    assert(ret == 0);
+    arena->size = size;
+}
+
+// Bump allocation, running out means ROW_ARENA_BYTES needs raising
+void *row_arena_alloc(ROW_ARENA_T *arena, size_t size)
+{
+    size_t offset = (arena->used + ROW_ARENA_ALIGN - 1) & ~(size_t)(ROW_ARENA_ALIGN - 1);
+
+    if(offset + size > arena->size) {
+        printf("Row arena exhausted: %zu of %zu bytes used, %zu requested\n", arena->used, arena->size, size);
+        assert(0);
+    }
+
+    arena->used = offset + size;
+    if(arena->used > arena->peak)
+        arena->peak = arena->used;
+
+    return arena->base + offset;
+}
+
+// Marks the current top, temporaries allocated after it are dropped by row_arena_release()
+size_t row_arena_mark(ROW_ARENA_T *arena)
+{
+    return arena->used;
+}
+
+void row_arena_release(ROW_ARENA_T *arena, size_t mark)
+{
+    assert(mark <= arena->used);
+    arena->used = mark;
+}
+
+void row_arena_destroy(ROW_ARENA_T *arena)
+{
+    printf("Row arena: peak %zu of %zu bytes\n", arena->peak, arena->size);
+    free(arena->base);
+    memset(arena, 0, sizeof(ROW_ARENA_T));
+}
@@ -0,0 +1,24 @@
+#ifndef ROW_ARENA_H
+#define ROW_ARENA_H
+
+#include <stddef.h>
+
+// Every allocation starts on a 16 byte boundary, enough for NEON loads
+#define ROW_ARENA_ALIGN 16
+
+// One block allocated up front, carved into row and staging buffers
+typedef struct
+{
+    unsigned char *base;
+    size_t size;
+    size_t used;
+    size_t peak;
+} ROW_ARENA_T;
+
+void row_arena_init(ROW_ARENA_T *arena, size_t size);
+void *row_arena_alloc(ROW_ARENA_T *arena, size_t size);
+size_t row_arena_mark(ROW_ARENA_T *arena);
+void row_arena_release(ROW_ARENA_T *arena, size_t mark);
+void row_arena_destroy(ROW_ARENA_T *arena);
+
+#endif
@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "row_hash.h"
+
+// xxHash32 primes
+#define PRIME1 2654435761u
+#define PRIME2 2246822519u
+#define PRIME3 3266489917u
+#define PRIME4 668265263u
+#define PRIME5 374761393u
+
+// Second set of multipliers for the upper half of the hash
+#define PRIME1B 2870177450u
+#define PRIME2B 2034516277u
+
+// Stands in for rows of unknown content, a real row matching it is a 1 in 2^64 chance
+#define ROW_HASH_UNKNOWN 0xffffffffffffffffull
+
+static const uint32_t seed_a[4] = { PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1 };
+static const uint32_t seed_b[4] = { PRIME3, PRIME4, PRIME5, PRIME1B };
+
+static inline uint32_t rotl32(uint32_t x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+// Folds four lanes and the tail bytes into 32 bits
+static uint32_t finish(const uint32_t *lanes, const uint8_t *tail, size_t tail_bytes, size_t bytes)
+{
+    size_t i;
+    uint32_t h = rotl32(lanes[0], 1) + rotl32(lanes[1], 7) + rotl32(lanes[2], 12) + rotl32(lanes[3], 18);
+
+    h += (uint32_t)bytes;
+    for(i=0; i<tail_bytes; i++)
+        h = rotl32(h + tail[i]*PRIME5, 11)*PRIME1;
+
+    h ^= h >> 15;
+    h *= PRIME2;
+    h ^= h >> 13;
+    h *= PRIME3;
+    h ^= h >> 16;
+    return h;
+}
+
+// 64-bit row hash from two independent xxHash32 style accumulators run over
+// every 16 byte stripe, four 32-bit lanes each so NEON handles a stripe per step
+uint64_t row_hash(const uint8_t *pixels, size_t bytes)
+{
+    uint32_t a[4], b[4];
+    size_t stripes = bytes/16;
+    size_t i = 0;
+
+#ifdef __ARM_NEON
+    uint32x4_t va = vld1q_u32(seed_a);
+    uint32x4_t vb = vld1q_u32(seed_b);
+    const uint32x4_t p1 = vdupq_n_u32(PRIME1), p2 = vdupq_n_u32(PRIME2);
+    const uint32x4_t p1b = vdupq_n_u32(PRIME1B), p2b = vdupq_n_u32(PRIME2B);
+
+    for(; i<stripes; i++) {
+        uint32x4_t v = vreinterpretq_u32_u8(vld1q_u8(&pixels[i*16]));
+        va = vmlaq_u32(va, v, p2);
+        va = vmulq_u32(vsriq_n_u32(vshlq_n_u32(va, 13), va, 19), p1);
+        vb = vmlaq_u32(vb, v, p2b);
+        vb = vmulq_u32(vsriq_n_u32(vshlq_n_u32(vb, 17), vb, 15), p1b);
+    }
+    vst1q_u32(a, va);
+    vst1q_u32(b, vb);
+#else
+    int lane;
+    memcpy(a, seed_a, sizeof(a));
+    memcpy(b, seed_b, sizeof(b));
+
+    for(; i<stripes; i++) {
+        uint32_t v[4];
+        memcpy(v, &pixels[i*16], sizeof(v));
+        for(lane=0; lane<4; lane++) {
+            a[lane] = rotl32(a[lane] + v[lane]*PRIME2, 13)*PRIME1;
+            b[lane] = rotl32(b[lane] + v[lane]*PRIME2B, 17)*PRIME1B;
+        }
+    }
+#endif
+
+    const uint8_t *tail = &pixels[stripes*16];
+    size_t tail_bytes = bytes - stripes*16;
+    return (uint64_t)finish(a, tail, tail_bytes, bytes) << 32 | finish(b, tail, tail_bytes, bytes);
+}
+
+// Every row of the texture starts out holding initial_row
+void row_hash_init(ROW_HASH_T *table, int rows, const uint8_t *initial_row, size_t bytes)
+{
+    int i;
+    uint64_t hash = row_hash(initial_row, bytes);
+
+    memset(table, 0, sizeof(ROW_HASH_T));
+    table->rows = rows;
+    table->hashes = malloc(rows*sizeof(uint64_t));
+    assert(table->hashes);
+    for(i=0; i<rows; i++)
+        table->hashes[i] = hash;
+}
+
+// Records pixels as the new content of row, returns 0 if the texture already holds them
+int row_hash_update(ROW_HASH_T *table, int row, const uint8_t *pixels, size_t bytes)
+{
+    uint64_t hash = row_hash(pixels, bytes);
+
+    assert(row >= 0 && row < table->rows);
+    table->stats.rows_checked++;
+
+    if(table->hashes[row] == hash) {
+        table->stats.rows_skipped++;
+        table->stats.bytes_skipped += bytes;
+        return 0;
+    }
+
+    table->hashes[row] = hash;
+    table->stats.bytes_uploaded += bytes;
+    return 1;
+}
+
+// Forgets rows written by a path that does not hash, such as mapped PBO uploads
+void row_hash_invalidate(ROW_HASH_T *table, int row, int rows)
+{
+    int i;
+
+    assert(row >= 0 && row + rows <= table->rows);
+    for(i=row; i<row+rows; i++)
+        table->hashes[i] = ROW_HASH_UNKNOWN;
+}
+
+void row_hash_print_stats(ROW_HASH_T *table, const char *name)
+{
+    ROW_HASH_STATS_T *stats = &table->stats;
+
+    if(!stats->rows_checked)
+        return;
+
+    printf("%s: %llu of %llu rows unchanged, %llu bytes skipped, %llu uploaded\n", name,
+           stats->rows_skipped, stats->rows_checked, stats->bytes_skipped, stats->bytes_uploaded);
+}
+
+void row_hash_destroy(ROW_HASH_T *table)
+{
+    free(table->hashes);
+    memset(table, 0, sizeof(ROW_HASH_T));
+}
@@ -0,0 +1,30 @@
+#ifndef ROW_HASH_H
+#define ROW_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct
+{
+    unsigned long long rows_checked;
+    unsigned long long rows_skipped;
+    unsigned long long bytes_skipped;
+    unsigned long long bytes_uploaded;
+} ROW_HASH_STATS_T;
+
+// Content hash of every row currently held by one texture
+typedef struct
+{
+    uint64_t *hashes;
+    int rows;
+    ROW_HASH_STATS_T stats;
+} ROW_HASH_T;
+
+uint64_t row_hash(const uint8_t *pixels, size_t bytes);
+void row_hash_init(ROW_HASH_T *table, int rows, const uint8_t *initial_row, size_t bytes);
+int row_hash_update(ROW_HASH_T *table, int row, const uint8_t *pixels, size_t bytes);
+void row_hash_invalidate(ROW_HASH_T *table, int row, int rows);
+void row_hash_print_stats(ROW_HASH_T *table, const char *name);
+void row_hash_destroy(ROW_HASH_T *table);
+
+#endif
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sample_reader.h"
+
+static uint64_t sample_reader_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+// Fills buffer from the descriptor, returns 0 if the input ends first
+static int read_block(int fd, void *buffer, size_t size)
+{
+    char *dest = buffer;
+
+    while(size) {
+        ssize_t count = read(fd, dest, size);
+        if(count < 0 && errno == EINTR)
+            continue;
+        if(count <= 0)
+            return 0;
+        dest += count;
+        size -= count;
+    }
+    return 1;
+}
+
+// Cancellation can land in pthread_cond_wait(), which holds the lock again
+static void unlock(void *lock)
+{
+    pthread_mutex_unlock(lock);
+}
+
+static void *sample_reader_thread(void *arg)
+{
+    SAMPLE_READER_T *reader = arg;
+
+    while(1) {
+        unsigned long head = reader->head;
+
+        // Wait for the consumer to free a block
+        pthread_mutex_lock(&reader->lock);
+        pthread_cleanup_push(unlock, &reader->lock);
+        if(head - __atomic_load_n(&reader->tail, __ATOMIC_ACQUIRE) == SAMPLE_READER_BLOCKS)
+            reader->stats.full_waits++;
+        while(head - __atomic_load_n(&reader->tail, __ATOMIC_ACQUIRE) == SAMPLE_READER_BLOCKS)
+            pthread_cond_wait(&reader->space, &reader->lock);
+        pthread_cleanup_pop(1);
+
+        int slot = head % SAMPLE_READER_BLOCKS;
+        if(!read_block(reader->fd, reader->samples + slot*reader->block_samples, reader->block_samples*sizeof(int16_t))) {
+            __atomic_store_n(&reader->eof, 1, __ATOMIC_RELEASE);
+            return NULL;
+        }
+        reader->stamps[slot] = sample_reader_now();
+        reader->stats.blocks++;
+
+        // Publish the block after its samples and stamp
+        __atomic_store_n(&reader->head, head + 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Starts reading blocks of block_samples samples from fd
+void sample_reader_init(SAMPLE_READER_T *reader, int fd, size_t block_samples)
+{
+    memset(reader, 0, sizeof(SAMPLE_READER_T));
+    reader->fd = fd;
+    reader->block_samples = block_samples;
+    reader->samples = malloc(SAMPLE_READER_BLOCKS*block_samples*sizeof(int16_t));
+    assert(reader->samples);
+
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->space, NULL);
+
+    int ret = pthread_create(&reader->thread, NULL, sample_reader_thread, reader);
+    assert(ret == 0);
+}
+
+// Returns the oldest whole block without waiting, NULL if none has arrived.
+// ingest_ns is set to when it finished arriving.
+const int16_t *sample_reader_acquire(SAMPLE_READER_T *reader, uint64_t *ingest_ns)
+{
+    unsigned long tail = reader->tail;
+
+    if(__atomic_load_n(&reader->head, __ATOMIC_ACQUIRE) == tail)
+        return NULL;
+
+    int slot = tail % SAMPLE_READER_BLOCKS;
+    *ingest_ns = reader->stamps[slot];
+    return reader->samples + slot*reader->block_samples;
+}
+
+// Hands the block from sample_reader_acquire() back to the reader
+void sample_reader_release(SAMPLE_READER_T *reader)
+{
+    pthread_mutex_lock(&reader->lock);
+    __atomic_store_n(&reader->tail, reader->tail + 1, __ATOMIC_RELEASE);
+    pthread_cond_signal(&reader->space);
+    pthread_mutex_unlock(&reader->lock);
+}
+
+// Non zero once the input has ended and every block has been taken
+int sample_reader_finished(SAMPLE_READER_T *reader)
+{
+    return __atomic_load_n(&reader->eof, __ATOMIC_ACQUIRE)
+           && __atomic_load_n(&reader->head, __ATOMIC_ACQUIRE) == reader->tail;
+}
+
+void sample_reader_print_stats(SAMPLE_READER_T *reader)
+{
+    printf("Sample reader: %lu blocks read, ring full %lu times\n",
+           reader->stats.blocks, reader->stats.full_waits);
+}
+
+void sample_reader_destroy(SAMPLE_READER_T *reader)
+{
+    // The thread may be blocked in read() on a quiet source
+    pthread_cancel(reader->thread);
+    pthread_join(reader->thread, NULL);
+
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->space);
+    free(reader->samples);
+    memset(reader, 0, sizeof(SAMPLE_READER_T));
+}
@@ -0,0 +1,50 @@
+#ifndef SAMPLE_READER_H
+#define SAMPLE_READER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Reads fixed size blocks of signed 16-bit samples from a file descriptor on
+// its own thread into a ring, so a stalled source never blocks the caller.
+//
+// Single producer, single consumer: the reader thread only advances head
+// and the consumer only tail, both count blocks and never wrap. When the
+// ring is full the reader waits for the consumer to release a block.
+#define SAMPLE_READER_BLOCKS 4
+
+typedef struct
+{
+    unsigned long blocks;
+    // Times the reader found the ring full and had to wait
+    unsigned long full_waits;
+} SAMPLE_READER_STATS_T;
+
+typedef struct
+{
+    int fd;
+    size_t block_samples;
+    int16_t *samples;
+    // CLOCK_MONOTONIC nanoseconds each block finished arriving
+    uint64_t stamps[SAMPLE_READER_BLOCKS];
+
+    unsigned long head;
+    unsigned long tail;
+    // Non zero once the input has ended, after the last whole block
+    int eof;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t space;
+
+    SAMPLE_READER_STATS_T stats;
+} SAMPLE_READER_T;
+
+void sample_reader_init(SAMPLE_READER_T *reader, int fd, size_t block_samples);
+const int16_t *sample_reader_acquire(SAMPLE_READER_T *reader, uint64_t *ingest_ns);
+void sample_reader_release(SAMPLE_READER_T *reader);
+int sample_reader_finished(SAMPLE_READER_T *reader);
+void sample_reader_print_stats(SAMPLE_READER_T *reader);
+void sample_reader_destroy(SAMPLE_READER_T *reader);
+
+#endif
@@ -0,0 +1,79 @@
+// Reference producer for the multi_tex shared memory ring
+//
+// Usage: shm_producer [rows per second] [ring name]
+//
+// Writes a moving test pattern into the ring a row at a time, in place,
+// and reports the rate achieved and rows dropped by a lagging renderer.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shm_ring.h"
+
+static double get_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// A bright band sweeping across the row over a noise floor
+static void fill_row(uint8_t *row, uint32_t width, uint64_t seq)
+{
+    uint32_t i;
+    uint32_t band = (seq*3) % width;
+
+    for(i=0; i<width; i++) {
+        uint32_t distance = i > band ? i - band : band - i;
+        uint32_t noise = (uint32_t)(seq*2654435761u + i*40503u) >> 27;
+        row[i] = distance < 16 ? 255 - distance*8 : noise;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    double rate = argc > 1 ? atof(argv[1]) : 6000.0;
+    const char *name = argc > 2 ? argv[2] : SHM_RING_NAME;
+    SHM_RING_T ring;
+
+    // The renderer owns the ring, wait for it to come up
+    while(!shm_ring_open(&ring, name)) {
+        printf("Waiting for %s\n", name);
+        sleep(1);
+    }
+
+    SHM_RING_HEADER_T *header = ring.header;
+    printf("Attached to %s: %u rows of %u bytes, producing %.0f rows/s\n",
+           name, header->slot_count, header->row_bytes, rate);
+
+    uint64_t produced = 0;
+    double start = get_time();
+    double report = start;
+
+    while(1) {
+        uint8_t *row = shm_ring_producer_slot(&ring);
+        if(row) {
+            fill_row(row, header->row_bytes, header->write_seq);
+            shm_ring_publish(&ring);
+        }
+        produced++;
+
+        // Pace to the requested rate
+        double now = get_time();
+        double due = start + produced/rate;
+        if(due > now)
+            usleep((useconds_t)((due - now)*1e6));
+
+        if(now - report >= 1.0) {
+            printf("%llu rows, %.0f rows/s, %llu dropped\n", (unsigned long long)header->write_seq,
+                   produced/(now - start), (unsigned long long)header->dropped);
+            report = now;
+        }
+    }
+
+    shm_ring_destroy(&ring);
+    return 0;
+}
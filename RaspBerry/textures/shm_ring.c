@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "shm_ring.h"
+
+static long futex(uint32_t *word, int op, uint32_t value, const struct timespec *timeout)
+{
+    return syscall(SYS_futex, word, op, value, timeout, NULL, 0);
+}
+
+static void map_ring(SHM_RING_T *ring, size_t size)
+{
+    ring->map_size = size;
+    ring->header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+    assert(ring->header != MAP_FAILED);
+    ring->data = (uint8_t*)ring->header + ring->header->data_offset;
+    ring->stamps = (uint64_t*)((uint8_t*)ring->header + ring->header->stamp_offset);
+}
+
+static uint64_t publish_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull + ts.tv_nsec;
+}
+
+// Creates, or recreates, the named ring with slot_count rows of row_bytes
+void shm_ring_create(SHM_RING_T *ring, const char *name, uint32_t row_bytes, uint32_t slot_count)
+{
+    long page = sysconf(_SC_PAGESIZE);
+
+    memset(ring, 0, sizeof(SHM_RING_T));
+    strncpy(ring->name, name, sizeof(ring->name) - 1);
+    ring->owner = 1;
+
+    // Publish stamps follow the header, rows start on the next page boundary
+    uint32_t stamp_offset = (sizeof(SHM_RING_HEADER_T) + 63)/64*64;
+    uint32_t data_offset = (stamp_offset + slot_count*sizeof(uint64_t) + page - 1)/page*page;
+    size_t size = data_offset + (size_t)row_bytes*slot_count;
+
+    // Start from a fresh object, producers attached to a stale one keep their old pages
+    shm_unlink(name);
+    ring->fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0660);
+    assert(ring->fd >= 0);
+    int ret = ftruncate(ring->fd, size);
+    assert(ret == 0);
+
+    // Header must be filled in before map_ring() reads data_offset
+    SHM_RING_HEADER_T header;
+    memset(&header, 0, sizeof(SHM_RING_HEADER_T));
+    header.row_bytes = row_bytes;
+    header.slot_count = slot_count;
+    header.data_offset = data_offset;
+    header.stamp_offset = stamp_offset;
+    header.version = SHM_RING_VERSION;
+    ret = pwrite(ring->fd, &header, sizeof(SHM_RING_HEADER_T), 0);
+    assert(ret == sizeof(SHM_RING_HEADER_T));
+
+    map_ring(ring, size);
+
+    // Producers refuse to attach until the magic is visible
+    __atomic_store_n(&ring->header->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+
+    printf("Shared memory ring %s: %u rows of %u bytes\n", name, slot_count, row_bytes);
+}
+
+// Returns up to max_rows contiguous unread rows and their first sequence number,
+// NULL when there is nothing to read
+uint8_t *shm_ring_acquire(SHM_RING_T *ring, uint32_t max_rows, uint32_t *rows, uint64_t *seq)
+{
+    SHM_RING_HEADER_T *header = ring->header;
+    uint64_t read_seq = header->read_seq;
+    uint64_t write_seq = __atomic_load_n(&header->write_seq, __ATOMIC_ACQUIRE);
+    uint64_t available = write_seq - read_seq;
+
+    *rows = 0;
+    *seq = read_seq;
+    if(!available)
+        return NULL;
+
+    // Stop at the end of the ring so the rows stay contiguous
+    uint32_t slot = read_seq % header->slot_count;
+    uint32_t count = header->slot_count - slot;
+    if(count > available)
+        count = available;
+    if(count > max_rows)
+        count = max_rows;
+
+    *rows = count;
+    return ring->data + (size_t)slot*header->row_bytes;
+}
+
+// Hands rows returned by shm_ring_acquire() back to the producer
+void shm_ring_release(SHM_RING_T *ring, uint32_t rows)
+{
+    __atomic_store_n(&ring->header->read_seq, ring->header->read_seq + rows, __ATOMIC_RELEASE);
+}
+
+// Time the row with sequence number seq was published, valid until it is released
+uint64_t shm_ring_stamp(SHM_RING_T *ring, uint64_t seq)
+{
+    return ring->stamps[seq % ring->header->slot_count];
+}
+
+// Sleeps until a row is published or timeout_ms passes, returns non zero if rows are waiting
+int shm_ring_wait(SHM_RING_T *ring, int timeout_ms)
+{
+    SHM_RING_HEADER_T *header = ring->header;
+    struct timespec timeout;
+
+    timeout.tv_sec = timeout_ms/1000;
+    timeout.tv_nsec = (timeout_ms%1000)*1000000L;
+
+    // Announce the sleep before the last check so a publish in between wakes us
+    uint32_t wake = __atomic_load_n(&header->wake, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&header->waiting, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&header->write_seq, __ATOMIC_SEQ_CST) == header->read_seq)
+        futex(&header->wake, FUTEX_WAIT, wake, &timeout);
+    __atomic_store_n(&header->waiting, 0, __ATOMIC_RELAXED);
+
+    return __atomic_load_n(&header->write_seq, __ATOMIC_ACQUIRE) != header->read_seq;
+}
+
+// Attaches to a ring created by the renderer, returns 0 if it does not exist or is incompatible
+int shm_ring_open(SHM_RING_T *ring, const char *name)
+{
+    SHM_RING_HEADER_T header;
+
+    memset(ring, 0, sizeof(SHM_RING_T));
+    strncpy(ring->name, name, sizeof(ring->name) - 1);
+
+    ring->fd = shm_open(name, O_RDWR, 0);
+    if(ring->fd < 0)
+        return 0;
+
+    if(pread(ring->fd, &header, sizeof(SHM_RING_HEADER_T), 0) != sizeof(SHM_RING_HEADER_T)
+       || header.magic != SHM_RING_MAGIC || header.version != SHM_RING_VERSION) {
+        close(ring->fd);
+        return 0;
+    }
+
+    map_ring(ring, header.data_offset + (size_t)header.row_bytes*header.slot_count);
+    return 1;
+}
+
+// Slot for the next row, written in place before shm_ring_publish(). Returns
+// NULL and counts a drop when the renderer has fallen a whole ring behind
+uint8_t *shm_ring_producer_slot(SHM_RING_T *ring)
+{
+    SHM_RING_HEADER_T *header = ring->header;
+    uint64_t read_seq = __atomic_load_n(&header->read_seq, __ATOMIC_ACQUIRE);
+
+    if(header->write_seq - read_seq >= header->slot_count) {
+        __atomic_store_n(&header->dropped, header->dropped + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    return ring->data + (size_t)(header->write_seq % header->slot_count)*header->row_bytes;
+}
+
+void shm_ring_publish(SHM_RING_T *ring)
+{
+    SHM_RING_HEADER_T *header = ring->header;
+
+    ring->stamps[header->write_seq % header->slot_count] = publish_time();
+    __atomic_store_n(&header->write_seq, header->write_seq + 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&header->wake, 1, __ATOMIC_SEQ_CST);
+
+    // Only pay for the syscall when the renderer is asleep
+    if(__atomic_load_n(&header->waiting, __ATOMIC_SEQ_CST))
+        futex(&header->wake, FUTEX_WAKE, 1, NULL);
+}
+
+void shm_ring_destroy(SHM_RING_T *ring)
+{
+    if(ring->header)
+        munmap(ring->header, ring->map_size);
+    if(ring->fd >= 0)
+        close(ring->fd);
+    if(ring->owner)
+        shm_unlink(ring->name);
+    memset(ring, 0, sizeof(SHM_RING_T));
+}
@@ -0,0 +1,79 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Shared memory row ring between an acquisition process and the renderer
+//
+// The mapping is a SHM_RING_HEADER_T at offset 0 followed, at data_offset,
+// by slot_count rows of row_bytes each. Row n of the stream lives in slot
+// n % slot_count so consecutive rows are contiguous in memory until the
+// ring wraps, letting the renderer upload blocks of rows straight from
+// the shared pages.
+//
+// write_seq is only written by the producer and read_seq only by the
+// consumer. Both count rows since the ring was created and never wrap.
+// A row is published by writing its slot then storing write_seq with
+// release ordering, and consumed by storing read_seq the same way. The
+// producer never overwrites unconsumed rows. When the ring is full it
+// drops the row and bumps dropped instead of blocking acquisition.
+//
+// wake is a futex word the producer increments on every publish. A
+// consumer with nothing to read sets waiting and sleeps on it.
+//
+// At stamp_offset, one uint64_t per slot holds the CLOCK_MONOTONIC time in
+// nanoseconds the row was published, written before write_seq like the row.
+#define SHM_RING_MAGIC 0x52575231
+#define SHM_RING_VERSION 2
+
+// Default object name in /dev/shm
+#define SHM_RING_NAME "/ogl_tex_rows"
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t row_bytes;
+    uint32_t slot_count;
+    uint32_t data_offset;
+    uint32_t stamp_offset;
+
+    // Producer owned
+    uint64_t write_seq;
+    uint64_t dropped;
+    uint32_t wake;
+
+    // Consumer owned, on its own cache line
+    uint32_t waiting __attribute__((aligned(64)));
+    uint64_t read_seq;
+} SHM_RING_HEADER_T;
+
+typedef struct
+{
+    SHM_RING_HEADER_T *header;
+    uint8_t *data;
+    uint64_t *stamps;
+    size_t map_size;
+    int fd;
+
+    // Creator unlinks the object on destroy
+    int owner;
+    char name[64];
+} SHM_RING_T;
+
+// Renderer side
+void shm_ring_create(SHM_RING_T *ring, const char *name, uint32_t row_bytes, uint32_t slot_count);
+uint8_t *shm_ring_acquire(SHM_RING_T *ring, uint32_t max_rows, uint32_t *rows, uint64_t *seq);
+void shm_ring_release(SHM_RING_T *ring, uint32_t rows);
+uint64_t shm_ring_stamp(SHM_RING_T *ring, uint64_t seq);
+int shm_ring_wait(SHM_RING_T *ring, int timeout_ms);
+
+// Producer side
+int shm_ring_open(SHM_RING_T *ring, const char *name);
+uint8_t *shm_ring_producer_slot(SHM_RING_T *ring);
+void shm_ring_publish(SHM_RING_T *ring);
+
+void shm_ring_destroy(SHM_RING_T *ring);
+
+#endif
@@ -0,0 +1,290 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+#include "row_hash.h"
+
+static double snapshot_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static uint32_t commit_checksum(const SNAPSHOT_COMMIT_T *commit)
+{
+    return (uint32_t)row_hash((const uint8_t *)commit, offsetof(SNAPSHOT_COMMIT_T, checksum));
+}
+
+static void *snapshot_thread(void *arg);
+
+static size_t pane_bytes(SNAPSHOT_T *snap)
+{
+    return (size_t)snap->header->width*snap->header->height;
+}
+
+// Maps path, creating it when missing or laid out differently. Returns non zero
+// when it held a valid snapshot, whose pixels and heads are then available.
+int snapshot_open(SNAPSHOT_T *snap, const char *path, uint32_t panes, uint32_t width, uint32_t height)
+{
+    struct stat st;
+    int i;
+
+    assert(panes <= SNAPSHOT_MAX_PANES);
+    assert(sizeof(SNAPSHOT_HEADER_T) <= SNAPSHOT_HEADER_BYTES);
+
+    memset(snap, 0, sizeof(SNAPSHOT_T));
+    snap->map_size = SNAPSHOT_HEADER_BYTES + (size_t)panes*width*height;
+
+    snap->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(snap->fd < 0) {
+        printf("Can not open snapshot %s\n", path);
+        exit(1);
+    }
+    fstat(snap->fd, &st);
+
+    // A file of another size can not be this layout, start it over zero filled
+    int existing = (size_t)st.st_size == snap->map_size;
+    if(!existing) {
+        int ret = ftruncate(snap->fd, 0);
+        assert(ret == 0);
+        ret = ftruncate(snap->fd, snap->map_size);
+        assert(ret == 0);
+    }
+
+    snap->header = mmap(NULL, snap->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, snap->fd, 0);
+    assert(snap->header != MAP_FAILED);
+    snap->pixels = (uint8_t *)snap->header + SNAPSHOT_HEADER_BYTES;
+
+    SNAPSHOT_HEADER_T *header = snap->header;
+    if(existing && header->magic == SNAPSHOT_MAGIC && header->version == SNAPSHOT_VERSION
+       && header->width == width && header->height == height && header->panes == panes) {
+        // Newest commit that checks out, sequence 0 was never written
+        SNAPSHOT_COMMIT_T *best = NULL;
+        for(i=0; i<2; i++) {
+            SNAPSHOT_COMMIT_T *commit = &header->commits[i];
+            if(commit->sequence && commit->checksum == commit_checksum(commit)
+               && (!best || commit->sequence > best->sequence))
+                best = commit;
+        }
+        if(best) {
+            snap->restored = 1;
+            snap->sequence = best->sequence;
+            for(i=0; i<SNAPSHOT_MAX_PANES; i++)
+                snap->heads[i] = best->heads[i] < height ? best->heads[i] : 0;
+        }
+    }
+
+    if(!snap->restored) {
+        memset(header, 0, sizeof(SNAPSHOT_HEADER_T));
+        header->version = SNAPSHOT_VERSION;
+        header->width = width;
+        header->height = height;
+        header->panes = panes;
+        header->magic = SNAPSHOT_MAGIC;
+    }
+
+    snap->last_commit = snapshot_time();
+
+    pthread_mutex_init(&snap->lock, NULL);
+    pthread_cond_init(&snap->wake, NULL);
+    int ret = pthread_create(&snap->thread, NULL, snapshot_thread, snap);
+    assert(ret == 0);
+
+    printf("Snapshot %s: %u panes of %ux%u, %s\n", path, panes, width, height,
+           snap->restored ? "restored" : "new");
+
+    return snap->restored;
+}
+
+// Pixels of a pane from row onwards, rows are contiguous up to the pane height
+uint8_t *snapshot_rows(SNAPSHOT_T *snap, int pane, uint32_t row)
+{
+    return snap->pixels + pane*pane_bytes(snap) + (size_t)row*snap->header->width;
+}
+
+// Copies rows into the snapshot, pixels may already be the snapshot's own rows
+void snapshot_store_rows(SNAPSHOT_T *snap, int pane, uint32_t row, uint32_t rows, const uint8_t *pixels)
+{
+    uint8_t *dst = snapshot_rows(snap, pane, row);
+
+    assert(row + rows <= snap->header->height);
+    if(dst != pixels)
+        memcpy(dst, pixels, (size_t)rows*snap->header->width);
+    snapshot_mark(snap, pane, row, rows);
+}
+
+// Records rows written in place through snapshot_rows()
+void snapshot_mark(SNAPSHOT_T *snap, int pane, uint32_t row, uint32_t rows)
+{
+    snap->stats.rows += rows;
+
+    if(snap->dirty_end[pane] <= snap->dirty_begin[pane]) {
+        snap->dirty_begin[pane] = row;
+        snap->dirty_end[pane] = row + rows;
+        return;
+    }
+    if(row < snap->dirty_begin[pane])
+        snap->dirty_begin[pane] = row;
+    if(row + rows > snap->dirty_end[pane])
+        snap->dirty_end[pane] = row + rows;
+}
+
+void snapshot_set_head(SNAPSHOT_T *snap, int pane, uint32_t head)
+{
+    snap->heads[pane] = head;
+}
+
+uint32_t snapshot_head(SNAPSHOT_T *snap, int pane)
+{
+    return snap->heads[pane];
+}
+
+// Writes back a job's rows, then publishes its heads. A crashed process loses
+// nothing, the page cache still holds every row. Power loss can lose up to an
+// interval, never the last good header, and a header on disk never points at
+// rows that are not.
+static void write_commit(SNAPSHOT_T *snap, const SNAPSHOT_JOB_T *job)
+{
+    SNAPSHOT_HEADER_T *header = snap->header;
+    double start = snapshot_time();
+    unsigned long long bytes_synced = 0;
+    uint32_t pane;
+    int i;
+
+    for(pane=0; pane<header->panes; pane++) {
+        if(job->dirty_end[pane] <= job->dirty_begin[pane])
+            continue;
+
+        // Only an interval of rows, but the heads must not reach the disk before them
+        off64_t offset = SNAPSHOT_HEADER_BYTES + pane*pane_bytes(snap) + (size_t)job->dirty_begin[pane]*header->width;
+        off64_t bytes = (off64_t)(job->dirty_end[pane] - job->dirty_begin[pane])*header->width;
+        sync_file_range(snap->fd, offset, bytes,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        bytes_synced += bytes;
+    }
+
+    // Alternate slots, the previous commit stays intact until this one is complete
+    SNAPSHOT_COMMIT_T *commit = &header->commits[(snap->sequence + 1) & 1];
+    commit->sequence = 0;
+    for(i=0; i<SNAPSHOT_MAX_PANES; i++)
+        commit->heads[i] = job->heads[i];
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    commit->sequence = ++snap->sequence;
+    commit->checksum = commit_checksum(commit);
+
+    // Queued without waiting, until it lands the other slot is the good one
+    sync_file_range(snap->fd, 0, SNAPSHOT_HEADER_BYTES, SYNC_FILE_RANGE_WRITE);
+
+    pthread_mutex_lock(&snap->lock);
+    snap->stats.commits++;
+    snap->stats.bytes_synced += bytes_synced;
+    snap->stats.sync_seconds += snapshot_time() - start;
+    pthread_mutex_unlock(&snap->lock);
+}
+
+// Takes one job at a time, a quit request is only honoured once none is pending
+static void *snapshot_thread(void *arg)
+{
+    SNAPSHOT_T *snap = arg;
+    SNAPSHOT_JOB_T job;
+
+    pthread_mutex_lock(&snap->lock);
+    while(1) {
+        while(!snap->pending && !snap->quit)
+            pthread_cond_wait(&snap->wake, &snap->lock);
+        if(!snap->pending)
+            break;
+
+        job = snap->job;
+        memset(&snap->job, 0, sizeof(SNAPSHOT_JOB_T));
+        snap->pending = 0;
+        pthread_mutex_unlock(&snap->lock);
+
+        write_commit(snap, &job);
+
+        pthread_mutex_lock(&snap->lock);
+    }
+    pthread_mutex_unlock(&snap->lock);
+
+    return NULL;
+}
+
+// Hands the rows changed since the last commit and the current heads to the
+// commit thread, never waits on the disk. A commit the thread has not taken
+// yet is widened to cover these rows and takes the newer heads.
+void snapshot_commit(SNAPSHOT_T *snap)
+{
+    uint32_t pane;
+
+    pthread_mutex_lock(&snap->lock);
+    if(snap->pending)
+        snap->stats.merged++;
+    for(pane=0; pane<snap->header->panes; pane++) {
+        snap->job.heads[pane] = snap->heads[pane];
+        if(snap->dirty_end[pane] <= snap->dirty_begin[pane])
+            continue;
+
+        if(snap->job.dirty_end[pane] <= snap->job.dirty_begin[pane]) {
+            snap->job.dirty_begin[pane] = snap->dirty_begin[pane];
+            snap->job.dirty_end[pane] = snap->dirty_end[pane];
+        }
+        else {
+            if(snap->dirty_begin[pane] < snap->job.dirty_begin[pane])
+                snap->job.dirty_begin[pane] = snap->dirty_begin[pane];
+            if(snap->dirty_end[pane] > snap->job.dirty_end[pane])
+                snap->job.dirty_end[pane] = snap->dirty_end[pane];
+        }
+        snap->dirty_begin[pane] = snap->dirty_end[pane] = 0;
+    }
+    snap->pending = 1;
+    pthread_cond_signal(&snap->wake);
+    pthread_mutex_unlock(&snap->lock);
+
+    snap->last_commit = snapshot_time();
+}
+
+// Commits once SNAPSHOT_INTERVAL has passed, call once per frame
+void snapshot_update(SNAPSHOT_T *snap)
+{
+    if(snapshot_time() - snap->last_commit >= SNAPSHOT_INTERVAL)
+        snapshot_commit(snap);
+}
+
+void snapshot_print_stats(SNAPSHOT_T *snap)
+{
+    SNAPSHOT_STATS_T *stats = &snap->stats;
+
+    pthread_mutex_lock(&snap->lock);
+    printf("Snapshot: %lu commits, %lu merged, %llu rows stored, %.1f MB written back, %.2f ms per commit off thread\n",
+           stats->commits, stats->merged, stats->rows, stats->bytes_synced/(1024.0*1024.0),
+           stats->commits ? stats->sync_seconds*1e3/stats->commits : 0.0);
+    pthread_mutex_unlock(&snap->lock);
+}
+
+// Final commit, waited on so a clean exit always leaves a complete snapshot
+void snapshot_close(SNAPSHOT_T *snap)
+{
+    snapshot_commit(snap);
+
+    pthread_mutex_lock(&snap->lock);
+    snap->quit = 1;
+    pthread_cond_signal(&snap->wake);
+    pthread_mutex_unlock(&snap->lock);
+    pthread_join(snap->thread, NULL);
+    pthread_mutex_destroy(&snap->lock);
+    pthread_cond_destroy(&snap->wake);
+
+    msync(snap->header, snap->map_size, MS_SYNC);
+    munmap(snap->header, snap->map_size);
+    close(snap->fd);
+    memset(snap, 0, sizeof(SNAPSHOT_T));
+}
@@ -0,0 +1,107 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Memory mapped copy of every pane's pixels and ring heads, so a restarted
+// display comes back with its history. Rows land in the mapping as they are
+// uploaded and reach the file through the page cache, which survives the
+// process crashing. Commits flush changed rows and then the heads, into
+// alternating checksummed header slots so a torn write falls back to the last
+// good commit. The flush waits on the disk, so it runs on a commit thread and
+// the caller only hands over the dirty ranges and heads.
+
+#define SNAPSHOT_MAGIC 0x50414e53
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_MAX_PANES 4
+
+// Pixels start on the first page after the header
+#define SNAPSHOT_HEADER_BYTES 4096
+
+// Seconds between commits
+#define SNAPSHOT_INTERVAL 1.0
+
+typedef struct
+{
+    uint64_t sequence;
+    uint32_t heads[SNAPSHOT_MAX_PANES];
+    // Over the fields above
+    uint32_t checksum;
+    uint32_t reserved;
+} SNAPSHOT_COMMIT_T;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t panes;
+    uint32_t reserved;
+    SNAPSHOT_COMMIT_T commits[2];
+} SNAPSHOT_HEADER_T;
+
+typedef struct
+{
+    unsigned long commits;
+    unsigned long long rows;
+    unsigned long long bytes_synced;
+    // Spent by the commit thread waiting for rows to reach the disk
+    double sync_seconds;
+    // Commits folded into one still waiting for the commit thread
+    unsigned long merged;
+} SNAPSHOT_STATS_T;
+
+// Rows to write back and the heads to publish once they are on disk
+typedef struct
+{
+    uint32_t heads[SNAPSHOT_MAX_PANES];
+    uint32_t dirty_begin[SNAPSHOT_MAX_PANES];
+    uint32_t dirty_end[SNAPSHOT_MAX_PANES];
+} SNAPSHOT_JOB_T;
+
+typedef struct
+{
+    int fd;
+    size_t map_size;
+    SNAPSHOT_HEADER_T *header;
+    uint8_t *pixels;
+
+    // Non zero when the file held a valid snapshot of the same layout
+    int restored;
+
+    // Heads as of now, written out by the next commit
+    uint32_t heads[SNAPSHOT_MAX_PANES];
+    // Last sequence written, owned by the commit thread once it runs
+    uint64_t sequence;
+
+    // Rows changed since the last commit per pane, empty when end <= begin
+    uint32_t dirty_begin[SNAPSHOT_MAX_PANES];
+    uint32_t dirty_end[SNAPSHOT_MAX_PANES];
+    double last_commit;
+
+    // Commit handed to the commit thread, pending until it takes it
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    SNAPSHOT_JOB_T job;
+    int pending;
+    int quit;
+
+    SNAPSHOT_STATS_T stats;
+} SNAPSHOT_T;
+
+int snapshot_open(SNAPSHOT_T *snap, const char *path, uint32_t panes, uint32_t width, uint32_t height);
+uint8_t *snapshot_rows(SNAPSHOT_T *snap, int pane, uint32_t row);
+void snapshot_store_rows(SNAPSHOT_T *snap, int pane, uint32_t row, uint32_t rows, const uint8_t *pixels);
+void snapshot_mark(SNAPSHOT_T *snap, int pane, uint32_t row, uint32_t rows);
+void snapshot_set_head(SNAPSHOT_T *snap, int pane, uint32_t head);
+uint32_t snapshot_head(SNAPSHOT_T *snap, int pane);
+void snapshot_commit(SNAPSHOT_T *snap);
+void snapshot_update(SNAPSHOT_T *snap);
+void snapshot_print_stats(SNAPSHOT_T *snap);
+void snapshot_close(SNAPSHOT_T *snap);
+
+#endif
@@ -0,0 +1,322 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "spectrogram.h"
+
+// Keeps log2() finite for silent bins
+#define SPECTROGRAM_POWER_EPSILON 1e-20f
+
+static double spectrogram_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// log2 from the float exponent plus a polynomial fit of the mantissa,
+// good to about 1e-4 which is well below one 8-bit output step
+static inline float fast_log2(float x)
+{
+    union { float f; uint32_t i; } v;
+    v.f = x;
+    float e = (float)((int)(v.i >> 23) - 127);
+    v.i = (v.i & 0x007fffff) | 0x3f800000;
+    float m = v.f;
+    return e + (-1.7417939f + (2.8212026f + (-1.4699568f + (0.44717955f - 0.056570851f*m)*m)*m)*m);
+}
+
+// Windows one block of fft_size samples into the work buffer, packing even
+// samples into the real and odd samples into the imaginary part of each point
+static void load_block(SPECTROGRAM_T *spec, float *work, const int16_t *samples)
+{
+    int n;
+    int points = spec->fft_size/2;
+    const float scale = 1.0f/32768.0f;
+
+    for(n=0; n<points; n++) {
+        int dst = spec->bit_reverse[n]*2;
+        work[dst + 0] = samples[n*2 + 0]*spec->window[n*2 + 0]*scale;
+        work[dst + 1] = samples[n*2 + 1]*spec->window[n*2 + 1]*scale;
+    }
+}
+
+// In place radix-2 decimation in time FFT on bit reversed input
+static void fft(SPECTROGRAM_T *spec, float *work)
+{
+    int size, start, k;
+    int points = spec->fft_size/2;
+
+    for(size=2; size<=points; size*=2) {
+        int half = size/2;
+        int step = points/size;
+        for(start=0; start<points; start+=size) {
+            float *a = &work[start*2];
+            float *b = &work[(start + half)*2];
+            for(k=0; k<half; k++) {
+                float wr = spec->twiddles[k*step*2 + 0];
+                float wi = spec->twiddles[k*step*2 + 1];
+                float br = b[k*2 + 0]*wr - b[k*2 + 1]*wi;
+                float bi = b[k*2 + 0]*wi + b[k*2 + 1]*wr;
+                b[k*2 + 0] = a[k*2 + 0] - br;
+                b[k*2 + 1] = a[k*2 + 1] - bi;
+                a[k*2 + 0] += br;
+                a[k*2 + 1] += bi;
+            }
+        }
+    }
+}
+
+// Separates the packed even/odd transform into the power of each real bin
+static void split_power(SPECTROGRAM_T *spec, const float *work, float *power)
+{
+    int k;
+    int points = spec->fft_size/2;
+
+    for(k=0; k<points; k++) {
+        int c = (points - k) & (points - 1);
+        float zr = work[k*2 + 0], zi = work[k*2 + 1];
+        float cr = work[c*2 + 0], ci = -work[c*2 + 1];
+
+        // Even and odd sample spectra
+        float er = 0.5f*(zr + cr), ei = 0.5f*(zi + ci);
+        float od = 0.5f*(zi - ci), oi = -0.5f*(zr - cr);
+
+        float wr = spec->split_twiddles[k*2 + 0];
+        float wi = spec->split_twiddles[k*2 + 1];
+        float xr = er + od*wr - oi*wi;
+        float xi = ei + od*wi + oi*wr;
+        power[k] = xr*xr + xi*xi;
+    }
+}
+
+// Converts power to 8-bit log magnitude
+static void power_to_bytes(SPECTROGRAM_T *spec, const float *power, GLubyte *row)
+{
+    int k = 0;
+
+#ifdef __ARM_NEON
+    const float32x4_t epsilon = vdupq_n_f32(SPECTROGRAM_POWER_EPSILON);
+    const float32x4_t scale = vdupq_n_f32(spec->log_scale);
+    const float32x4_t offset = vdupq_n_f32(spec->log_offset + 0.5f);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t max = vdupq_n_f32(255.0f);
+    const uint32x4_t mantissa_mask = vdupq_n_u32(0x007fffff);
+    const uint32x4_t one = vdupq_n_u32(0x3f800000);
+    const int32x4_t bias = vdupq_n_s32(127);
+
+    for(; k + 8 <= spec->bins; k += 8) {
+        uint16x4_t half[2];
+        int j;
+        for(j=0; j<2; j++) {
+            float32x4_t p = vaddq_f32(vld1q_f32(&power[k + j*4]), epsilon);
+            uint32x4_t bits = vreinterpretq_u32_f32(p);
+            float32x4_t e = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), bias));
+            float32x4_t m = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, mantissa_mask), one));
+
+            // Same polynomial as fast_log2(), evaluated with multiply-accumulates
+            float32x4_t t = vmlaq_f32(vdupq_n_f32(0.44717955f), m, vdupq_n_f32(-0.056570851f));
+            t = vmlaq_f32(vdupq_n_f32(-1.4699568f), m, t);
+            t = vmlaq_f32(vdupq_n_f32(2.8212026f), m, t);
+            t = vmlaq_f32(vdupq_n_f32(-1.7417939f), m, t);
+
+            float32x4_t v = vmlaq_f32(offset, vaddq_f32(e, t), scale);
+            v = vmaxq_f32(vminq_f32(v, max), zero);
+            half[j] = vmovn_u32(vcvtq_u32_f32(v));
+        }
+        vst1_u8(&row[k], vmovn_u16(vcombine_u16(half[0], half[1])));
+    }
+#endif
+
+    for(; k<spec->bins; k++) {
+        float v = fast_log2(power[k] + SPECTROGRAM_POWER_EPSILON)*spec->log_scale + spec->log_offset + 0.5f;
+        if(v < 0.0f)
+            v = 0.0f;
+        else if(v > 255.0f)
+            v = 255.0f;
+        row[k] = (GLubyte)v;
+    }
+}
+
+static void *spectrogram_worker(void *arg)
+{
+    SPECTROGRAM_WORKER_T *worker = arg;
+    SPECTROGRAM_T *spec = worker->spec;
+    int index = worker - spec->workers;
+    unsigned int seen = 0;
+    GLsizei row;
+
+    while(1) {
+        pthread_mutex_lock(&spec->lock);
+        while(spec->generation == seen && !spec->quit)
+            pthread_cond_wait(&spec->start, &spec->lock);
+        if(spec->quit) {
+            pthread_mutex_unlock(&spec->lock);
+            break;
+        }
+        seen = spec->generation;
+        pthread_mutex_unlock(&spec->lock);
+
+        // Contiguous slice of the job's rows for this worker
+        GLsizei first = spec->row_count*index/spec->thread_count;
+        GLsizei last = spec->row_count*(index + 1)/spec->thread_count;
+        for(row=first; row<last; row++) {
+            load_block(spec, worker->work, &spec->samples[row*spec->fft_size]);
+            fft(spec, worker->work);
+            split_power(spec, worker->work, worker->power);
+            power_to_bytes(spec, worker->power, &spec->rows[row*spec->row_stride]);
+        }
+
+        pthread_mutex_lock(&spec->lock);
+        if(--spec->pending == 0)
+            pthread_cond_signal(&spec->done);
+        pthread_mutex_unlock(&spec->lock);
+    }
+
+    return NULL;
+}
+
+// fft_size must be a power of two, each output row holds fft_size/2 bins
+void spectrogram_init(SPECTROGRAM_T *spec, int fft_size, int thread_count)
+{
+    int i;
+    int points = fft_size/2;
+    int bits = 0;
+
+    assert(fft_size >= 16 && (fft_size & (fft_size - 1)) == 0);
+    assert(thread_count >= 1 && thread_count <= SPECTROGRAM_MAX_THREADS);
+
+    memset(spec, 0, sizeof(SPECTROGRAM_T));
+    spec->fft_size = fft_size;
+    spec->bins = points;
+    spec->thread_count = thread_count;
+
+    spec->window = malloc(fft_size*sizeof(float));
+    spec->bit_reverse = malloc(points*sizeof(int));
+    spec->twiddles = malloc(points*sizeof(float));
+    spec->split_twiddles = malloc(points*2*sizeof(float));
+    assert(spec->window && spec->bit_reverse && spec->twiddles && spec->split_twiddles);
+
+    // Hann window
+    for(i=0; i<fft_size; i++)
+        spec->window[i] = 0.5f - 0.5f*cosf(2.0f*M_PI*i/fft_size);
+
+    while((1 << bits) < points)
+        bits++;
+    for(i=0; i<points; i++) {
+        int j, r = 0;
+        for(j=0; j<bits; j++)
+            r |= ((i >> j) & 1) << (bits - 1 - j);
+        spec->bit_reverse[i] = r;
+    }
+
+    for(i=0; i<points/2; i++) {
+        spec->twiddles[i*2 + 0] = cosf(2.0f*M_PI*i/points);
+        spec->twiddles[i*2 + 1] = -sinf(2.0f*M_PI*i/points);
+    }
+    for(i=0; i<points; i++) {
+        spec->split_twiddles[i*2 + 0] = cosf(2.0f*M_PI*i/fft_size);
+        spec->split_twiddles[i*2 + 1] = -sinf(2.0f*M_PI*i/fft_size);
+    }
+
+    spectrogram_set_range(spec, -120.0f, 120.0f);
+
+    pthread_mutex_init(&spec->lock, NULL);
+    pthread_cond_init(&spec->start, NULL);
+    pthread_cond_init(&spec->done, NULL);
+
+    for(i=0; i<thread_count; i++) {
+        SPECTROGRAM_WORKER_T *worker = &spec->workers[i];
+        worker->spec = spec;
+        worker->work = malloc(points*2*sizeof(float));
+        worker->power = malloc(points*sizeof(float));
+        assert(worker->work && worker->power);
+        int ret = pthread_create(&worker->thread, NULL, spectrogram_worker, worker);
+        assert(ret == 0);
+    }
+
+    printf("Spectrogram: %d point FFT, %d threads%s\n", fft_size, thread_count,
+#ifdef __ARM_NEON
+           ", NEON"
+#else
+           ""
+#endif
+          );
+}
+
+// Maps floor_db..floor_db+range_db, relative to a full scale sine, onto 0..255
+void spectrogram_set_range(SPECTROGRAM_T *spec, float floor_db, float range_db)
+{
+    // A full scale sine peaks at (fft_size/4)^2 power through the Hann window
+    float full_scale_db = 20.0f*log10f(spec->fft_size/4.0f);
+    float bytes_per_db = 255.0f/range_db;
+
+    spec->log_scale = 10.0f*log10f(2.0f)*bytes_per_db;
+    spec->log_offset = -(full_scale_db + floor_db)*bytes_per_db;
+}
+
+// Converts row_count blocks of fft_size samples into 8-bit rows row_stride bytes apart
+void spectrogram_process(SPECTROGRAM_T *spec, const int16_t *samples, GLubyte *rows, GLsizei row_count, GLsizei row_stride)
+{
+    double start = spectrogram_time();
+
+    pthread_mutex_lock(&spec->lock);
+    spec->samples = samples;
+    spec->rows = rows;
+    spec->row_count = row_count;
+    spec->row_stride = row_stride;
+    spec->pending = spec->thread_count;
+    spec->generation++;
+    pthread_cond_broadcast(&spec->start);
+    while(spec->pending)
+        pthread_cond_wait(&spec->done, &spec->lock);
+    pthread_mutex_unlock(&spec->lock);
+
+    spec->stats.rows += row_count;
+    spec->stats.samples += (unsigned long long)row_count*spec->fft_size;
+    spec->stats.seconds += spectrogram_time() - start;
+}
+
+void spectrogram_print_stats(SPECTROGRAM_T *spec)
+{
+    SPECTROGRAM_STATS_T *stats = &spec->stats;
+
+    if(stats->seconds <= 0.0)
+        return;
+
+    printf("Spectrogram: %lu rows, %.1f rows/s, %.2f Msamples/s while busy\n",
+           stats->rows, stats->rows/stats->seconds, stats->samples/stats->seconds*1e-6);
+}
+
+void spectrogram_destroy(SPECTROGRAM_T *spec)
+{
+    int i;
+
+    pthread_mutex_lock(&spec->lock);
+    spec->quit = 1;
+    pthread_cond_broadcast(&spec->start);
+    pthread_mutex_unlock(&spec->lock);
+
+    for(i=0; i<spec->thread_count; i++) {
+        pthread_join(spec->workers[i].thread, NULL);
+        free(spec->workers[i].work);
+        free(spec->workers[i].power);
+    }
+
+    pthread_mutex_destroy(&spec->lock);
+    pthread_cond_destroy(&spec->start);
+    pthread_cond_destroy(&spec->done);
+
+    free(spec->window);
+    free(spec->bit_reverse);
+    free(spec->twiddles);
+    free(spec->split_twiddles);
+    memset(spec, 0, sizeof(SPECTROGRAM_T));
+}
@@ -0,0 +1,74 @@
+#ifndef SPECTROGRAM_H
+#define SPECTROGRAM_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "GLES2/gl2.h"
+
+// Worker threads, one per core on the Pi
+#define SPECTROGRAM_MAX_THREADS 4
+
+typedef struct
+{
+    // Rows and samples converted and the wall time spent doing so
+    unsigned long rows;
+    unsigned long long samples;
+    double seconds;
+} SPECTROGRAM_STATS_T;
+
+struct SPECTROGRAM_S;
+
+typedef struct
+{
+    struct SPECTROGRAM_S *spec;
+    pthread_t thread;
+
+    // Complex scratch for the half length FFT, interleaved re/im
+    float *work;
+    // Power per bin ahead of the log conversion
+    float *power;
+} SPECTROGRAM_WORKER_T;
+
+typedef struct SPECTROGRAM_S
+{
+    // Samples per FFT, output rows hold fft_size/2 bins
+    int fft_size;
+    int bins;
+
+    // Hann window, bit reversal table and twiddles for the fft_size/2 complex FFT
+    float *window;
+    int *bit_reverse;
+    float *twiddles;
+    // Twiddles splitting the packed complex result into the real spectrum
+    float *split_twiddles;
+
+    // 8-bit value = log2(power)*log_scale + log_offset, see spectrogram_set_range()
+    float log_scale;
+    float log_offset;
+
+    int thread_count;
+    SPECTROGRAM_WORKER_T workers[SPECTROGRAM_MAX_THREADS];
+
+    // Current job, workers take contiguous slices of its rows
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned int generation;
+    int pending;
+    int quit;
+    const int16_t *samples;
+    GLubyte *rows;
+    GLsizei row_count;
+    GLsizei row_stride;
+
+    SPECTROGRAM_STATS_T stats;
+} SPECTROGRAM_T;
+
+void spectrogram_init(SPECTROGRAM_T *spec, int fft_size, int thread_count);
+void spectrogram_set_range(SPECTROGRAM_T *spec, float floor_db, float range_db);
+void spectrogram_process(SPECTROGRAM_T *spec, const int16_t *samples, GLubyte *rows, GLsizei row_count, GLsizei row_stride);
+void spectrogram_print_stats(SPECTROGRAM_T *spec);
+void spectrogram_destroy(SPECTROGRAM_T *spec);
+
+#endif
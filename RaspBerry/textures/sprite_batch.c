@@ -0,0 +1,200 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include "sprite_batch.h"
+#include "mesh.h"
+#include "atlas.h"
+#include "tex_alloc.h"
+
+#include "GLES2/gl2.h"
+
+void sprite_batch_init(SPRITE_BATCH_T *batch, ATLAS_T *atlas, GLuint program, GLsizei screen_width, GLsizei screen_height)
+{
+    int i;
+
+    memset(batch, 0, sizeof(SPRITE_BATCH_T));
+    batch->atlas = atlas;
+    batch->screen_width = screen_width;
+    batch->screen_height = screen_height;
+
+    batch->program = program;
+    batch->position_location = glGetAttribLocation(program, "position");
+    batch->tex_coord_location = glGetAttribLocation(program, "tex_coord");
+    batch->tex_location = glGetUniformLocation(program, "tex");
+
+    for(i=0; i<ATLAS_MAX_PAGES; i++) {
+        batch->vertices[i] = malloc(SPRITE_BATCH_MAX*4*sizeof(MESH_VERTEX_T));
+        assert(batch->vertices[i]);
+    }
+
+    // Quad indices never change, build them once
+    GLushort *elements = malloc(SPRITE_BATCH_MAX*6*sizeof(GLushort));
+    assert(elements);
+    for(i=0; i<SPRITE_BATCH_MAX; i++) {
+        elements[i*6 + 0] = i*4 + 2;
+        elements[i*6 + 1] = i*4 + 3;
+        elements[i*6 + 2] = i*4 + 0;
+        elements[i*6 + 3] = i*4 + 0;
+        elements[i*6 + 4] = i*4 + 1;
+        elements[i*6 + 5] = i*4 + 2;
+    }
+    glGenBuffers(1, &batch->ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, SPRITE_BATCH_MAX*6*sizeof(GLushort), elements, GL_STATIC_DRAW);
+    free(elements);
+
+    // Vertex storage is respecified every flush
+    glGenBuffers(1, &batch->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
+    glBufferData(GL_ARRAY_BUFFER, SPRITE_BATCH_MAX*4*sizeof(MESH_VERTEX_T), NULL, GL_STREAM_DRAW);
+}
+
+void sprite_batch_begin(SPRITE_BATCH_T *batch)
+{
+    memset(&batch->frame, 0, sizeof(SPRITE_STATS_T));
+}
+
+// Draws all quads buffered for one page with a single call
+static void flush_page(SPRITE_BATCH_T *batch, int page)
+{
+    int count = batch->counts[page];
+    if(count == 0)
+        return;
+
+    glUseProgram(batch->program);
+
+    // Orphan the previous storage so the upload never waits on an in flight draw
+    glBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
+    glBufferData(GL_ARRAY_BUFFER, SPRITE_BATCH_MAX*4*sizeof(MESH_VERTEX_T), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count*4*sizeof(MESH_VERTEX_T), batch->vertices[page]);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->ebo);
+    glVertexAttribPointer(batch->position_location, 2, GL_SHORT, GL_TRUE, sizeof(MESH_VERTEX_T), 0);
+    glEnableVertexAttribArray(batch->position_location);
+    glVertexAttribPointer(batch->tex_coord_location, 2, GL_SHORT, GL_TRUE, sizeof(MESH_VERTEX_T), (void*)offsetof(MESH_VERTEX_T, tex_coord));
+    glEnableVertexAttribArray(batch->tex_coord_location);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, batch->atlas->pages[page].texture);
+    glUniform1i(batch->tex_location, 0);
+    tex_alloc_touch(batch->atlas->pages[page].texture);
+
+    glDrawElements(GL_TRIANGLES, count*6, GL_UNSIGNED_SHORT, 0);
+
+    batch->counts[page] = 0;
+    batch->frame.draws++;
+}
+
+// Queues a sprite with its top left corner at x,y in screen pixels. Sprites
+// entirely off screen are dropped and ones crossing the edge are clipped to it
+// along with their texture coordinates, mesh_quantise() would otherwise squash
+// the outside vertices onto the edge and distort the image.
+void sprite_batch_add(SPRITE_BATCH_T *batch, const ATLAS_REGION_T *region, GLfloat x, GLfloat y, GLfloat width, GLfloat height)
+{
+    int page = region->page;
+
+    // Screen pixels to normalised device coordinates
+    GLfloat x0 = 2.0f*x/batch->screen_width - 1.0f;
+    GLfloat x1 = 2.0f*(x + width)/batch->screen_width - 1.0f;
+    GLfloat y0 = 1.0f - 2.0f*y/batch->screen_height;
+    GLfloat y1 = 1.0f - 2.0f*(y + height)/batch->screen_height;
+    GLfloat u0 = region->u0, u1 = region->u1;
+    GLfloat v0 = region->v0, v1 = region->v1;
+
+    // x0 is left of x1 and y0 above y1
+    if(x1 <= -1.0f || x0 >= 1.0f || y0 <= -1.0f || y1 >= 1.0f || width <= 0.0f || height <= 0.0f) {
+        batch->frame.culled++;
+        return;
+    }
+
+    if(x0 < -1.0f || x1 > 1.0f || y0 > 1.0f || y1 < -1.0f) {
+        GLfloat du = (u1 - u0)/(x1 - x0), dv = (v1 - v0)/(y1 - y0);
+        if(x0 < -1.0f) {
+            u0 += (-1.0f - x0)*du;
+            x0 = -1.0f;
+        }
+        if(x1 > 1.0f) {
+            u1 -= (x1 - 1.0f)*du;
+            x1 = 1.0f;
+        }
+        if(y0 > 1.0f) {
+            v0 += (1.0f - y0)*dv;
+            y0 = 1.0f;
+        }
+        if(y1 < -1.0f) {
+            v1 -= (y1 + 1.0f)*dv;
+            y1 = -1.0f;
+        }
+        batch->frame.clipped++;
+    }
+
+    if(batch->counts[page] == SPRITE_BATCH_MAX) {
+        flush_page(batch, page);
+        batch->frame.early_flushes++;
+    }
+
+    MESH_VERTEX_T *vertex = &batch->vertices[page][batch->counts[page]*4];
+
+    // Top left
+    vertex[0].position[0] = mesh_quantise(x0);
+    vertex[0].position[1] = mesh_quantise(y0);
+    vertex[0].tex_coord[0] = mesh_quantise(u0);
+    vertex[0].tex_coord[1] = mesh_quantise(v0);
+    // Top right
+    vertex[1].position[0] = mesh_quantise(x1);
+    vertex[1].position[1] = mesh_quantise(y0);
+    vertex[1].tex_coord[0] = mesh_quantise(u1);
+    vertex[1].tex_coord[1] = mesh_quantise(v0);
+    // Bottom right
+    vertex[2].position[0] = mesh_quantise(x1);
+    vertex[2].position[1] = mesh_quantise(y1);
+    vertex[2].tex_coord[0] = mesh_quantise(u1);
+    vertex[2].tex_coord[1] = mesh_quantise(v1);
+    // Bottom left
+    vertex[3].position[0] = mesh_quantise(x0);
+    vertex[3].position[1] = mesh_quantise(y1);
+    vertex[3].tex_coord[0] = mesh_quantise(u0);
+    vertex[3].tex_coord[1] = mesh_quantise(v1);
+
+    batch->counts[page]++;
+    batch->frame.sprites++;
+}
+
+// Flushes every page with queued sprites, one draw per page
+void sprite_batch_end(SPRITE_BATCH_T *batch)
+{
+    int page;
+
+    for(page=0; page<batch->atlas->page_count; page++)
+        flush_page(batch, page);
+
+    batch->stats = batch->frame;
+}
+
+void sprite_batch_print_stats(SPRITE_BATCH_T *batch)
+{
+    int page;
+
+    printf("sprites: %d draws, %d sprites, %d early flushes, %d culled, %d clipped\n",
+           batch->stats.draws, batch->stats.sprites, batch->stats.early_flushes,
+           batch->stats.culled, batch->stats.clipped);
+    for(page=0; page<batch->atlas->page_count; page++) {
+        printf("atlas page %d: %d images, %.1f%% occupied\n", page,
+               batch->atlas->pages[page].image_count, 100.0f*atlas_occupancy(batch->atlas, page));
+    }
+}
+
+void sprite_batch_destroy(SPRITE_BATCH_T *batch)
+{
+    int i;
+
+    for(i=0; i<ATLAS_MAX_PAGES; i++)
+        free(batch->vertices[i]);
+    glDeleteBuffers(1, &batch->vbo);
+    glDeleteBuffers(1, &batch->ebo);
+
+    memset(batch, 0, sizeof(SPRITE_BATCH_T));
+}
@@ -0,0 +1,56 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include "GLES2/gl2.h"
+#include "mesh.h"
+#include "atlas.h"
+
+// Quads buffered per atlas page before a page is flushed early
+#define SPRITE_BATCH_MAX 1024
+
+typedef struct
+{
+    // Last completed frame
+    int draws;
+    int sprites;
+    int early_flushes;
+    // Sprites dropped off screen and trimmed at its edge
+    int culled;
+    int clipped;
+} SPRITE_STATS_T;
+
+typedef struct
+{
+    ATLAS_T *atlas;
+
+    // Screen size sprite positions are given in
+    GLsizei screen_width;
+    GLsizei screen_height;
+
+    // Program with position and tex_coord attributes and a tex sampler
+    GLuint program;
+    GLint position_location;
+    GLint tex_coord_location;
+    GLint tex_location;
+
+    // Streamed vertices and static quad indices
+    GLuint vbo;
+    GLuint ebo;
+
+    // Quads waiting to be drawn, grouped by atlas page
+    MESH_VERTEX_T *vertices[ATLAS_MAX_PAGES];
+    int counts[ATLAS_MAX_PAGES];
+
+    // Current frame counters and last completed frame
+    SPRITE_STATS_T frame;
+    SPRITE_STATS_T stats;
+} SPRITE_BATCH_T;
+
+void sprite_batch_init(SPRITE_BATCH_T *batch, ATLAS_T *atlas, GLuint program, GLsizei screen_width, GLsizei screen_height);
+void sprite_batch_begin(SPRITE_BATCH_T *batch);
+void sprite_batch_add(SPRITE_BATCH_T *batch, const ATLAS_REGION_T *region, GLfloat x, GLfloat y, GLfloat width, GLfloat height);
+void sprite_batch_end(SPRITE_BATCH_T *batch);
+void sprite_batch_print_stats(SPRITE_BATCH_T *batch);
+void sprite_batch_destroy(SPRITE_BATCH_T *batch);
+
+#endif
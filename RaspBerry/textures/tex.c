@@ -8,23 +8,16 @@
 
 #include "bcm_host.h"
 
-// Shader source
-const GLchar* vertexSource =
-    "attribute vec2 position;"
-    "attribute vec2 tex_coord;"
-    "varying vec2 frag_tex_coord;"
-    "void main() {"
-    "   gl_Position = vec4(position, 0.0, 1.0);"
-    "   frag_tex_coord = tex_coord;"
-    "}";
-const GLchar* fragmentSource =
-    "precision mediump float;"
-    "varying vec2 frag_tex_coord;"
-    "uniform sampler2D tex;"
-    "void main() {"
-    "   gl_FragColor = texture2D(tex, frag_tex_coord);"
-    "}";
-    
+#include "shaders/shader_variants.h"
+#include "atlas.h"
+#include "sprite_batch.h"
+#include "tex_alloc.h"
+
+// Images packed into the atlas and sprites drawn each frame
+#define NUM_ICONS 64
+#define NUM_SPRITES 600
+#define ATLAS_PAGE_SIZE 512
+
 typedef struct
 {
     uint32_t screen_width;
@@ -38,29 +31,21 @@ typedef struct
     // Program handle
     GLuint program;
 
-    // Locations
-    GLint position_location;
-    GLint texture_location;
-    GLint sampler_location;
+    // Sprite images packed into atlas pages
+    ATLAS_T atlas;
+    ATLAS_REGION_T regions[NUM_ICONS];
 
-    // Texture handle
-    GLuint textureID;
+    // Per frame quads
+    SPRITE_BATCH_T batch;
 } STATE_T;
 
 static void init_ogl(STATE_T *state);
 static void exit_func(STATE_T *state);
-GLuint create_texture();
+void create_sprites(STATE_T *state);
 
 static volatile int terminate;
 
 #define check() assert(glGetError() == 0)
-static void showlog(GLint shader)
-{
-   // Prints the compile log for a shader
-   char log[1024];
-   glGetShaderInfoLog(shader,sizeof log,NULL,log);
-   printf("%d:shader:\n%s\n", shader, log);
-}
 
 // Description: Sets the display, OpenGL|ES context and screen stuff
 static void init_ogl(STATE_T *state)
@@ -169,148 +154,94 @@ static void exit_func(STATE_T *state)
    printf("close\n");
 } // exit_func()
 
-GLuint create_texture()
+// Packs the 2x2 test image and NUM_ICONS-1 generated icons into the atlas
+void create_sprites(STATE_T *state)
 {
-    // Texture handle
-    GLuint textureID;
+    int i, x, y;
 
     // Image
     GLubyte pixels[] =
     {
-        255,  0,   0,
-          0,255,   0,
-	  0,  0, 255,
-	255, 255,   0
+        255,  0,   0, 255,
+          0,255,   0, 255,
+	  0,  0, 255, 255,
+	255, 255,   0, 255
     };
-    
-    // Pixel packing
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-    // Generate texture
-    glGenTextures(1, &textureID);
-  
-    // Bind texture
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    // Load texture
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 2, 2, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
-
-    // Set filtering modes
-//    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-//    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-    return textureID;
+
+    atlas_init(&state->atlas, ATLAS_PAGE_SIZE);
+    atlas_add(&state->atlas, 2, 2, pixels, &state->regions[0]);
+
+    // Icons of varying size, a colour gradient with a border
+    GLubyte *icon = malloc(64*64*4);
+    for(i=1; i<NUM_ICONS; i++) {
+        GLsizei size = 16 + (i*7) % 48;
+        for(y=0; y<size; y++) {
+            for(x=0; x<size; x++) {
+                GLubyte *texel = &icon[(y*size + x)*4];
+                int border = x == 0 || y == 0 || x == size-1 || y == size-1;
+                texel[0] = border ? 255 : (GLubyte)(i*37 + x*4);
+                texel[1] = border ? 255 : (GLubyte)(i*91 + y*4);
+                texel[2] = border ? 255 : (GLubyte)(i*53);
+                texel[3] = 255;
+            }
+        }
+        int added = atlas_add(&state->atlas, size, size, icon, &state->regions[i]);
+        assert(added);
+    }
+    free(icon);
 }
 
 int main(int argc, char *argv[])
 {
     STATE_T state;
+    int i, frame = 0;
 
     bcm_host_init();
       
     // Start OGLES
     init_ogl(&state);
 
-    // Create and set texture
-    state.textureID = create_texture();
-
-    //////////////////////
-    // Setup vertices
-    /////////////////////
-
-    // Vertices: Pos(x,y) Tex(x,y)
-    float vertices[] = {
-        -0.5f,  0.5f, 0.0f, 0.0f, // Top left
-         0.5f,  0.5f, 1.0f, 0.0f, // Top right
-         0.5f, -0.5f, 1.0f, 1.0f, // Bottom right
-	-0.5f, -0.5f, 0.0f, 1.0f  // Bottom left
-    };
-
-    // Generate vertex buffer
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    // Set buffer
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    // Fill buffer
-    glBufferData(GL_ARRAY_BUFFER, 4*4*sizeof(GLfloat), vertices, GL_STATIC_DRAW);
-
-    // Elements
-    GLubyte elements[] = {
-        2, 3, 0,
-        0, 1, 2
-    };
-    // Generate element buffer
-    GLuint ebo;
-    glGenBuffers(1, &ebo);
-    // Set buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    // Fill buffer
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 2*3*sizeof(GLubyte), elements, GL_STATIC_DRAW);
+    // Create atlas and pack sprite images
+    create_sprites(&state);
 
     /////////////////////
     // Setup shaders
     ////////////////////
 
-    // Compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, NULL);
-    glCompileShader(vertexShader);
+    // Get the RGB shader variant
+    state.program = get_shader_variant(SHADER_FORMAT_RGB, SHADER_COLORMAP_OFF, SHADER_DECIMATE_NONE);
 
-    showlog(vertexShader);   
-
-    // Compile frag shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-    glCompileShader(fragmentShader);
-
-    showlog(fragmentShader);
-
-    // Create shader program
-    state.program = glCreateProgram();
-    glAttachShader(state.program, vertexShader);
-    glAttachShader(state.program, fragmentShader);
-   
-    // Link and use program
-    glLinkProgram(state.program);
-    glUseProgram(state.program);
-
-    // Specify and enable vertex shader position  attribute
-    state.position_location = glGetAttribLocation(state.program, "position");
-    glVertexAttribPointer(state.position_location, 2, GL_FLOAT, GL_FALSE, 4*sizeof(GL_FLOAT), 0);
-    glEnableVertexAttribArray(state.position_location);
-
-    // Specify and enable vertex shader tex_coord attribute
-    state.texture_location = glGetAttribLocation(state.program, "tex_coord");
-    glVertexAttribPointer(state.texture_location, 2, GL_FLOAT, GL_FALSE, 4*sizeof(GL_FLOAT),(void*)(2*sizeof(GL_FLOAT)));
-    glEnableVertexAttribArray(state.texture_location);
-
-    // Set sampler location
-    state.sampler_location = glGetUniformLocation(state.program, "tex");
-
-    // Bind texture to unit 0
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, state.textureID);
-
-    // Set sampler to texture unit 0
-    glUniform1i(state.sampler_location, 0);
-
-    // Clear the screen
-    glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    // Setup sprite batch, it sets up its own vertex and element buffers
+    sprite_batch_init(&state.batch, &state.atlas, state.program, state.screen_width, state.screen_height);
 
     // Event loop
     while(!terminate)
     {
-        // Draw square
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, 0);
+        // Clear the screen
+        glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        // Grid of sprites drifting across the screen
+        sprite_batch_begin(&state.batch);
+        for(i=0; i<NUM_SPRITES; i++) {
+            ATLAS_REGION_T *region = &state.regions[i % NUM_ICONS];
+            GLfloat x = (GLfloat)((i % 30)*64 + frame % 64);
+            GLfloat y = (GLfloat)((i / 30)*54);
+            sprite_batch_add(&state.batch, region, x, y, 48.0f, 48.0f);
+        }
+        sprite_batch_end(&state.batch);
 
         // Swap buffers
         eglSwapBuffers(state.display, state.surface);
+        tex_alloc_next_frame();
+
+        if(++frame % 300 == 0)
+            sprite_batch_print_stats(&state.batch);
     }
 
     // Tidy up
+    sprite_batch_destroy(&state.batch);
+    atlas_destroy(&state.atlas);
     exit_func(&state);
 
     return 0;
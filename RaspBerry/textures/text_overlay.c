@@ -0,0 +1,339 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <assert.h>
+
+#include "text_overlay.h"
+#include "font8x8.h"
+#include "shader_utils.h"
+#include "mesh.h"
+#include "tex_alloc.h"
+
+#include "GLES2/gl2.h"
+
+// Glyph atlas layout, 8x8 glyphs in 10x10 cells so neighbours never bleed
+#define GLYPH_SIZE 8
+#define GLYPH_CELL 10
+#define GLYPH_COLUMNS 16
+#define GLYPH_ROWS ((FONT8X8_COUNT + GLYPH_COLUMNS - 1)/GLYPH_COLUMNS)
+#define GLYPH_ATLAS_WIDTH (GLYPH_COLUMNS*GLYPH_CELL)
+#define GLYPH_ATLAS_HEIGHT (GLYPH_ROWS*GLYPH_CELL)
+
+#define TEXT_MAX_QUADS (TEXT_MAX_STRINGS*TEXT_MAX_LENGTH)
+
+const GLchar* text_vertex_source =
+    "attribute vec2 position;"
+    "attribute vec2 tex_coord;"
+    "varying vec2 frag_tex_coord;"
+    "void main() {"
+    "   gl_Position = vec4(position, 0.0, 1.0);"
+    "   frag_tex_coord = tex_coord;"
+    "}";
+const GLchar* text_fragment_source =
+    "precision mediump float;"
+    "varying vec2 frag_tex_coord;"
+    "uniform sampler2D glyphs;"
+    "uniform vec4 color;"
+    "void main() {"
+    "   gl_FragColor = vec4(color.rgb, color.a*texture2D(glyphs, frag_tex_coord).a);"
+    "}";
+
+static void damage_all(TEXT_OVERLAY_T *overlay);
+static int create_glyph_texture(TEXT_OVERLAY_T *overlay);
+
+// Gives the atlas memory back, the strings are hidden until it returns
+static void evict_glyphs(void *owner, GLuint texture)
+{
+    TEXT_OVERLAY_T *overlay = owner;
+
+    tex_alloc_delete(texture);
+    overlay->glyph_texture = 0;
+    overlay->glyphs_lost = overlay->draws;
+    damage_all(overlay);
+}
+
+// Rasterises every glyph, kept to recreate the texture from
+static void rasterise_glyphs(TEXT_OVERLAY_T *overlay)
+{
+    int glyph, row, bit;
+    GLubyte *pixels = calloc(GLYPH_ATLAS_WIDTH*GLYPH_ATLAS_HEIGHT, 1);
+    assert(pixels);
+
+    for(glyph=0; glyph<FONT8X8_COUNT; glyph++) {
+        int x0 = (glyph % GLYPH_COLUMNS)*GLYPH_CELL + 1;
+        int y0 = (glyph / GLYPH_COLUMNS)*GLYPH_CELL + 1;
+        for(row=0; row<GLYPH_SIZE; row++) {
+            for(bit=0; bit<GLYPH_SIZE; bit++) {
+                if(font8x8[glyph][row] & (1 << bit))
+                    pixels[(y0 + row)*GLYPH_ATLAS_WIDTH + x0 + bit] = 255;
+            }
+        }
+    }
+
+    overlay->glyph_pixels = pixels;
+}
+
+// Loads the atlas texture, returns 0 when texture memory can not spare it
+static int create_glyph_texture(TEXT_OVERLAY_T *overlay)
+{
+    // The atlas stays bound to its own unit so panes keep theirs
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glActiveTexture(GL_TEXTURE0 + TEXT_GLYPH_UNIT);
+    overlay->glyph_texture = tex_alloc_create("glyphs", GL_ALPHA, GLYPH_ATLAS_WIDTH, GLYPH_ATLAS_HEIGHT,
+                                              overlay->glyph_pixels);
+    if(!overlay->glyph_texture)
+        return 0;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    tex_alloc_set_evict(overlay->glyph_texture, evict_glyphs, overlay);
+
+    return 1;
+}
+
+void text_overlay_init(TEXT_OVERLAY_T *overlay, GLsizei screen_width, GLsizei screen_height)
+{
+    int i;
+
+    memset(overlay, 0, sizeof(TEXT_OVERLAY_T));
+    overlay->screen_width = screen_width;
+    overlay->screen_height = screen_height;
+
+    rasterise_glyphs(overlay);
+    if(!create_glyph_texture(overlay))
+        printf("Text overlay: no texture memory for glyphs, text hidden\n");
+
+    overlay->program = load_program(text_vertex_source, text_fragment_source);
+    overlay->position_location = glGetAttribLocation(overlay->program, "position");
+    overlay->tex_coord_location = glGetAttribLocation(overlay->program, "tex_coord");
+    overlay->glyphs_location = glGetUniformLocation(overlay->program, "glyphs");
+    overlay->color_location = glGetUniformLocation(overlay->program, "color");
+    overlay->color[0] = 1.0f;
+    overlay->color[1] = 1.0f;
+    overlay->color[2] = 1.0f;
+    overlay->color[3] = 1.0f;
+
+    // Unused quads stay zeroed, which makes them degenerate
+    overlay->vertices = calloc(TEXT_MAX_QUADS*4, sizeof(MESH_VERTEX_T));
+    assert(overlay->vertices);
+
+    GLushort *elements = malloc(TEXT_MAX_QUADS*6*sizeof(GLushort));
+    assert(elements);
+    for(i=0; i<TEXT_MAX_QUADS; i++) {
+        elements[i*6 + 0] = i*4 + 2;
+        elements[i*6 + 1] = i*4 + 3;
+        elements[i*6 + 2] = i*4 + 0;
+        elements[i*6 + 3] = i*4 + 0;
+        elements[i*6 + 4] = i*4 + 1;
+        elements[i*6 + 5] = i*4 + 2;
+    }
+    glGenBuffers(1, &overlay->ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, overlay->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, TEXT_MAX_QUADS*6*sizeof(GLushort), elements, GL_STATIC_DRAW);
+    free(elements);
+
+    glGenBuffers(1, &overlay->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, overlay->vbo);
+    glBufferData(GL_ARRAY_BUFFER, TEXT_MAX_QUADS*4*sizeof(MESH_VERTEX_T), overlay->vertices, GL_DYNAMIC_DRAW);
+}
+
+// Rebuilds the quads owned by slot from its string
+static void build_string(TEXT_OVERLAY_T *overlay, int slot)
+{
+    TEXT_STRING_T *string = &overlay->strings[slot];
+    MESH_VERTEX_T *vertex = &overlay->vertices[slot*TEXT_MAX_LENGTH*4];
+    GLfloat size = GLYPH_SIZE*string->scale;
+    int i;
+
+    memset(vertex, 0, TEXT_MAX_LENGTH*4*sizeof(MESH_VERTEX_T));
+
+    for(i=0; i<string->length; i++, vertex += 4) {
+        int glyph = (unsigned char)string->text[i] - FONT8X8_FIRST;
+        if(glyph < 0 || glyph >= FONT8X8_COUNT)
+            glyph = '?' - FONT8X8_FIRST;
+
+        // Screen pixels to normalised device coordinates
+        GLfloat x = string->x + i*size;
+        GLfloat x0 = 2.0f*x/overlay->screen_width - 1.0f;
+        GLfloat x1 = 2.0f*(x + size)/overlay->screen_width - 1.0f;
+        GLfloat y0 = 1.0f - 2.0f*string->y/overlay->screen_height;
+        GLfloat y1 = 1.0f - 2.0f*(string->y + size)/overlay->screen_height;
+
+        // Glyph cell in the atlas
+        GLfloat u0 = (GLfloat)((glyph % GLYPH_COLUMNS)*GLYPH_CELL + 1)/GLYPH_ATLAS_WIDTH;
+        GLfloat v0 = (GLfloat)((glyph / GLYPH_COLUMNS)*GLYPH_CELL + 1)/GLYPH_ATLAS_HEIGHT;
+        GLfloat u1 = u0 + (GLfloat)GLYPH_SIZE/GLYPH_ATLAS_WIDTH;
+        GLfloat v1 = v0 + (GLfloat)GLYPH_SIZE/GLYPH_ATLAS_HEIGHT;
+
+        // Top left, top right, bottom right, bottom left
+        vertex[0].position[0] = mesh_quantise(x0);
+        vertex[0].position[1] = mesh_quantise(y0);
+        vertex[0].tex_coord[0] = mesh_quantise(u0);
+        vertex[0].tex_coord[1] = mesh_quantise(v0);
+        vertex[1].position[0] = mesh_quantise(x1);
+        vertex[1].position[1] = mesh_quantise(y0);
+        vertex[1].tex_coord[0] = mesh_quantise(u1);
+        vertex[1].tex_coord[1] = mesh_quantise(v0);
+        vertex[2].position[0] = mesh_quantise(x1);
+        vertex[2].position[1] = mesh_quantise(y1);
+        vertex[2].tex_coord[0] = mesh_quantise(u1);
+        vertex[2].tex_coord[1] = mesh_quantise(v1);
+        vertex[3].position[0] = mesh_quantise(x0);
+        vertex[3].position[1] = mesh_quantise(y1);
+        vertex[3].tex_coord[0] = mesh_quantise(u0);
+        vertex[3].tex_coord[1] = mesh_quantise(v1);
+    }
+
+    overlay->stats.rebuilds++;
+    overlay->dirty = 1;
+}
+
+// Grows the damage rectangle to cover string
+static void damage_string(TEXT_OVERLAY_T *overlay, const TEXT_STRING_T *string)
+{
+    GLfloat size = GLYPH_SIZE*string->scale;
+    GLfloat x1 = string->x + string->length*size;
+    GLfloat y1 = string->y + size;
+
+    if(!string->length)
+        return;
+
+    if(overlay->damage[2] <= overlay->damage[0]) {
+        overlay->damage[0] = string->x;
+        overlay->damage[1] = string->y;
+        overlay->damage[2] = x1;
+        overlay->damage[3] = y1;
+        return;
+    }
+
+    if(string->x < overlay->damage[0])
+        overlay->damage[0] = string->x;
+    if(string->y < overlay->damage[1])
+        overlay->damage[1] = string->y;
+    if(x1 > overlay->damage[2])
+        overlay->damage[2] = x1;
+    if(y1 > overlay->damage[3])
+        overlay->damage[3] = y1;
+}
+
+// Every string needs repainting when the glyphs go or come back
+static void damage_all(TEXT_OVERLAY_T *overlay)
+{
+    int slot;
+
+    for(slot=0; slot<TEXT_MAX_STRINGS; slot++)
+        damage_string(overlay, &overlay->strings[slot]);
+}
+
+// Sets the string shown in slot with its top left corner at x,y in screen
+// pixels, glyphs are 8*scale pixels square. Unchanged strings cost a compare.
+void text_overlay_set(TEXT_OVERLAY_T *overlay, int slot, GLfloat x, GLfloat y, GLfloat scale, const char *format, ...)
+{
+    char text[TEXT_MAX_LENGTH+1];
+    va_list args;
+
+    assert(slot >= 0 && slot < TEXT_MAX_STRINGS);
+    TEXT_STRING_T *string = &overlay->strings[slot];
+
+    va_start(args, format);
+    vsnprintf(text, sizeof text, format, args);
+    va_end(args);
+
+    if(string->x == x && string->y == y && string->scale == scale && strcmp(string->text, text) == 0)
+        return;
+
+    // Both where the string was and where it is now need repainting
+    damage_string(overlay, string);
+
+    strcpy(string->text, text);
+    string->length = strlen(text);
+    string->x = x;
+    string->y = y;
+    string->scale = scale;
+
+    damage_string(overlay, string);
+    build_string(overlay, slot);
+}
+
+// Copies out and clears the area changed by text_overlay_set(), returns 0 if nothing changed
+int text_overlay_take_damage(TEXT_OVERLAY_T *overlay, GLfloat *rect)
+{
+    if(overlay->damage[2] <= overlay->damage[0])
+        return 0;
+
+    memcpy(rect, overlay->damage, sizeof(overlay->damage));
+    memset(overlay->damage, 0, sizeof(overlay->damage));
+    return 1;
+}
+
+// Draws every string in one call
+void text_overlay_draw(TEXT_OVERLAY_T *overlay)
+{
+    int slot, used = 0;
+
+    for(slot=0; slot<TEXT_MAX_STRINGS; slot++) {
+        if(overlay->strings[slot].length)
+            used = slot + 1;
+    }
+    if(used == 0)
+        return;
+
+    // Glyphs evicted for memory come back once there is room again
+    overlay->draws++;
+    if(!overlay->glyph_texture) {
+        if(overlay->draws - overlay->glyphs_lost < TEXT_GLYPH_RETRY)
+            return;
+
+        GLint active_unit;
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &active_unit);
+        int created = create_glyph_texture(overlay);
+        glActiveTexture(active_unit);
+        if(!created) {
+            overlay->glyphs_lost = overlay->draws;
+            return;
+        }
+        damage_all(overlay);
+    }
+    tex_alloc_touch(overlay->glyph_texture);
+
+    glUseProgram(overlay->program);
+
+    glBindBuffer(GL_ARRAY_BUFFER, overlay->vbo);
+    if(overlay->dirty) {
+        // Orphan so the upload does not wait on last frame's draw
+        glBufferData(GL_ARRAY_BUFFER, TEXT_MAX_QUADS*4*sizeof(MESH_VERTEX_T), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, used*TEXT_MAX_LENGTH*4*sizeof(MESH_VERTEX_T), overlay->vertices);
+        overlay->dirty = 0;
+        overlay->stats.uploads++;
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, overlay->ebo);
+    glVertexAttribPointer(overlay->position_location, 2, GL_SHORT, GL_TRUE, sizeof(MESH_VERTEX_T),
+                          (void*)offsetof(MESH_VERTEX_T, position));
+    glEnableVertexAttribArray(overlay->position_location);
+    glVertexAttribPointer(overlay->tex_coord_location, 2, GL_SHORT, GL_TRUE, sizeof(MESH_VERTEX_T),
+                          (void*)offsetof(MESH_VERTEX_T, tex_coord));
+    glEnableVertexAttribArray(overlay->tex_coord_location);
+
+    glUniform1i(overlay->glyphs_location, TEXT_GLYPH_UNIT);
+    glUniform4fv(overlay->color_location, 1, overlay->color);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDrawElements(GL_TRIANGLES, used*TEXT_MAX_LENGTH*6, GL_UNSIGNED_SHORT, 0);
+    glDisable(GL_BLEND);
+}
+
+void text_overlay_destroy(TEXT_OVERLAY_T *overlay)
+{
+    if(overlay->glyph_texture)
+        tex_alloc_delete(overlay->glyph_texture);
+    free(overlay->glyph_pixels);
+    glDeleteBuffers(1, &overlay->vbo);
+    glDeleteBuffers(1, &overlay->ebo);
+    free(overlay->vertices);
+    memset(overlay, 0, sizeof(TEXT_OVERLAY_T));
+}
@@ -0,0 +1,73 @@
+#ifndef TEXT_OVERLAY_H
+#define TEXT_OVERLAY_H
+
+#include "GLES2/gl2.h"
+#include "mesh.h"
+
+// Fixed string slots, each with room for TEXT_MAX_LENGTH characters
+#define TEXT_MAX_STRINGS 16
+#define TEXT_MAX_LENGTH 64
+
+// Texture unit the glyph atlas is bound to
+#define TEXT_GLYPH_UNIT 4
+
+// Draws between attempts to bring back glyphs evicted for texture memory
+#define TEXT_GLYPH_RETRY 300
+
+typedef struct
+{
+    char text[TEXT_MAX_LENGTH+1];
+    GLfloat x;
+    GLfloat y;
+    GLfloat scale;
+    int length;
+} TEXT_STRING_T;
+
+typedef struct
+{
+    // Strings rebuilt and vertex uploads over the overlay's lifetime
+    unsigned long rebuilds;
+    unsigned long uploads;
+} TEXT_STATS_T;
+
+typedef struct
+{
+    GLsizei screen_width;
+    GLsizei screen_height;
+
+    // Glyphs rasterised once into a GL_ALPHA atlas. The texture gives way
+    // under memory pressure, strings are hidden until it is recreated.
+    GLubyte *glyph_pixels;
+    GLuint glyph_texture;
+    unsigned long draws;
+    unsigned long glyphs_lost;
+
+    GLuint program;
+    GLint position_location;
+    GLint tex_coord_location;
+    GLint glyphs_location;
+    GLint color_location;
+    GLfloat color[4];
+
+    TEXT_STRING_T strings[TEXT_MAX_STRINGS];
+
+    // Quads for every slot, slot i owns quads [i*TEXT_MAX_LENGTH, (i+1)*TEXT_MAX_LENGTH)
+    MESH_VERTEX_T *vertices;
+    GLuint vbo;
+    GLuint ebo;
+    int dirty;
+
+    // Screen pixels covered by strings changed since text_overlay_take_damage(),
+    // x0 y0 x1 y1 from the top left, empty while x1 <= x0
+    GLfloat damage[4];
+
+    TEXT_STATS_T stats;
+} TEXT_OVERLAY_T;
+
+void text_overlay_init(TEXT_OVERLAY_T *overlay, GLsizei screen_width, GLsizei screen_height);
+void text_overlay_set(TEXT_OVERLAY_T *overlay, int slot, GLfloat x, GLfloat y, GLfloat scale, const char *format, ...);
+void text_overlay_draw(TEXT_OVERLAY_T *overlay);
+int text_overlay_take_damage(TEXT_OVERLAY_T *overlay, GLfloat *rect);
+void text_overlay_destroy(TEXT_OVERLAY_T *overlay);
+
+#endif
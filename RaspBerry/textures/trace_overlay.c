@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "trace_overlay.h"
+#include "shader_utils.h"
+
+#include "GLES2/gl2.h"
+
+// column.x is the texture u where the output column starts and column.y
+// picks the minimum (0) or maximum (1) of the taps across the column. TAPS
+// is defined ahead of this source with the taps the decimation ratio needs.
+static const GLchar* trace_vtf_vertex_source =
+    "attribute vec2 column;"
+    "uniform sampler2D tex;"
+    "uniform float row_v;"
+    "uniform float tap_step;"
+    "uniform float column_step;"
+    "uniform vec4 rect;"
+    "void main() {"
+    "   vec2 range = vec2(1.0, 0.0);"
+    "   for(int i=0; i<TAPS; i++) {"
+    "       float v = texture2D(tex, vec2(column.x + (float(i) + 0.5)*tap_step, row_v)).r;"
+    "       range = vec2(min(range.x, v), max(range.y, v));"
+    "   }"
+    "   float value = mix(range.x, range.y, column.y);"
+    "   gl_Position = vec4(mix(rect.x, rect.z, column.x + 0.5*column_step), mix(rect.y, rect.w, value), 0.0, 1.0);"
+    "}";
+
+// Values come from a normalised byte attribute instead of the texture
+static const GLchar* trace_attribute_vertex_source =
+    "attribute vec2 column;"
+    "attribute float value;"
+    "uniform float column_step;"
+    "uniform vec4 rect;"
+    "void main() {"
+    "   gl_Position = vec4(mix(rect.x, rect.z, column.x + 0.5*column_step), mix(rect.y, rect.w, value), 0.0, 1.0);"
+    "}";
+
+static const GLchar* trace_fragment_source =
+    "precision mediump float;"
+    "uniform vec4 color;"
+    "void main() {"
+    "   gl_FragColor = color;"
+    "}";
+
+// Sets up a trace of rows tex_width wide drawn with at most screen_columns columns
+void trace_overlay_init(TRACE_OVERLAY_T *trace, GLsizei tex_width, GLsizei tex_height, GLsizei screen_columns, int allow_vtf)
+{
+    GLsizei i;
+    GLint vertex_units = 0;
+    char vertex_source[1024];
+
+    memset(trace, 0, sizeof(TRACE_OVERLAY_T));
+    trace->tex_width = tex_width;
+    trace->tex_height = tex_height;
+
+    // Rows wider than the screen are reduced to a min/max pair per column,
+    // at most TRACE_MAX_TAPS pixels wide
+    trace->decimate = tex_width > screen_columns;
+    trace->columns = trace->decimate ? screen_columns : tex_width;
+    if(trace->columns < (tex_width + TRACE_MAX_TAPS - 1)/TRACE_MAX_TAPS)
+        trace->columns = (tex_width + TRACE_MAX_TAPS - 1)/TRACE_MAX_TAPS;
+    trace->taps = (tex_width + trace->columns - 1)/trace->columns;
+    trace->vertex_count = trace->decimate ? 2*trace->columns : trace->columns;
+
+    // Vertex texture fetch is optional in GLES2
+    glGetIntegerv(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, &vertex_units);
+    trace->use_vtf = allow_vtf && vertex_units > 0;
+
+    // Taps at most a pixel apart reach every pixel of the column
+    if(trace->use_vtf) {
+        snprintf(vertex_source, sizeof vertex_source, "#define TAPS %d\n%s", trace->taps, trace_vtf_vertex_source);
+        trace->program = load_program(vertex_source, trace_fragment_source);
+    }
+    else
+        trace->program = load_program(trace_attribute_vertex_source, trace_fragment_source);
+
+    trace->column_location = glGetAttribLocation(trace->program, "column");
+    trace->value_location = glGetAttribLocation(trace->program, "value");
+    trace->tex_location = glGetUniformLocation(trace->program, "tex");
+    trace->row_v_location = glGetUniformLocation(trace->program, "row_v");
+    trace->tap_step_location = glGetUniformLocation(trace->program, "tap_step");
+    trace->column_step_location = glGetUniformLocation(trace->program, "column_step");
+    trace->rect_location = glGetUniformLocation(trace->program, "rect");
+    trace->color_location = glGetUniformLocation(trace->program, "color");
+
+    // Column start and min/max select for every vertex, these never change
+    GLfloat *columns = malloc(trace->vertex_count*2*sizeof(GLfloat));
+    assert(columns);
+    for(i=0; i<trace->vertex_count; i++) {
+        GLsizei column = trace->decimate ? i/2 : i;
+        columns[i*2 + 0] = (GLfloat)column/trace->columns;
+        columns[i*2 + 1] = trace->decimate ? (GLfloat)(i & 1) : 0.0f;
+    }
+    glGenBuffers(1, &trace->column_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, trace->column_vbo);
+    glBufferData(GL_ARRAY_BUFFER, trace->vertex_count*2*sizeof(GLfloat), columns, GL_STATIC_DRAW);
+    free(columns);
+
+    if(!trace->use_vtf) {
+        trace->values = malloc(trace->vertex_count);
+        assert(trace->values);
+        memset(trace->values, 0, trace->vertex_count);
+        glGenBuffers(1, &trace->value_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, trace->value_vbo);
+        glBufferData(GL_ARRAY_BUFFER, trace->vertex_count, trace->values, GL_STREAM_DRAW);
+    }
+
+    trace_overlay_set_rect(trace, -1.0f, -1.0f, 1.0f, 1.0f);
+    trace->color[0] = 0.2f;
+    trace->color[1] = 1.0f;
+    trace->color[2] = 0.2f;
+    trace->color[3] = 1.0f;
+}
+
+void trace_overlay_set_rect(TRACE_OVERLAY_T *trace, GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1)
+{
+    trace->rect[0] = x0;
+    trace->rect[1] = y0;
+    trace->rect[2] = x1;
+    trace->rect[3] = y1;
+}
+
+// Records the most recent row, row_pixels is only read on the attribute path
+void trace_overlay_update(TRACE_OVERLAY_T *trace, GLsizei row, const GLubyte *row_pixels)
+{
+    GLsizei column, i;
+
+    trace->row = row;
+
+    // The vertex shader reads the row straight from the pane texture
+    if(trace->use_vtf)
+        return;
+
+    if(!trace->decimate) {
+        // One value per pixel, the row itself is the attribute data
+        glBindBuffer(GL_ARRAY_BUFFER, trace->value_vbo);
+        glBufferData(GL_ARRAY_BUFFER, trace->vertex_count, row_pixels, GL_STREAM_DRAW);
+        return;
+    }
+
+    // Min/max envelope per column
+    for(column=0; column<trace->columns; column++) {
+        GLsizei start = column*trace->tex_width/trace->columns;
+        GLsizei end = (column+1)*trace->tex_width/trace->columns;
+        GLubyte lo = 255, hi = 0;
+        for(i=start; i<end; i++) {
+            if(row_pixels[i] < lo)
+                lo = row_pixels[i];
+            if(row_pixels[i] > hi)
+                hi = row_pixels[i];
+        }
+        trace->values[column*2 + 0] = lo;
+        trace->values[column*2 + 1] = hi;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, trace->value_vbo);
+    glBufferData(GL_ARRAY_BUFFER, trace->vertex_count, trace->values, GL_STREAM_DRAW);
+}
+
+// Draws the latest row as a line strip, tex_unit holds the pane texture
+void trace_overlay_draw(TRACE_OVERLAY_T *trace, GLint tex_unit)
+{
+    glUseProgram(trace->program);
+
+    glUniform4fv(trace->rect_location, 1, trace->rect);
+    glUniform4fv(trace->color_location, 1, trace->color);
+    glUniform1f(trace->column_step_location, 1.0f/trace->columns);
+
+    glBindBuffer(GL_ARRAY_BUFFER, trace->column_vbo);
+    glVertexAttribPointer(trace->column_location, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(trace->column_location);
+
+    if(trace->use_vtf) {
+        glUniform1i(trace->tex_location, tex_unit);
+        glUniform1f(trace->row_v_location, (trace->row + 0.5f)/trace->tex_height);
+        glUniform1f(trace->tap_step_location, 1.0f/(trace->columns*trace->taps));
+    }
+    else {
+        glBindBuffer(GL_ARRAY_BUFFER, trace->value_vbo);
+        glVertexAttribPointer(trace->value_location, 1, GL_UNSIGNED_BYTE, GL_TRUE, 0, 0);
+        glEnableVertexAttribArray(trace->value_location);
+    }
+
+    glDrawArrays(GL_LINE_STRIP, 0, trace->vertex_count);
+
+    // Leave no arrays enabled that the pane program does not source
+    glDisableVertexAttribArray(trace->column_location);
+    if(!trace->use_vtf)
+        glDisableVertexAttribArray(trace->value_location);
+}
+
+void trace_overlay_destroy(TRACE_OVERLAY_T *trace)
+{
+    glDeleteBuffers(1, &trace->column_vbo);
+    if(trace->value_vbo)
+        glDeleteBuffers(1, &trace->value_vbo);
+    free(trace->values);
+    memset(trace, 0, sizeof(TRACE_OVERLAY_T));
+}
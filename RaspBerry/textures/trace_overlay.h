@@ -0,0 +1,55 @@
+#ifndef TRACE_OVERLAY_H
+#define TRACE_OVERLAY_H
+
+#include "GLES2/gl2.h"
+
+// Most taps per output column when the row is decimated in the vertex shader.
+// Wider rows get more columns than the screen has so no pixel is skipped.
+#define TRACE_MAX_TAPS 16
+
+typedef struct
+{
+    // Non zero when the vertex shader reads the row from the pane texture,
+    // otherwise row values are passed in a compact byte attribute buffer
+    int use_vtf;
+
+    GLsizei tex_width;
+    GLsizei tex_height;
+
+    // Output columns, less than tex_width when the row is decimated
+    GLsizei columns;
+    int decimate;
+    // Texture reads per column on the VTF path, enough to cover every pixel
+    int taps;
+    GLsizei vertex_count;
+
+    // Overlay rectangle in normalised device coordinates
+    GLfloat rect[4];
+    GLfloat color[4];
+
+    // Row drawn by the next trace_overlay_draw()
+    GLsizei row;
+
+    GLuint program;
+    GLint column_location;
+    GLint value_location;
+    GLint tex_location;
+    GLint row_v_location;
+    GLint tap_step_location;
+    GLint column_step_location;
+    GLint rect_location;
+    GLint color_location;
+
+    // Static column positions and streamed byte values
+    GLuint column_vbo;
+    GLuint value_vbo;
+    GLubyte *values;
+} TRACE_OVERLAY_T;
+
+void trace_overlay_init(TRACE_OVERLAY_T *trace, GLsizei tex_width, GLsizei tex_height, GLsizei screen_columns, int allow_vtf);
+void trace_overlay_set_rect(TRACE_OVERLAY_T *trace, GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1);
+void trace_overlay_update(TRACE_OVERLAY_T *trace, GLsizei row, const GLubyte *row_pixels);
+void trace_overlay_draw(TRACE_OVERLAY_T *trace, GLint tex_unit);
+void trace_overlay_destroy(TRACE_OVERLAY_T *trace);
+
+#endif
@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "upload_ring.h"
+#include "gles3_compat.h"
+#include "egl_utils.h"
+#include "shader_utils.h"
+
+#include "GLES2/gl2.h"
+
+// Give up waiting on a fence after one second
+#define UPLOAD_FENCE_TIMEOUT_NS 1000000000ull
+
+static GLsizei format_bytes(GLenum format)
+{
+    switch(format) {
+        case GL_LUMINANCE_ALPHA:
+            return 2;
+        case GL_RGB:
+            return 3;
+        case GL_RGBA:
+            return 4;
+        default:
+            return 1;
+    }
+}
+
+void upload_ring_init(UPLOAD_RING_T *ring, int gles_version, GLenum format, GLsizei width, GLsizei max_rows)
+{
+    int i;
+
+    memset(ring, 0, sizeof(UPLOAD_RING_T));
+
+    ring->format = format;
+    ring->bytes_per_pixel = format_bytes(format);
+    ring->width = width;
+    ring->max_rows = max_rows;
+    ring->slot_size = (GLsizeiptr)width*max_rows*ring->bytes_per_pixel;
+    ring->use_pbo = gles_version >= 3;
+
+    ring->unpack_subimage = gles_version >= 3 || gl_has_extension("GL_EXT_unpack_subimage");
+
+    if(!ring->use_pbo) {
+        // GLES2: producers write into client memory which glTexSubImage2D copies from
+        ring->staging = malloc(ring->slot_size);
+        assert(ring->staging);
+        return;
+    }
+
+    // Allocate backing store for each pixel unpack buffer up front
+    glGenBuffers(UPLOAD_RING_SLOTS, ring->pbos);
+    for(i=0; i<UPLOAD_RING_SLOTS; i++) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring->pbos[i]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, ring->slot_size, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    check();
+}
+
+GLubyte *upload_ring_map(UPLOAD_RING_T *ring, GLsizei rows)
+{
+    assert(rows <= ring->max_rows);
+    assert(ring->mapped == NULL);
+
+    if(!ring->use_pbo) {
+        ring->mapped = ring->staging;
+        return ring->mapped;
+    }
+
+    // Wait until the GPU has finished the transfer last sourced from this slot
+    GL3_SYNC_T fence = ring->fences[ring->slot];
+    if(fence) {
+        GLenum status = gles3.client_wait_sync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UPLOAD_FENCE_TIMEOUT_NS);
+        if(status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+            printf("upload_ring: fence wait failed on slot %d\n", ring->slot);
+        gles3.delete_sync(fence);
+        ring->fences[ring->slot] = NULL;
+    }
+
+    // The fence already synchronised us, so map without letting the driver stall again
+    GLsizeiptr length = (GLsizeiptr)ring->width*rows*ring->bytes_per_pixel;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring->pbos[ring->slot]);
+    ring->mapped = gles3.map_buffer_range(GL_PIXEL_UNPACK_BUFFER, 0, length,
+                                          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    assert(ring->mapped);
+
+    return ring->mapped;
+}
+
+// Upload the rows written into the mapped block to the texture bound on tex_unit
+void upload_ring_submit(UPLOAD_RING_T *ring, GLenum tex_unit, GLsizei row, GLsizei rows)
+{
+    assert(ring->mapped);
+
+    glActiveTexture(tex_unit);
+
+    if(!ring->use_pbo) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, ring->width, rows, ring->format, GL_UNSIGNED_BYTE, ring->mapped);
+        ring->mapped = NULL;
+        return;
+    }
+
+    // With an unpack buffer bound the pixel pointer is an offset into it
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring->pbos[ring->slot]);
+    gles3.unmap_buffer(GL_PIXEL_UNPACK_BUFFER);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, ring->width, rows, ring->format, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    ring->fences[ring->slot] = gles3.fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ring->mapped = NULL;
+    ring->slot = (ring->slot + 1) % UPLOAD_RING_SLOTS;
+}
+
+// Uploads rows that sit pitch bytes apart in client memory, such as the
+// payload of padded producer frames, to the texture bound on tex_unit.
+// pixels is the first byte of the first row.
+void upload_ring_submit_strided(UPLOAD_RING_T *ring, GLenum tex_unit, GLsizei row, GLsizei rows,
+                                const GLubyte *pixels, GLsizei pitch)
+{
+    GLsizei row_size = ring->width*ring->bytes_per_pixel;
+    GLsizei i, block;
+
+    assert(pitch >= row_size);
+    assert(ring->mapped == NULL);
+
+    if(pitch == row_size) {
+        glActiveTexture(tex_unit);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, ring->width, rows, ring->format, GL_UNSIGNED_BYTE, pixels);
+        return;
+    }
+
+    // The driver steps over the padding itself, the rows are copied once.
+    // Skipping into the frame is done by offsetting pixels, which is what
+    // the SKIP_PIXELS and SKIP_ROWS parameters would do with it.
+    if(ring->unpack_subimage && pitch % ring->bytes_per_pixel == 0) {
+        glActiveTexture(tex_unit);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch/ring->bytes_per_pixel);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, ring->width, rows, ring->format, GL_UNSIGNED_BYTE, pixels);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        ring->strided_rows += rows;
+        return;
+    }
+
+    // Gather into the ring a block at a time, on GLES3 straight into the PBO
+    for(i=0; i<rows; i+=block) {
+        block = rows - i < ring->max_rows ? rows - i : ring->max_rows;
+
+        GLubyte *dst = upload_ring_map(ring, block);
+        const GLubyte *src = pixels + (size_t)i*pitch;
+        GLsizei r;
+        for(r=0; r<block; r++)
+            memcpy(dst + (size_t)r*row_size, src + (size_t)r*pitch, row_size);
+        upload_ring_submit(ring, tex_unit, row + i, block);
+    }
+    ring->gathered_rows += rows;
+}
+
+void upload_ring_print_stats(UPLOAD_RING_T *ring)
+{
+    if(!ring->strided_rows && !ring->gathered_rows)
+        return;
+
+    printf("Padded rows: %llu uploaded in place, %llu gathered (unpack subimage %s)\n",
+           ring->strided_rows, ring->gathered_rows, ring->unpack_subimage ? "supported" : "unsupported");
+}
+
+void upload_ring_destroy(UPLOAD_RING_T *ring)
+{
+    int i;
+
+    if(ring->use_pbo) {
+        for(i=0; i<UPLOAD_RING_SLOTS; i++) {
+            if(ring->fences[i])
+                gles3.delete_sync(ring->fences[i]);
+        }
+        glDeleteBuffers(UPLOAD_RING_SLOTS, ring->pbos);
+    }
+
+    free(ring->staging);
+    memset(ring, 0, sizeof(UPLOAD_RING_T));
+}
@@ -0,0 +1,52 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include "GLES2/gl2.h"
+#include "gles3_compat.h"
+
+// Number of pixel unpack buffers cycled through, two gives double buffering
+#define UPLOAD_RING_SLOTS 2
+
+typedef struct
+{
+    // Non zero when uploads go through pixel unpack buffers (GLES3)
+    int use_pbo;
+
+    // Upload format
+    GLenum format;
+    GLsizei bytes_per_pixel;
+
+    // Largest block of rows that can be mapped at once
+    GLsizei width;
+    GLsizei max_rows;
+    GLsizeiptr slot_size;
+
+    // GLES3 path: one PBO and fence per slot
+    GLuint pbos[UPLOAD_RING_SLOTS];
+    GL3_SYNC_T fences[UPLOAD_RING_SLOTS];
+    int slot;
+
+    // GLES2 path: client side staging memory
+    GLubyte *staging;
+
+    // Pointer handed out by upload_ring_map()
+    GLubyte *mapped;
+
+    // Non zero when GL_UNPACK_ROW_LENGTH is available, core in GLES3 and
+    // GL_EXT_unpack_subimage on GLES2, so padded rows upload in place
+    int unpack_subimage;
+
+    // Rows of padded producer frames uploaded in place and gathered first
+    unsigned long long strided_rows;
+    unsigned long long gathered_rows;
+} UPLOAD_RING_T;
+
+void upload_ring_init(UPLOAD_RING_T *ring, int gles_version, GLenum format, GLsizei width, GLsizei max_rows);
+GLubyte *upload_ring_map(UPLOAD_RING_T *ring, GLsizei rows);
+void upload_ring_submit(UPLOAD_RING_T *ring, GLenum tex_unit, GLsizei row, GLsizei rows);
+void upload_ring_submit_strided(UPLOAD_RING_T *ring, GLenum tex_unit, GLsizei row, GLsizei rows,
+                                const GLubyte *pixels, GLsizei pitch);
+void upload_ring_print_stats(UPLOAD_RING_T *ring);
+void upload_ring_destroy(UPLOAD_RING_T *ring);
+
+#endif
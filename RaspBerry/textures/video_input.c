@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "video_input.h"
+#include "tex_alloc.h"
+#include "gles3_compat.h"
+
+#include "GLES2/gl2.h"
+
+// Give up waiting on a fence after one second
+#define VIDEO_FENCE_TIMEOUT_NS 1000000000ull
+
+static double video_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Planes are what is drawn in place of pane 0, they go over the budget rather than fail
+static GLuint create_plane(const char *name, GLenum format, GLsizei width, GLsizei height, const GLubyte *pixels)
+{
+    GLuint texture = tex_alloc_create_required(name, format, width, height, pixels);
+    if(!texture)
+        return 0;
+
+    // Chroma is upsampled by the filtering, video is not pixel data like the panes
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    return texture;
+}
+
+// Binds the front buffer's planes, Y on y_unit and chroma from SHADER_CHROMA_UNIT
+static void bind_front(VIDEO_INPUT_T *video)
+{
+    VIDEO_BUFFER_T *buffer = &video->buffers[video->front];
+    int i;
+
+    glActiveTexture(video->y_unit);
+    glBindTexture(GL_TEXTURE_2D, buffer->planes[0]);
+    for(i=1; i<3 && buffer->planes[i]; i++) {
+        glActiveTexture(GL_TEXTURE0 + SHADER_CHROMA_UNIT + i - 1);
+        glBindTexture(GL_TEXTURE_2D, buffer->planes[i]);
+    }
+}
+
+// Frames are width x height with 4:2:0 chroma, drawn with Y on y_unit.
+// Returns 0, with nothing left allocated, when the GPU has no memory for the
+// planes.
+int video_input_init(VIDEO_INPUT_T *video, int gles_version, VIDEO_FORMAT_T format, GLsizei width, GLsizei height,
+                     GLenum y_unit)
+{
+    int i;
+
+    memset(video, 0, sizeof(VIDEO_INPUT_T));
+    video->format = format;
+    video->width = width;
+    video->height = height;
+    video->chroma_width = (width + 1)/2;
+    video->chroma_height = (height + 1)/2;
+    video->y_unit = y_unit;
+    video->use_fences = gles_version >= 3;
+
+    // Planes start black, with neutral chroma, until the first frame arrives
+    size_t chroma_bytes = (size_t)video->chroma_width*video->chroma_height*2;
+    GLubyte *black = calloc((size_t)width*height, 1);
+    GLubyte *neutral = malloc(chroma_bytes);
+    assert(black && neutral);
+    memset(neutral, 128, chroma_bytes);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glActiveTexture(GL_TEXTURE0 + VIDEO_UPLOAD_UNIT);
+    for(i=0; i<VIDEO_BUFFERS; i++) {
+        VIDEO_BUFFER_T *buffer = &video->buffers[i];
+        buffer->planes[0] = create_plane("video Y", GL_LUMINANCE, width, height, black);
+        if(format == VIDEO_FORMAT_I420) {
+            buffer->planes[1] = create_plane("video U", GL_LUMINANCE, video->chroma_width, video->chroma_height, neutral);
+            buffer->planes[2] = create_plane("video V", GL_LUMINANCE, video->chroma_width, video->chroma_height, neutral);
+        }
+        else
+            buffer->planes[1] = create_plane("video UV", GL_LUMINANCE_ALPHA, video->chroma_width, video->chroma_height, neutral);
+
+        if(!buffer->planes[0] || !buffer->planes[1] || (format == VIDEO_FORMAT_I420 && !buffer->planes[2])) {
+            free(black);
+            free(neutral);
+            video_input_destroy(video);
+            return 0;
+        }
+    }
+    free(black);
+    free(neutral);
+
+    // Drawn from straight away, the shader must never sample an unbound chroma unit
+    video->front = VIDEO_BUFFERS - 1;
+    bind_front(video);
+
+    printf("Video input: %dx%d %s, %d buffers\n", width, height,
+           format == VIDEO_FORMAT_I420 ? "I420" : "NV12", VIDEO_BUFFERS);
+
+    return 1;
+}
+
+// Shader variant format converting this input to RGB
+SHADER_FORMAT_T video_input_shader_format(VIDEO_INPUT_T *video)
+{
+    return video->format == VIDEO_FORMAT_I420 ? SHADER_FORMAT_I420 : SHADER_FORMAT_NV12;
+}
+
+// Uploads a frame into the buffer not being drawn, planes follow each other
+// in frame as laid out by the format. Shown from the next present.
+void video_input_upload(VIDEO_INPUT_T *video, const uint8_t *frame)
+{
+    double start = video_time();
+    VIDEO_BUFFER_T *buffer = &video->buffers[(video->front + 1) % VIDEO_BUFFERS];
+    const uint8_t *chroma = frame + (size_t)video->width*video->height;
+    size_t plane_bytes = (size_t)video->chroma_width*video->chroma_height;
+
+    if(video->back_ready)
+        video->stats.replaced++;
+
+    // This buffer was last drawn from two presents ago. On GLES3 its fence
+    // says whether those draws are done, without one the third buffer keeps
+    // the upload clear of them in all but the deepest driver queues.
+    GL3_SYNC_T *fence = &video->fences[(video->front + 1) % VIDEO_BUFFERS];
+    if(*fence) {
+        GLenum status = gles3.client_wait_sync(*fence, 0, 0);
+        if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            video->stats.stalls++;
+            status = gles3.client_wait_sync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, VIDEO_FENCE_TIMEOUT_NS);
+            if(status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+                printf("video_input: fence wait failed\n");
+        }
+        gles3.delete_sync(*fence);
+        *fence = NULL;
+    }
+
+    glActiveTexture(GL_TEXTURE0 + VIDEO_UPLOAD_UNIT);
+    glBindTexture(GL_TEXTURE_2D, buffer->planes[0]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, video->width, video->height, GL_LUMINANCE, GL_UNSIGNED_BYTE, frame);
+
+    if(video->format == VIDEO_FORMAT_I420) {
+        glBindTexture(GL_TEXTURE_2D, buffer->planes[1]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, video->chroma_width, video->chroma_height, GL_LUMINANCE, GL_UNSIGNED_BYTE, chroma);
+        glBindTexture(GL_TEXTURE_2D, buffer->planes[2]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, video->chroma_width, video->chroma_height, GL_LUMINANCE, GL_UNSIGNED_BYTE,
+                        chroma + plane_bytes);
+    }
+    else {
+        glBindTexture(GL_TEXTURE_2D, buffer->planes[1]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, video->chroma_width, video->chroma_height, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, chroma);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    video->back_ready = 1;
+    video->stats.uploaded++;
+    video->stats.upload_seconds += video_time() - start;
+}
+
+// Swaps in the last uploaded frame, Y on y_unit and chroma on SHADER_CHROMA_UNIT
+// onwards. Call once per frame before drawing, returns non zero on a new frame.
+int video_input_present(VIDEO_INPUT_T *video)
+{
+    if(!video->back_ready)
+        return 0;
+
+    // Everything queued so far is all that reads the outgoing buffer
+    if(video->use_fences)
+        video->fences[video->front] = gles3.fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    video->front = (video->front + 1) % VIDEO_BUFFERS;
+    video->back_ready = 0;
+    video->stats.presented++;
+    bind_front(video);
+
+    return 1;
+}
+
+// Records that the planes of the frame on screen were drawn from
+void video_input_touch(VIDEO_INPUT_T *video)
+{
+    int i;
+
+    for(i=0; i<3 && video->buffers[video->front].planes[i]; i++)
+        tex_alloc_touch(video->buffers[video->front].planes[i]);
+}
+
+void video_input_print_stats(VIDEO_INPUT_T *video)
+{
+    VIDEO_STATS_T *stats = &video->stats;
+
+    if(!stats->uploaded)
+        return;
+
+    printf("Video input: %lu frames uploaded, %lu presented, %lu replaced before display, %lu stalled, %.2f ms per upload\n",
+           stats->uploaded, stats->presented, stats->replaced, stats->stalls, stats->upload_seconds/stats->uploaded*1e3);
+}
+
+void video_input_destroy(VIDEO_INPUT_T *video)
+{
+    int i, p;
+
+    for(i=0; i<VIDEO_BUFFERS; i++) {
+        if(video->fences[i])
+            gles3.delete_sync(video->fences[i]);
+        for(p=0; p<3; p++) {
+            if(video->buffers[i].planes[p])
+                tex_alloc_delete(video->buffers[i].planes[p]);
+        }
+    }
+    memset(video, 0, sizeof(VIDEO_INPUT_T));
+}
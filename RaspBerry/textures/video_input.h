@@ -0,0 +1,71 @@
+#ifndef VIDEO_INPUT_H
+#define VIDEO_INPUT_H
+
+#include <stdint.h>
+
+#include "GLES2/gl2.h"
+#include "gles3_compat.h"
+#include "shaders/shader_variants.h"
+
+// Plane texture sets. One is drawn, the one before it may still be read by
+// draws queued last frame, and frames are uploaded into the third.
+#define VIDEO_BUFFERS 3
+
+// Scratch unit planes are bound to while uploading, see AUTO_LEVEL_UNIT
+#define VIDEO_UPLOAD_UNIT 2
+
+typedef enum {
+    // Y, U and V planes
+    VIDEO_FORMAT_I420,
+    // Y plane and interleaved UV pairs
+    VIDEO_FORMAT_NV12
+} VIDEO_FORMAT_T;
+
+typedef struct
+{
+    // Y, then U for I420 or UV for NV12, then V for I420
+    GLuint planes[3];
+} VIDEO_BUFFER_T;
+
+typedef struct
+{
+    unsigned long uploaded;
+    unsigned long presented;
+    // Frames overwritten in the back buffer before they were shown
+    unsigned long replaced;
+    // Uploads that had to wait for the GPU to finish reading their buffer
+    unsigned long stalls;
+    double upload_seconds;
+} VIDEO_STATS_T;
+
+typedef struct
+{
+    VIDEO_FORMAT_T format;
+    GLsizei width;
+    GLsizei height;
+    GLsizei chroma_width;
+    GLsizei chroma_height;
+
+    VIDEO_BUFFER_T buffers[VIDEO_BUFFERS];
+    // Buffer bound for drawing, and whether the next holds a newer frame
+    int front;
+    int back_ready;
+    GLenum y_unit;
+
+    // GLES3: signalled once the draws reading a buffer have finished
+    int use_fences;
+    GL3_SYNC_T fences[VIDEO_BUFFERS];
+
+    VIDEO_STATS_T stats;
+} VIDEO_INPUT_T;
+
+int video_input_init(VIDEO_INPUT_T *video, int gles_version, VIDEO_FORMAT_T format, GLsizei width, GLsizei height,
+                     GLenum y_unit);
+SHADER_FORMAT_T video_input_shader_format(VIDEO_INPUT_T *video);
+void video_input_upload(VIDEO_INPUT_T *video, const uint8_t *frame);
+int video_input_present(VIDEO_INPUT_T *video);
+void video_input_touch(VIDEO_INPUT_T *video);
+void video_input_print_stats(VIDEO_INPUT_T *video);
+void video_input_destroy(VIDEO_INPUT_T *video);
+
+#endif
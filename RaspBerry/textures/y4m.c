@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "y4m.h"
+
+// Reads one header line into line, returns 0 at end of file or when it does not fit
+static int read_line(FILE *file, char *line, size_t size)
+{
+    if(!fgets(line, size, file))
+        return 0;
+    return strchr(line, '\n') != NULL;
+}
+
+// Parses the stream header, path is a seekable YUV4MPEG2 file with 4:2:0 chroma
+int y4m_open(Y4M_READER_T *reader, const char *path, int nv12)
+{
+    char line[256];
+    char *token, *save;
+
+    memset(reader, 0, sizeof(Y4M_READER_T));
+    reader->rate_num = 25;
+    reader->rate_den = 1;
+    reader->nv12 = nv12;
+
+    reader->file = fopen(path, "rb");
+    if(!reader->file) {
+        printf("Can not open %s\n", path);
+        return 0;
+    }
+
+    if(!read_line(reader->file, line, sizeof(line)) || strncmp(line, "YUV4MPEG2 ", 10) != 0) {
+        printf("%s is not a YUV4MPEG2 stream\n", path);
+        y4m_close(reader);
+        return 0;
+    }
+
+    for(token=strtok_r(line + 10, " \n", &save); token; token=strtok_r(NULL, " \n", &save)) {
+        switch(token[0]) {
+            case 'W':
+                reader->width = atoi(token + 1);
+                break;
+            case 'H':
+                reader->height = atoi(token + 1);
+                break;
+            case 'F':
+                sscanf(token + 1, "%d:%d", &reader->rate_num, &reader->rate_den);
+                break;
+            case 'C':
+                // 420, 420jpeg, 420mpeg2 and 420paldv differ only in chroma siting.
+                // Deeper variants such as 420p10 have 16-bit samples and are rejected.
+                if(strcmp(token + 1, "420") != 0 && strcmp(token + 1, "420jpeg") != 0
+                   && strcmp(token + 1, "420mpeg2") != 0 && strcmp(token + 1, "420paldv") != 0) {
+                    printf("%s: chroma %s is not supported, only 8-bit 4:2:0\n", path, token + 1);
+                    y4m_close(reader);
+                    return 0;
+                }
+                break;
+        }
+    }
+
+    if(reader->width <= 0 || reader->height <= 0 || reader->rate_num <= 0 || reader->rate_den <= 0) {
+        printf("%s: bad stream header\n", path);
+        y4m_close(reader);
+        return 0;
+    }
+
+    reader->chroma_width = (reader->width + 1)/2;
+    reader->chroma_height = (reader->height + 1)/2;
+    reader->frame_bytes = (size_t)reader->width*reader->height + (size_t)reader->chroma_width*reader->chroma_height*2;
+    reader->frame = malloc(reader->frame_bytes);
+    assert(reader->frame);
+    if(nv12) {
+        reader->chroma = malloc((size_t)reader->chroma_width*reader->chroma_height*2);
+        assert(reader->chroma);
+    }
+    reader->data_start = ftell(reader->file);
+
+    printf("Y4M %s: %dx%d at %.2f fps%s\n", path, reader->width, reader->height,
+           (double)reader->rate_num/reader->rate_den, nv12 ? ", as NV12" : "");
+
+    return 1;
+}
+
+// Returns the next frame, valid until the following call, or NULL at the end of the stream
+uint8_t *y4m_read_frame(Y4M_READER_T *reader)
+{
+    char line[256];
+    size_t luma_bytes = (size_t)reader->width*reader->height;
+    size_t plane_bytes = (size_t)reader->chroma_width*reader->chroma_height;
+    size_t i;
+
+    // FRAME with optional parameters, which are ignored
+    if(!read_line(reader->file, line, sizeof(line)) || strncmp(line, "FRAME", 5) != 0)
+        return NULL;
+
+    if(!reader->nv12) {
+        if(fread(reader->frame, 1, reader->frame_bytes, reader->file) != reader->frame_bytes)
+            return NULL;
+    }
+    else {
+        if(fread(reader->frame, 1, luma_bytes, reader->file) != luma_bytes
+           || fread(reader->chroma, 1, plane_bytes*2, reader->file) != plane_bytes*2)
+            return NULL;
+
+        // U and V planes into UV pairs
+        uint8_t *uv = reader->frame + luma_bytes;
+        for(i=0; i<plane_bytes; i++) {
+            uv[i*2 + 0] = reader->chroma[i];
+            uv[i*2 + 1] = reader->chroma[plane_bytes + i];
+        }
+    }
+
+    reader->frames++;
+    return reader->frame;
+}
+
+// Back to the first frame
+void y4m_rewind(Y4M_READER_T *reader)
+{
+    fseek(reader->file, reader->data_start, SEEK_SET);
+}
+
+void y4m_close(Y4M_READER_T *reader)
+{
+    if(reader->file)
+        fclose(reader->file);
+    free(reader->frame);
+    free(reader->chroma);
+    memset(reader, 0, sizeof(Y4M_READER_T));
+}
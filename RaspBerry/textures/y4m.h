@@ -0,0 +1,39 @@
+#ifndef Y4M_H
+#define Y4M_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Reader for YUV4MPEG2 files with 4:2:0 chroma, frames come back as I420
+// (Y, U and V planes) or converted to NV12 (Y and interleaved UV)
+typedef struct
+{
+    FILE *file;
+    int width;
+    int height;
+    int chroma_width;
+    int chroma_height;
+
+    // Frame rate from the F header field
+    int rate_num;
+    int rate_den;
+
+    // File offset of the first frame, for looping
+    long data_start;
+
+    int nv12;
+    size_t frame_bytes;
+    uint8_t *frame;
+    // I420 chroma read here before interleaving into frame
+    uint8_t *chroma;
+
+    unsigned long frames;
+} Y4M_READER_T;
+
+int y4m_open(Y4M_READER_T *reader, const char *path, int nv12);
+uint8_t *y4m_read_frame(Y4M_READER_T *reader);
+void y4m_rewind(Y4M_READER_T *reader);
+void y4m_close(Y4M_READER_T *reader);
+
+#endif
@@ -0,0 +1,375 @@
+// Converts Wavefront OBJ geometry to the binary scene format scene_load() maps
+//
+// Usage: scene_convert [--fit] input.obj output.scene
+//
+// Reads v (x and y only), vt, f and l lines. Faces are triangulated as fans
+// and polylines split into line segments. Each o, g or usemtl line starts a
+// new draw range. A material named #RRGGBB or #RRGGBBAA sets the colour of
+// the draws after it. --fit scales and centres the geometry to fill -1..1,
+// otherwise positions are expected in normalised device coordinates.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "scene_format.h"
+
+// GL_LINES and GL_TRIANGLES, without pulling in the GL headers
+#define SCENE_LINES 0x0001
+#define SCENE_TRIANGLES 0x0004
+
+typedef struct
+{
+    void *data;
+    size_t count;
+    size_t capacity;
+    size_t size;
+} ARRAY_T;
+
+typedef struct
+{
+    ARRAY_T positions;
+    ARRAY_T tex_coords;
+
+    // Unique position and texture coordinate pairs, hashed to their vertex
+    ARRAY_T vertices;
+    ARRAY_T keys;
+    int32_t *table;
+    size_t table_size;
+
+    ARRAY_T indices;
+    ARRAY_T draws;
+
+    // Next primitive starts a new draw
+    int new_draw;
+    uint32_t color;
+} CONVERTER_T;
+
+static void *array_push(ARRAY_T *array)
+{
+    if(array->count == array->capacity) {
+        array->capacity = array->capacity ? array->capacity*2 : 1024;
+        array->data = realloc(array->data, array->capacity*array->size);
+        assert(array->data);
+    }
+    return (uint8_t*)array->data + array->size*array->count++;
+}
+
+// Converts a value in -1.0..1.0 to a normalised short, rounding as mesh_quantise()
+static int16_t quantise(float value)
+{
+    if(value > 1.0f)
+        value = 1.0f;
+    if(value < -1.0f)
+        value = -1.0f;
+
+    float scaled = value*32767.0f;
+    return (int16_t)(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+}
+
+static uint32_t hash_key(int32_t position, int32_t tex_coord)
+{
+    return ((uint32_t)position*2654435761u) ^ ((uint32_t)tex_coord*40503u);
+}
+
+static void rehash(CONVERTER_T *conv)
+{
+    size_t i;
+
+    free(conv->table);
+    conv->table_size = conv->table_size ? conv->table_size*2 : 4096;
+    conv->table = malloc(conv->table_size*sizeof(int32_t));
+    assert(conv->table);
+    memset(conv->table, 0xff, conv->table_size*sizeof(int32_t));
+
+    for(i=0; i<conv->keys.count; i++) {
+        int32_t *key = (int32_t*)conv->keys.data + 2*i;
+        size_t slot = hash_key(key[0], key[1]) & (conv->table_size - 1);
+        while(conv->table[slot] >= 0)
+            slot = (slot + 1) & (conv->table_size - 1);
+        conv->table[slot] = i;
+    }
+}
+
+// Vertex for a position and texture coordinate pair, tex_coord -1 for none
+static uint32_t vertex_index(CONVERTER_T *conv, int32_t position, int32_t tex_coord)
+{
+    if(conv->keys.count*2 >= conv->table_size)
+        rehash(conv);
+
+    size_t slot = hash_key(position, tex_coord) & (conv->table_size - 1);
+    while(conv->table[slot] >= 0) {
+        int32_t *key = (int32_t*)conv->keys.data + 2*conv->table[slot];
+        if(key[0] == position && key[1] == tex_coord)
+            return conv->table[slot];
+        slot = (slot + 1) & (conv->table_size - 1);
+    }
+
+    int32_t *key = array_push(&conv->keys);
+    key[0] = position;
+    key[1] = tex_coord;
+    conv->table[slot] = conv->keys.count - 1;
+    return conv->keys.count - 1;
+}
+
+// Parses v, v/vt, v//vn or v/vt/vn, negative indices count back from the last
+static int parse_ref(CONVERTER_T *conv, const char *token, uint32_t *index)
+{
+    long position = strtol(token, NULL, 10), tex_coord = 0;
+    const char *slash = strchr(token, '/');
+
+    if(slash && slash[1] != '/')
+        tex_coord = strtol(slash + 1, NULL, 10);
+
+    position = position < 0 ? (long)conv->positions.count + position : position - 1;
+    tex_coord = tex_coord < 0 ? (long)conv->tex_coords.count + tex_coord : tex_coord - 1;
+    if(position < 0 || position >= (long)conv->positions.count || tex_coord >= (long)conv->tex_coords.count)
+        return 0;
+
+    *index = vertex_index(conv, position, tex_coord < 0 ? -1 : tex_coord);
+    return 1;
+}
+
+static void add_index(CONVERTER_T *conv, uint32_t mode, uint32_t index)
+{
+    SCENE_DRAW_T *draw = conv->draws.count ? (SCENE_DRAW_T*)conv->draws.data + conv->draws.count - 1 : NULL;
+
+    if(!draw || conv->new_draw || draw->mode != mode) {
+        draw = array_push(&conv->draws);
+        draw->mode = mode;
+        draw->first = conv->indices.count;
+        draw->count = 0;
+        draw->color = conv->color;
+        conv->new_draw = 0;
+    }
+
+    *(uint32_t*)array_push(&conv->indices) = index;
+    draw->count++;
+}
+
+// Faces as triangle fans, polylines as segments
+static int add_primitive(CONVERTER_T *conv, uint32_t mode, char *refs)
+{
+    uint32_t indices[3], count = 0;
+    char *token;
+
+    for(token = strtok(refs, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+        uint32_t index;
+        if(!parse_ref(conv, token, &index))
+            return 0;
+
+        if(mode == SCENE_TRIANGLES && count >= 2) {
+            add_index(conv, mode, indices[0]);
+            add_index(conv, mode, indices[1]);
+            add_index(conv, mode, index);
+            indices[1] = index;
+        }
+        else if(mode == SCENE_LINES && count >= 1) {
+            add_index(conv, mode, indices[0]);
+            add_index(conv, mode, index);
+            indices[0] = index;
+        }
+        else
+            indices[count] = index;
+        count++;
+    }
+
+    return 1;
+}
+
+// #RRGGBB or #RRGGBBAA to RGBA with red in the lowest byte, white otherwise
+static uint32_t parse_color(const char *name)
+{
+    unsigned long value;
+    size_t length = strcspn(name, " \t\r\n");
+
+    if(name[0] != '#' || (length != 7 && length != 9))
+        return 0xffffffff;
+
+    value = strtoul(name + 1, NULL, 16);
+    if(length == 7)
+        value = value << 8 | 0xff;
+
+    return (uint32_t)((value >> 24) & 0xff) | (uint32_t)((value >> 16) & 0xff) << 8
+           | (uint32_t)((value >> 8) & 0xff) << 16 | (uint32_t)(value & 0xff) << 24;
+}
+
+static int read_obj(CONVERTER_T *conv, FILE *file)
+{
+    char line[4096];
+    unsigned long number = 0;
+
+    while(fgets(line, sizeof(line), file)) {
+        number++;
+        if(strncmp(line, "v ", 2) == 0) {
+            float *position = array_push(&conv->positions);
+            if(sscanf(line + 2, "%f %f", &position[0], &position[1]) != 2)
+                goto bad_line;
+        }
+        else if(strncmp(line, "vt ", 3) == 0) {
+            float *tex_coord = array_push(&conv->tex_coords);
+            if(sscanf(line + 3, "%f %f", &tex_coord[0], &tex_coord[1]) != 2)
+                goto bad_line;
+        }
+        else if(strncmp(line, "f ", 2) == 0) {
+            if(!add_primitive(conv, SCENE_TRIANGLES, line + 2))
+                goto bad_line;
+        }
+        else if(strncmp(line, "l ", 2) == 0) {
+            if(!add_primitive(conv, SCENE_LINES, line + 2))
+                goto bad_line;
+        }
+        else if(strncmp(line, "o ", 2) == 0 || strncmp(line, "g ", 2) == 0)
+            conv->new_draw = 1;
+        else if(strncmp(line, "usemtl ", 7) == 0) {
+            conv->color = parse_color(line + 7);
+            conv->new_draw = 1;
+        }
+    }
+
+    return 1;
+
+bad_line:
+    printf("Can not convert line %lu: %s", number, line);
+    return 0;
+}
+
+// Quantises the vertices, with fit scaled and centred to fill -1..1
+static void build_vertices(CONVERTER_T *conv, int fit)
+{
+    float min[2] = { 1e30f, 1e30f }, max[2] = { -1e30f, -1e30f };
+    float centre[2] = { 0.0f, 0.0f }, scale = 1.0f;
+    size_t i;
+    int c;
+
+    if(fit && conv->positions.count) {
+        for(i=0; i<conv->positions.count; i++) {
+            float *position = (float*)conv->positions.data + 2*i;
+            for(c=0; c<2; c++) {
+                min[c] = position[c] < min[c] ? position[c] : min[c];
+                max[c] = position[c] > max[c] ? position[c] : max[c];
+            }
+        }
+        float extent = max[0] - min[0] > max[1] - min[1] ? max[0] - min[0] : max[1] - min[1];
+        centre[0] = (min[0] + max[0])*0.5f;
+        centre[1] = (min[1] + max[1])*0.5f;
+        scale = extent > 0.0f ? 2.0f/extent : 1.0f;
+    }
+
+    for(i=0; i<conv->keys.count; i++) {
+        int32_t *key = (int32_t*)conv->keys.data + 2*i;
+        float *position = (float*)conv->positions.data + 2*key[0];
+        SCENE_VERTEX_T *vertex = array_push(&conv->vertices);
+
+        vertex->position[0] = quantise((position[0] - centre[0])*scale);
+        vertex->position[1] = quantise((position[1] - centre[1])*scale);
+        if(key[1] >= 0) {
+            float *tex_coord = (float*)conv->tex_coords.data + 2*key[1];
+            vertex->tex_coord[0] = quantise(tex_coord[0]);
+            vertex->tex_coord[1] = quantise(tex_coord[1]);
+        }
+        else
+            vertex->tex_coord[0] = vertex->tex_coord[1] = 0;
+    }
+}
+
+static uint32_t align(uint32_t offset)
+{
+    return (offset + SCENE_ALIGN - 1)/SCENE_ALIGN*SCENE_ALIGN;
+}
+
+// Writes data at offset, zero padding from the current position
+static void write_block(FILE *file, uint32_t offset, const void *data, size_t bytes)
+{
+    static const uint8_t zeros[SCENE_ALIGN];
+    long position = ftell(file);
+
+    assert(offset >= position && offset - position <= SCENE_ALIGN);
+    fwrite(zeros, 1, offset - position, file);
+    fwrite(data, 1, bytes, file);
+}
+
+static int write_scene(CONVERTER_T *conv, const char *path)
+{
+    SCENE_HEADER_T header;
+    uint32_t i;
+
+    memset(&header, 0, sizeof(SCENE_HEADER_T));
+    header.magic = SCENE_MAGIC;
+    header.version = SCENE_VERSION;
+    header.vertex_count = conv->vertices.count;
+    header.index_count = conv->indices.count;
+    header.draw_count = conv->draws.count;
+    header.index_size = header.vertex_count <= 256 ? 1 : header.vertex_count <= 65536 ? 2 : 4;
+
+    header.vertex_offset = align(sizeof(SCENE_HEADER_T));
+    header.index_offset = align(header.vertex_offset + header.vertex_count*sizeof(SCENE_VERTEX_T));
+    header.draw_offset = align(header.index_offset + header.index_count*header.index_size);
+
+    // Narrow the indices in place, they only ever shrink
+    uint32_t *indices = conv->indices.data;
+    for(i=0; i<header.index_count; i++) {
+        if(header.index_size == 1)
+            ((uint8_t*)indices)[i] = indices[i];
+        else if(header.index_size == 2)
+            ((uint16_t*)indices)[i] = indices[i];
+    }
+
+    FILE *file = fopen(path, "wb");
+    if(!file) {
+        printf("Can not create %s\n", path);
+        return 0;
+    }
+    fwrite(&header, sizeof(SCENE_HEADER_T), 1, file);
+    write_block(file, header.vertex_offset, conv->vertices.data, header.vertex_count*sizeof(SCENE_VERTEX_T));
+    write_block(file, header.index_offset, indices, header.index_count*header.index_size);
+    write_block(file, header.draw_offset, conv->draws.data, header.draw_count*sizeof(SCENE_DRAW_T));
+
+    if(fclose(file) != 0) {
+        printf("Can not write %s\n", path);
+        return 0;
+    }
+
+    printf("%s: %u vertices, %u indices of %u bytes, %u draws, %u bytes\n", path, header.vertex_count,
+           header.index_count, header.index_size, header.draw_count,
+           header.draw_offset + header.draw_count*(uint32_t)sizeof(SCENE_DRAW_T));
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    CONVERTER_T conv;
+    int fit = 0, arg = 1;
+
+    if(argc > arg && strcmp(argv[arg], "--fit") == 0) {
+        fit = 1;
+        arg++;
+    }
+    if(argc - arg != 2) {
+        printf("Usage: scene_convert [--fit] input.obj output.scene\n");
+        return 1;
+    }
+
+    memset(&conv, 0, sizeof(CONVERTER_T));
+    conv.positions.size = 2*sizeof(float);
+    conv.tex_coords.size = 2*sizeof(float);
+    conv.vertices.size = sizeof(SCENE_VERTEX_T);
+    conv.keys.size = 2*sizeof(int32_t);
+    conv.indices.size = sizeof(uint32_t);
+    conv.draws.size = sizeof(SCENE_DRAW_T);
+    conv.color = 0xffffffff;
+
+    FILE *file = fopen(argv[arg], "r");
+    if(!file) {
+        printf("Can not open %s\n", argv[arg]);
+        return 1;
+    }
+    int read = read_obj(&conv, file);
+    fclose(file);
+    if(!read)
+        return 1;
+
+    build_vertices(&conv, fit);
+    return write_scene(&conv, argv[arg + 1]) ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <time.h>
+
+#include "GLES2/gl2.h"
+#include "EGL/egl.h"
+#include "EGL/eglext.h"
+
+#include "bcm_host.h"
+
+#include "egl_utils.h"
+#include "shader_utils.h"
+#include "vertex_stream.h"
+
+// Compares per frame geometry updates written with glBufferSubData into a
+// GL_STATIC_DRAW buffer allocated once, which waits on draws still reading
+// it, against the orphaning vertex stream.
+//
+// Usage: stream_bench [static|stream] [vertices per frame] [frames]
+
+// Vertices appended per call, as a plot would add one trace at a time
+#define TRACE_VERTICES 4096
+
+// Shader source
+const GLchar* vertexSource =
+    "attribute vec2 position;"
+    "void main() {"
+    "   gl_Position = vec4(position, 0.0, 1.0);"
+    "}";
+const GLchar* fragmentSource =
+    "precision mediump float;"
+    "void main() {"
+    "   gl_FragColor = vec4(0.0, 0.5, 1.0, 1.0);"
+    "}";
+
+typedef struct
+{
+    GLshort position[2];
+} BENCH_VERTEX_T;
+
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Fills vertices with a line strip of a sine wave that moves every frame
+static void generate_trace(BENCH_VERTEX_T *vertices, int count, int trace, int frame)
+{
+    int i;
+    float phase = frame*0.05f + trace*0.7f;
+    float offset = 0.9f - 1.8f*(trace % 16)/16.0f;
+
+    for(i=0; i<count; i++) {
+        float x = -1.0f + 2.0f*i/(count - 1);
+        float y = offset + 0.05f*sinf(x*20.0f + phase);
+        vertices[i].position[0] = (GLshort)(x*32767.0f);
+        vertices[i].position[1] = (GLshort)(y*32767.0f);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    EGL_STATE_T egl_state;
+    VERTEX_STREAM_T stream;
+    GLuint static_vbo;
+    int frame, trace;
+
+    int use_stream = !(argc > 1 && strcmp(argv[1], "static") == 0);
+    int vertex_count = argc > 2 ? atoi(argv[2]) : 200000;
+    int frames = argc > 3 ? atoi(argv[3]) : 600;
+    int traces = (vertex_count + TRACE_VERTICES - 1)/TRACE_VERTICES;
+
+    bcm_host_init();
+
+    // Start OGLES
+    init_ogl(&egl_state);
+
+    // Setup shaders
+    GLuint program = load_program(vertexSource, fragmentSource);
+    glUseProgram(program);
+    GLint position_location = glGetAttribLocation(program, "position");
+    glEnableVertexAttribArray(position_location);
+
+    // Setup vertex storage for either path
+    GLsizeiptr trace_size = TRACE_VERTICES*sizeof(BENCH_VERTEX_T);
+    if(use_stream) {
+        vertex_stream_init(&stream, traces*trace_size);
+    }
+    else {
+        glGenBuffers(1, &static_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, static_vbo);
+        glBufferData(GL_ARRAY_BUFFER, traces*trace_size, NULL, GL_STATIC_DRAW);
+    }
+
+    BENCH_VERTEX_T *vertices = malloc(trace_size);
+    assert(vertices);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    double start = now_seconds();
+
+    for(frame=0; frame<frames; frame++) {
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        if(use_stream)
+            vertex_stream_begin_frame(&stream);
+
+        for(trace=0; trace<traces; trace++) {
+            generate_trace(vertices, TRACE_VERTICES, trace, frame);
+
+            if(use_stream) {
+                GLintptr offset = vertex_stream_append(&stream, vertices, trace_size);
+                glVertexAttribPointer(position_location, 2, GL_SHORT, GL_TRUE, sizeof(BENCH_VERTEX_T), (void*)offset);
+            }
+            else {
+                // Naive update, waits for draws still reading the buffer
+                glBindBuffer(GL_ARRAY_BUFFER, static_vbo);
+                glBufferSubData(GL_ARRAY_BUFFER, trace*trace_size, trace_size, vertices);
+                glVertexAttribPointer(position_location, 2, GL_SHORT, GL_TRUE, sizeof(BENCH_VERTEX_T), (void*)(trace*trace_size));
+            }
+
+            glDrawArrays(GL_LINE_STRIP, 0, TRACE_VERTICES);
+        }
+
+        egl_swap(&egl_state);
+    }
+
+    // Wait for the last frame before stopping the clock
+    glFinish();
+    double elapsed = now_seconds() - start;
+
+    printf("%s: %d frames of %d vertices in %.2f s, %.1f fps, %.0f vertices/s\n",
+           use_stream ? "stream" : "static", frames, traces*TRACE_VERTICES, elapsed,
+           frames/elapsed, (double)frames*traces*TRACE_VERTICES/elapsed);
+    if(use_stream) {
+        printf("stream: %lu appends, %lu bytes, %lu orphans\n",
+               stream.stats.appends, stream.stats.bytes, stream.stats.orphans);
+        vertex_stream_destroy(&stream);
+    }
+    else {
+        glDeleteBuffers(1, &static_vbo);
+    }
+
+    // Tidy up
+    free(vertices);
+    exit_func(&egl_state);
+
+    return 0;
+}
@@ -1,5 +1,8 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
 #include <assert.h>
 
 #include "GLES2/gl2.h"
@@ -8,6 +11,19 @@
 
 #include "bcm_host.h"
 
+#include "shader_utils.h"
+#include "mesh.h"
+#include "scene.h"
+#include "vertex_stream.h"
+
+// Grid cells along each side of the square
+#define GRID_SIZE 200
+#define GRID_VERTICES ((GRID_SIZE+1)*(GRID_SIZE+1))
+
+// Ripple across the streamed grid, in normalised device coordinates and radians per frame
+#define STREAM_AMPLITUDE 0.02f
+#define STREAM_SPEED 0.1f
+
 // Shader source
 const GLchar* vertexSource =
     "attribute vec2 position;"
@@ -16,8 +32,9 @@ const GLchar* vertexSource =
     "}";
 const GLchar* fragmentSource =
     "precision mediump float;"
+    "uniform vec4 color;"
     "void main() {"
-    "   gl_FragColor = vec4(0.0, 0.5, 1.0, 1.0);"
+    "   gl_FragColor = color;"
     "}";
 
 typedef struct
@@ -38,13 +55,6 @@ static volatile int terminate;
 static STATE_T _state, *state=&_state;
 
 #define check() assert(glGetError() == 0)
-static void showlog(GLint shader)
-{
-   // Prints the compile log for a shader
-   char log[1024];
-   glGetShaderInfoLog(shader,sizeof log,NULL,log);
-   printf("%d:shader:\n%s\n", shader, log);
-}
 
 // Description: Sets the display, OpenGL|ES context and screen stuff
 static void init_ogl(STATE_T *state)
@@ -163,6 +173,58 @@ static void exit_func(void)
    printf("close\n");
 } // exit_func()
 
+// Grid vertex positions, displaced by a ripple of amplitude at phase when streaming
+static void fill_grid(MESH_VERTEX_T *vertices, float amplitude, float phase)
+{
+    int i, j;
+
+    for(i=0; i<=GRID_SIZE; i++) {
+        for(j=0; j<=GRID_SIZE; j++) {
+            MESH_VERTEX_T *vertex = &vertices[i*(GRID_SIZE+1) + j];
+            float ripple = amplitude*sinf(phase + 12.0f*(float)(i + j)/GRID_SIZE);
+            vertex->position[0] = mesh_quantise(-0.5f + (float)j/GRID_SIZE);
+            vertex->position[1] = mesh_quantise( 0.5f - (float)i/GRID_SIZE + ripple);
+            vertex->tex_coord[0] = mesh_quantise((float)j/GRID_SIZE);
+            vertex->tex_coord[1] = mesh_quantise((float)i/GRID_SIZE);
+        }
+    }
+}
+
+// The square is tessellated into a GRID_SIZE x GRID_SIZE grid, the same
+// shape of mesh our plots use, which needs 16 bit indices
+static void create_grid(MESH_T *mesh)
+{
+    int i, j;
+    GLsizei vertex_count = GRID_VERTICES;
+    GLsizei index_count = GRID_SIZE*GRID_SIZE*6;
+    MESH_VERTEX_T *vertices = malloc(vertex_count*sizeof(MESH_VERTEX_T));
+    GLuint *elements = malloc(index_count*sizeof(GLuint));
+
+    // Vertices
+    fill_grid(vertices, 0.0f, 0.0f);
+
+    // Elements, two triangles per grid cell
+    GLuint *element = elements;
+    for(i=0; i<GRID_SIZE; i++) {
+        for(j=0; j<GRID_SIZE; j++) {
+            GLuint top_left = i*(GRID_SIZE+1) + j;
+            GLuint bottom_left = top_left + GRID_SIZE+1;
+            *element++ = bottom_left + 1;
+            *element++ = bottom_left;
+            *element++ = top_left;
+            *element++ = top_left;
+            *element++ = top_left + 1;
+            *element++ = bottom_left + 1;
+        }
+    }
+
+    // Fill vertex and element buffers
+    int created = mesh_create(mesh, vertices, vertex_count, elements, index_count);
+    assert(created);
+    free(vertices);
+    free(elements);
+}
+
 int main(int argc, char *argv[])
 {
     bcm_host_init();
@@ -174,75 +236,72 @@ int main(int argc, char *argv[])
     // Setup vertices
     /////////////////////
 
-    // Vertices
-    static const GLfloat vertices[] = {
-       -0.5f,  0.5f,
-        0.5f,  0.5f,
-        0.5f, -0.5f,
-       -0.5f, -0.5f
-    };
-    // Generate vertex buffer
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    // Set buffer
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    // Fill buffer
-    glBufferData(GL_ARRAY_BUFFER, 2*4*sizeof(GLfloat), vertices, GL_STATIC_DRAW);
-
-    // Elements
-    GLubyte elements[] = {
-        2, 3, 0,
-        0, 1, 2
-    };
-    // Generate element buffer
-    GLuint ebo;
-    glGenBuffers(1, &ebo);
-    // Set buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    // Fill buffer
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 2*3*sizeof(GLubyte), elements, GL_STATIC_DRAW);
+    // A scene file given on the command line is drawn instead of the grid.
+    // --stream rewrites the grid vertices every frame through a vertex
+    // stream, the indices stay in the static element buffer.
+    SCENE_T scene;
+    const char *scene_path = NULL;
+    int streaming = 0;
+    if(argc > 1 && strcmp(argv[1], "--stream") == 0)
+        streaming = 1;
+    else if(argc > 1)
+        scene_path = argv[1];
+    if(scene_path && !scene_load(&scene, scene_path))
+        return 1;
+
+    MESH_T mesh;
+    if(!scene_path)
+        create_grid(&mesh);
+
+    VERTEX_STREAM_T stream;
+    MESH_VERTEX_T *stream_vertices = NULL;
+    if(streaming) {
+        vertex_stream_init(&stream, GRID_VERTICES*sizeof(MESH_VERTEX_T));
+        stream_vertices = malloc(GRID_VERTICES*sizeof(MESH_VERTEX_T));
+        assert(stream_vertices);
+    }
 
     /////////////////////
     // Setup shaders
     ////////////////////
 
-    // Compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, NULL);
-    glCompileShader(vertexShader);
+    // Compile and link program, or load the cached binary
+    GLuint shaderProgram = load_program(vertexSource, fragmentSource);
 
-    showlog(vertexShader);   
-
-    // Compile frag shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-    glCompileShader(fragmentShader);
-
-    showlog(fragmentShader);
-
-    // Create shader program
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-   
-    // Link and use program
-    glLinkProgram(shaderProgram);
+    // Use program
     glUseProgram(shaderProgram);
 
     // Specify and enable vertex attribute
     GLint posAttrib = glGetAttribLocation(shaderProgram, "position");
-    glVertexAttribPointer(posAttrib, 2, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(posAttrib);
+    GLint colorUniform = glGetUniformLocation(shaderProgram, "color");
+    if(!scene_path) {
+        mesh_bind(&mesh, posAttrib, -1);
+        glUniform4f(colorUniform, 0.0f, 0.5f, 1.0f, 1.0f);
+    }
 
     // Clear the screen
     glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
     // Event loop
+    unsigned long frame = 0;
     while(!terminate)
     {
-        // Draw square
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, 0);
+        // New positions for this frame, drawn with the grid's indices
+        if(streaming) {
+            fill_grid(stream_vertices, STREAM_AMPLITUDE, frame*STREAM_SPEED);
+            vertex_stream_begin_frame(&stream);
+            GLintptr offset = vertex_stream_append(&stream, stream_vertices, GRID_VERTICES*sizeof(MESH_VERTEX_T));
+            glVertexAttribPointer(posAttrib, 2, GL_SHORT, GL_TRUE, sizeof(MESH_VERTEX_T),
+                                  (void*)(offset + offsetof(MESH_VERTEX_T, position)));
+        }
+
+        // Draw the scene or the square
+        if(scene_path)
+            scene_draw(&scene, posAttrib, -1, colorUniform);
+        else
+            mesh_draw(&mesh, GL_TRIANGLES, 0, mesh.index_count);
+        frame++;
 
         // Swap buffers
         eglSwapBuffers(state->display, state->surface);
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "vertex_stream.h"
+
+#include "GLES2/gl2.h"
+
+// Keep appends 4 byte aligned for the vertex fetch
+#define VERTEX_STREAM_ALIGN(size) (((size) + 3) & ~(GLsizeiptr)3)
+
+void vertex_stream_init(VERTEX_STREAM_T *stream, GLsizeiptr capacity)
+{
+    int i;
+
+    memset(stream, 0, sizeof(VERTEX_STREAM_T));
+    stream->capacity = capacity;
+
+    glGenBuffers(VERTEX_STREAM_BUFFERS, stream->buffers);
+    for(i=0; i<VERTEX_STREAM_BUFFERS; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, stream->buffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+    }
+}
+
+// Moves on to the next buffer in the ring and orphans its old storage,
+// so nothing written this frame touches memory a queued draw still reads
+static void next_buffer(VERTEX_STREAM_T *stream)
+{
+    stream->current = (stream->current + 1) % VERTEX_STREAM_BUFFERS;
+    stream->offset = 0;
+
+    glBindBuffer(GL_ARRAY_BUFFER, stream->buffers[stream->current]);
+    glBufferData(GL_ARRAY_BUFFER, stream->capacity, NULL, GL_STREAM_DRAW);
+    stream->stats.orphans++;
+}
+
+void vertex_stream_begin_frame(VERTEX_STREAM_T *stream)
+{
+    next_buffer(stream);
+}
+
+// Copies size bytes into the stream, leaves the buffer holding them bound
+// to GL_ARRAY_BUFFER and returns their offset for glVertexAttribPointer
+GLintptr vertex_stream_append(VERTEX_STREAM_T *stream, const void *data, GLsizeiptr size)
+{
+    assert(size <= stream->capacity);
+
+    if(stream->offset + size > stream->capacity)
+        next_buffer(stream);
+    else
+        glBindBuffer(GL_ARRAY_BUFFER, stream->buffers[stream->current]);
+
+    GLintptr offset = stream->offset;
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+    stream->offset += VERTEX_STREAM_ALIGN(size);
+
+    stream->stats.appends++;
+    stream->stats.bytes += size;
+
+    return offset;
+}
+
+void vertex_stream_destroy(VERTEX_STREAM_T *stream)
+{
+    glDeleteBuffers(VERTEX_STREAM_BUFFERS, stream->buffers);
+    memset(stream, 0, sizeof(VERTEX_STREAM_T));
+}
@@ -0,0 +1,34 @@
+#ifndef VERTEX_STREAM_H
+#define VERTEX_STREAM_H
+
+#include "GLES2/gl2.h"
+
+// Buffers cycled through, one per frame the GPU may still be reading
+#define VERTEX_STREAM_BUFFERS 3
+
+typedef struct
+{
+    unsigned long appends;
+    unsigned long bytes;
+    // Buffers respecified because they were reused or ran out of space
+    unsigned long orphans;
+} VERTEX_STREAM_STATS_T;
+
+typedef struct
+{
+    GLuint buffers[VERTEX_STREAM_BUFFERS];
+    GLsizeiptr capacity;
+
+    // Buffer and offset the next append is written to
+    int current;
+    GLsizeiptr offset;
+
+    VERTEX_STREAM_STATS_T stats;
+} VERTEX_STREAM_T;
+
+void vertex_stream_init(VERTEX_STREAM_T *stream, GLsizeiptr capacity);
+void vertex_stream_begin_frame(VERTEX_STREAM_T *stream);
+GLintptr vertex_stream_append(VERTEX_STREAM_T *stream, const void *data, GLsizeiptr size);
+void vertex_stream_destroy(VERTEX_STREAM_T *stream);
+
+#endif